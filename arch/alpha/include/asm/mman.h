@@ -53,6 +53,8 @@
 #define MADV_MERGEABLE   12		/* KSM may merge identical pages */
 #define MADV_UNMERGEABLE 13		/* KSM may not merge identical pages */
 
+#define MADV_FREE	8		/* free pages only if memory pressure */
+
 /* compatibility flags */
 #define MAP_FILE	0
 
@@ -59,6 +59,8 @@
 #define MADV_MERGEABLE   65		/* KSM may merge identical pages */
 #define MADV_UNMERGEABLE 66		/* KSM may not merge identical pages */
 
+#define MADV_FREE	8		/* free pages only if memory pressure */
+
 /* compatibility flags */
 #define MAP_FILE	0
 #define MAP_VARIABLE	0
@@ -5,8 +5,9 @@
  * Derived from asm-x86/semaphore.h
  *
  *
- * The MSW of the count is the negated number of active writers and waiting
- * lockers, and the LSW is the total number of active locks
+ * The MSW of the count is the negated number of active writers, plus one if
+ * there are waiting lockers (see lib/rwsem.c), and the LSW is the total
+ * number of active locks
  *
  * The lock count is initialized to 0 (no active and no waiting lockers).
  *
@@ -16,17 +17,13 @@
  * if there are writers (and maybe) readers waiting (in which case it goes to
  * sleep).
  *
- * The value of WAITING_BIAS supports up to 32766 waiting processes. This can
- * be extended to 65534 by manually checking the whole MSW rather than relying
- * on the S flag.
- *
  * The value of ACTIVE_BIAS supports up to 65535 active processes.
  *
- * This should be totally fair - if anything is waiting, a process that wants a
- * lock will go to the back of the queue. When the currently active lock is
- * released, if there's a writer at the front of the queue, then that and only
- * that will be woken up; if there's a bunch of consequtive readers at the
- * front, then they'll all be woken up, but no other readers will be.
+ * If anything is waiting, a reader that wants a lock will go to the back of
+ * the queue. When the currently active lock is released, if there's a writer
+ * at the front of the queue, then that and only that will be woken up, to
+ * take the lock unless a running writer got it first; if there's a reader at
+ * the front, then all the queued readers will be woken up.
  */
 
 #ifndef _ASM_X86_RWSEM_H
@@ -44,6 +41,7 @@
 #include <asm/asm.h>
 
 struct rwsem_waiter;
+struct thread_info;
 
 extern asmregparm struct rw_semaphore *
  rwsem_down_read_failed(struct rw_semaphore *sem);
@@ -80,6 +78,9 @@ struct rw_semaphore {
 	rwsem_count_t		count;
 	spinlock_t		wait_lock;
 	struct list_head	wait_list;
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	struct thread_info	*owner;
+#endif
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map dep_map;
 #endif
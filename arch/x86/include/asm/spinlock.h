@@ -14,7 +14,8 @@
  * on the local processor, one does not.
  *
  * These are fair FIFO ticket locks, which are currently limited to 256
- * CPUs.
+ * CPUs, or with CONFIG_QUEUED_SPINLOCKS fair FIFO queued locks, which
+ * waiters spin on a per-cpu node of their own instead of on the lock.
  *
  * (the type definitions are in asm/spinlock_types.h)
  */
@@ -38,6 +39,9 @@
 # define UNLOCK_LOCK_PREFIX
 #endif
 
+#ifdef CONFIG_QUEUED_SPINLOCKS
+#include <asm/qspinlock.h>
+#else
 /*
  * Ticket locks are conceptually two parts, one indicating the current head of
  * the queue, and the other indicating the current tail. The lock is acquired
@@ -213,6 +217,7 @@ static inline void arch_spin_unlock_wait(arch_spinlock_t *lock)
 	while (arch_spin_is_locked(lock))
 		cpu_relax();
 }
+#endif	/* CONFIG_QUEUED_SPINLOCKS */
 
 /*
  * Read-write spinlocks, allowing multiple readers
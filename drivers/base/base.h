@@ -74,6 +74,9 @@ struct class_private {
  * list soon.
  * @device - pointer back to the struct class that this structure is
  * associated with.
+ * @async_driver - driver to probe the device with asynchronously.
+ * @async_scheduler - task in async_probe_schedule() for the device.
+ * @async_probe - an asynchronous probe of the device is queued or running.
  *
  * Nothing outside of the driver core should ever touch these fields.
  */
@@ -84,6 +87,9 @@ struct device_private {
 	struct klist_node knode_bus;
 	void *driver_data;
 	struct device *device;
+	struct device_driver *async_driver;
+	struct task_struct *async_scheduler;
+	bool async_probe;
 };
 #define to_device_private_parent(obj)	\
 	container_of(obj, struct device_private, knode_parent)
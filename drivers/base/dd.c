@@ -24,6 +24,9 @@
 #include <linux/wait.h>
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
+#include <linux/init.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -101,6 +104,105 @@ EXPORT_SYMBOL_GPL(device_bind_driver);
 static atomic_t probe_count = ATOMIC_INIT(0);
 static DECLARE_WAIT_QUEUE_HEAD(probe_waitqueue);
 
+/*
+ * Devices of the drivers which set probe_async, or are named in the
+ * driver_async_probe= boot parameter ("*" for all of them), are probed
+ * from async threads, all in a synchronization domain of their own.
+ */
+static LIST_HEAD(async_probe_domain);
+static char async_probe_drivers[128];
+
+static int __init save_async_probe_drivers(char *buf)
+{
+	strlcpy(async_probe_drivers, buf, sizeof(async_probe_drivers));
+	return 1;
+}
+__setup("driver_async_probe=", save_async_probe_drivers);
+
+static bool driver_allows_async_probing(struct device_driver *drv)
+{
+	const char *p = async_probe_drivers, *end;
+	size_t len;
+
+	if (drv->probe_async)
+		return true;
+
+	while (*p) {
+		end = strchr(p, ',');
+		len = end ? end - p : strlen(p);
+		if ((len == 1 && *p == '*') ||
+		    (len == strlen(drv->name) && !strncmp(p, drv->name, len)))
+			return true;
+		if (!end)
+			break;
+		p = end + 1;
+	}
+	return false;
+}
+
+/*
+ * A device is not probed before its parent is done probing: while the
+ * parent has an asynchronous probe queued or running, the probe of the
+ * device goes asynchronous as well, and waits for everything queued
+ * before it in the domain, the probe of the parent included.
+ */
+static bool parent_probe_pending(struct device *dev)
+{
+	return dev->parent && dev->parent->p && dev->parent->p->async_probe;
+}
+
+static bool device_wants_async_probe(struct device *dev,
+				     struct device_driver *drv)
+{
+	return driver_allows_async_probing(drv) || parent_probe_pending(dev);
+}
+
+/* Boot time spent probing, reported with initcall_debug */
+static DEFINE_SPINLOCK(probe_stats_lock);
+static struct {
+	unsigned int nr, nr_async;
+	unsigned long long usecs, async_usecs, wait_usecs;
+	unsigned long long slowest_usecs;
+	char slowest[48];
+} probe_stats;
+
+static void probe_stats_account(struct device *dev, struct device_driver *drv,
+				unsigned long long usecs)
+{
+	spin_lock(&probe_stats_lock);
+	probe_stats.nr++;
+	probe_stats.usecs += usecs;
+	if (dev->p->async_probe) {
+		probe_stats.nr_async++;
+		probe_stats.async_usecs += usecs;
+	}
+	if (usecs > probe_stats.slowest_usecs) {
+		probe_stats.slowest_usecs = usecs;
+		snprintf(probe_stats.slowest, sizeof(probe_stats.slowest),
+			 "%s/%s", drv->name, dev_name(dev));
+	}
+	spin_unlock(&probe_stats_lock);
+}
+
+/**
+ * driver_probe_report - report the boot time spent probing devices
+ *
+ * Called with initcall_debug, before the init process is started.
+ */
+void driver_probe_report(void)
+{
+	spin_lock(&probe_stats_lock);
+	printk("probe: %u probes took %Lu usecs, %u asynchronous ones "
+	       "%Lu usecs\n", probe_stats.nr, probe_stats.usecs,
+	       probe_stats.nr_async, probe_stats.async_usecs);
+	if (probe_stats.nr)
+		printk("probe: slowest was %s after %Lu usecs\n",
+		       probe_stats.slowest, probe_stats.slowest_usecs);
+	printk("probe: waited %Lu usecs for probing to complete\n",
+	       probe_stats.wait_usecs);
+	spin_unlock(&probe_stats_lock);
+}
+
 static int really_probe(struct device *dev, struct device_driver *drv)
 {
 	int ret = 0;
@@ -155,6 +257,24 @@ done:
 	return ret;
 }
 
+static int really_probe_debug(struct device *dev, struct device_driver *drv)
+{
+	ktime_t calltime, delta, rettime;
+	unsigned long long duration;
+	int ret;
+
+	calltime = ktime_get();
+	ret = really_probe(dev, drv);
+	rettime = ktime_get();
+	delta = ktime_sub(rettime, calltime);
+	duration = (unsigned long long) ktime_to_ns(delta) >> 10;
+	printk("probe of %s by %s returned %d after %Ld usecs%s\n",
+	       dev_name(dev), drv->name, ret, duration,
+	       dev->p->async_probe ? " (async)" : "");
+	probe_stats_account(dev, drv, duration);
+	return ret;
+}
+
 /**
  * driver_probe_done
  * Determine if the probe sequence is finished or not.
@@ -176,9 +296,23 @@ int driver_probe_done(void)
  */
 void wait_for_device_probe(void)
 {
+	bool debug = initcall_debug && system_state == SYSTEM_BOOTING;
+	ktime_t calltime, delta;
+
+	if (debug)
+		calltime = ktime_get();
+
 	/* wait for the known devices to complete their probing */
 	wait_event(probe_waitqueue, atomic_read(&probe_count) == 0);
+	async_synchronize_full_domain(&async_probe_domain);
 	async_synchronize_full();
+
+	if (debug) {
+		delta = ktime_sub(ktime_get(), calltime);
+		spin_lock(&probe_stats_lock);
+		probe_stats.wait_usecs += ktime_to_ns(delta) >> 10;
+		spin_unlock(&probe_stats_lock);
+	}
 }
 EXPORT_SYMBOL_GPL(wait_for_device_probe);
 
@@ -205,22 +339,113 @@ int driver_probe_device(struct device_driver *drv, struct device *dev)
 
 	pm_runtime_get_noresume(dev);
 	pm_runtime_barrier(dev);
-	ret = really_probe(dev, drv);
+	if (initcall_debug && system_state == SYSTEM_BOOTING)
+		ret = really_probe_debug(dev, drv);
+	else
+		ret = really_probe(dev, drv);
 	pm_runtime_put_sync(dev);
 
 	return ret;
 }
 
-static int __device_attach(struct device_driver *drv, void *data)
+/*
+ * Queue an asynchronous probe of @dev, once dev->p->async_probe is set
+ * under the device lock.  The lock must be dropped by now: with the async
+ * threads not started yet, or if the call can't be queued, @func runs
+ * right away.
+ */
+static void async_probe_schedule(struct device *dev, async_func_ptr *func)
 {
-	struct device *dev = data;
+	get_device(dev);
+	atomic_inc(&probe_count);
+	dev->p->async_scheduler = current;
+	async_schedule_domain(func, dev, &async_probe_domain);
+	/* Unless the probe is over and another one scheduled already */
+	cmpxchg(&dev->p->async_scheduler, current, NULL);
+}
+
+/*
+ * Returns false if the probe runs right away, from async_probe_schedule():
+ * it is then as synchronous as its caller, which may hold the parent lock
+ * and may be an asynchronous probe itself, the one of the parent even.
+ * Waiting for the cookie would have us wait for ourselves.
+ */
+static bool async_probe_start(struct device *dev, async_cookie_t cookie)
+{
+	if (dev->p->async_scheduler == current)
+		return false;
+
+	if (parent_probe_pending(dev))
+		async_synchronize_cookie_domain(cookie, &async_probe_domain);
+	return true;
+}
+
+/* Called once dev->p->async_probe is cleared under the device lock */
+static void async_probe_done(struct device *dev)
+{
+	atomic_dec(&probe_count);
+	wake_up(&probe_waitqueue);
+	put_device(dev);
+}
+
+struct device_attach_data {
+	struct device *dev;
+	bool check_async;	/* queue asynchronous probes instead */
+	bool have_async;	/* such a probe is wanted */
+};
+
+static int __device_attach(struct device_driver *drv, void *_data)
+{
+	struct device_attach_data *data = _data;
+	struct device *dev = data->dev;
 
 	if (!driver_match_device(drv, dev))
 		return 0;
 
+	if (data->check_async && device_wants_async_probe(dev, drv)) {
+		data->have_async = true;
+		return 0;
+	}
+
 	return driver_probe_device(drv, dev);
 }
 
+static void __device_attach_async_helper(void *_dev, async_cookie_t cookie)
+{
+	struct device *dev = _dev;
+	struct device_attach_data data = {
+		.dev		= dev,
+		.check_async	= false,
+	};
+	bool lock_parent;
+	int ret = 0;
+
+	/*
+	 * Run right away, the caller of device_attach() holds the parent
+	 * lock if needed; from an async thread, we take it like
+	 * __driver_attach() does.
+	 */
+	lock_parent = async_probe_start(dev, cookie) && dev->parent;
+
+	if (lock_parent)	/* Needed for USB */
+		device_lock(dev->parent);
+	device_lock(dev);
+	if (!dev->driver) {
+		pm_runtime_get_noresume(dev);
+		ret = bus_for_each_drv(dev->bus, NULL, &data, __device_attach);
+		pm_runtime_put_sync(dev);
+	}
+	dev->p->async_probe = false;
+	device_unlock(dev);
+	if (lock_parent)
+		device_unlock(dev->parent);
+
+	pr_debug("bus: '%s': %s: async probe of %s returned %d\n",
+		 dev->bus->name, __func__, dev_name(dev), ret);
+
+	async_probe_done(dev);
+}
+
 /**
  * device_attach - try to attach device to a driver.
  * @dev: device.
@@ -230,13 +455,19 @@ static int __device_attach(struct device_driver *drv, void *data)
  * pair is found, break out and return.
  *
  * Returns 1 if the device was bound to a driver;
- * 0 if no matching driver was found;
+ * 0 if no matching driver was found, or if the device is left to be
+ * probed asynchronously;
  * -ENODEV if the device is not registered.
  *
  * When called for a USB interface, @dev->parent lock must be held.
  */
 int device_attach(struct device *dev)
 {
+	struct device_attach_data data = {
+		.dev		= dev,
+		.check_async	= true,
+	};
+	bool async = false;
 	int ret = 0;
 
 	device_lock(dev);
@@ -250,17 +481,46 @@ int device_attach(struct device *dev)
 		}
 	} else {
 		pm_runtime_get_noresume(dev);
-		ret = bus_for_each_drv(dev->bus, NULL, dev, __device_attach);
+		ret = bus_for_each_drv(dev->bus, NULL, &data, __device_attach);
 		pm_runtime_put_sync(dev);
+		if (!ret && data.have_async && !dev->p->async_probe) {
+			dev->p->async_probe = true;
+			async = true;
+		}
 	}
 	device_unlock(dev);
+
+	if (async)
+		async_probe_schedule(dev, __device_attach_async_helper);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(device_attach);
 
+static void __driver_attach_async_helper(void *_dev, async_cookie_t cookie)
+{
+	struct device *dev = _dev;
+	struct device_driver *drv = dev->p->async_driver;
+
+	async_probe_start(dev, cookie);
+
+	if (dev->parent)	/* Needed for USB */
+		device_lock(dev->parent);
+	device_lock(dev);
+	if (!dev->driver)
+		driver_probe_device(drv, dev);
+	dev->p->async_driver = NULL;
+	dev->p->async_probe = false;
+	device_unlock(dev);
+	if (dev->parent)
+		device_unlock(dev->parent);
+
+	async_probe_done(dev);
+}
+
 static int __driver_attach(struct device *dev, void *data)
 {
 	struct device_driver *drv = data;
+	bool async = false;
 
 	/*
 	 * Lock device and try to bind to it. We drop the error
@@ -275,6 +535,20 @@ static int __driver_attach(struct device *dev, void *data)
 	if (!driver_match_device(drv, dev))
 		return 0;
 
+	if (device_wants_async_probe(dev, drv)) {
+		device_lock(dev);
+		if (!dev->driver && !dev->p->async_probe) {
+			dev->p->async_probe = true;
+			dev->p->async_driver = drv;
+			async = true;
+		}
+		device_unlock(dev);
+
+		if (async)
+			async_probe_schedule(dev, __driver_attach_async_helper);
+		return 0;
+	}
+
 	if (dev->parent)	/* Needed for USB */
 		device_lock(dev->parent);
 	device_lock(dev);
@@ -367,6 +641,9 @@ void driver_detach(struct device_driver *drv)
 	struct device_private *dev_prv;
 	struct device *dev;
 
+	/* Asynchronous probes queued for the driver still use it */
+	async_synchronize_full_domain(&async_probe_domain);
+
 	for (;;) {
 		spin_lock(&drv->p->klist_devices.k_lock);
 		if (list_empty(&drv->p->klist_devices.k_list)) {
@@ -680,6 +680,7 @@ static int mmc_blk_resume(struct mmc_card *card)
 static struct mmc_driver mmc_driver = {
 	.drv		= {
 		.name	= "mmcblk",
+		.probe_async = true,
 	},
 	.probe		= mmc_blk_probe,
 	.remove		= mmc_blk_remove,
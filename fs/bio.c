@@ -230,6 +230,58 @@ fallback:
 	return bvl;
 }
 
+/*
+ * Take a bio from this cpu's cache, refilling it with one bulk allocation
+ * when empty.  The refill never sleeps nor dips into the reserves: when
+ * it fails the caller falls back to the mempool, which may wait.
+ */
+static void *bio_cache_get(struct bio_set *bs, gfp_t gfp_mask)
+{
+	struct bio_alloc_cache *cache;
+	unsigned long flags;
+	void *p = NULL;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(bs->cache);
+	if (!cache->nr) {
+		gfp_mask &= ~(__GFP_WAIT | __GFP_IO);
+		gfp_mask |= __GFP_NOMEMALLOC | __GFP_NORETRY | __GFP_NOWARN;
+		cache->nr = kmem_cache_alloc_bulk(bs->bio_slab, gfp_mask,
+						  BIO_CACHE_BULK, cache->objs);
+	}
+	if (cache->nr)
+		p = cache->objs[--cache->nr];
+	local_irq_restore(flags);
+	return p;
+}
+
+/*
+ * The mempool reserve is topped up first, so that waiters in
+ * mempool_alloc() still make progress.  Otherwise the bio goes to this
+ * cpu's cache, which hands half of itself back to the slab when full.
+ * Caches of cpus going offline are only returned by bioset_free().
+ */
+static void bio_cache_put(struct bio_set *bs, void *p)
+{
+	struct bio_alloc_cache *cache;
+	unsigned long flags;
+
+	if (bs->bio_pool->curr_nr < bs->bio_pool->min_nr) {
+		mempool_free(p, bs->bio_pool);
+		return;
+	}
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(bs->cache);
+	if (cache->nr == BIO_CACHE_SIZE) {
+		cache->nr = BIO_CACHE_SIZE / 2;
+		kmem_cache_free_bulk(bs->bio_slab, BIO_CACHE_SIZE / 2,
+				     cache->objs + cache->nr);
+	}
+	cache->objs[cache->nr++] = p;
+	local_irq_restore(flags);
+}
+
 void bio_free(struct bio *bio, struct bio_set *bs)
 {
 	void *p;
@@ -247,7 +299,7 @@ void bio_free(struct bio *bio, struct bio_set *bs)
 	if (bs->front_pad)
 		p -= bs->front_pad;
 
-	mempool_free(p, bs->bio_pool);
+	bio_cache_put(bs, p);
 }
 EXPORT_SYMBOL(bio_free);
 
@@ -282,7 +334,9 @@ struct bio *bio_alloc_bioset(gfp_t gfp_mask, int nr_iovecs, struct bio_set *bs)
 	struct bio *bio;
 	void *p;
 
-	p = mempool_alloc(bs->bio_pool, gfp_mask);
+	p = bio_cache_get(bs, gfp_mask);
+	if (!p)
+		p = mempool_alloc(bs->bio_pool, gfp_mask);
 	if (unlikely(!p))
 		return NULL;
 	bio = p + bs->front_pad;
@@ -309,7 +363,7 @@ out_set:
 	return bio;
 
 err_free:
-	mempool_free(p, bs->bio_pool);
+	bio_cache_put(bs, p);
 	return NULL;
 }
 EXPORT_SYMBOL(bio_alloc_bioset);
@@ -1571,6 +1625,19 @@ static void biovec_free_pools(struct bio_set *bs)
 
 void bioset_free(struct bio_set *bs)
 {
+	int cpu;
+
+	if (bs->cache) {
+		for_each_possible_cpu(cpu) {
+			struct bio_alloc_cache *cache = per_cpu_ptr(bs->cache,
+								    cpu);
+
+			kmem_cache_free_bulk(bs->bio_slab, cache->nr,
+					     cache->objs);
+		}
+		free_percpu(bs->cache);
+	}
+
 	if (bs->bio_pool)
 		mempool_destroy(bs->bio_pool);
 
@@ -1612,6 +1679,10 @@ struct bio_set *bioset_create(unsigned int pool_size, unsigned int front_pad)
 		return NULL;
 	}
 
+	bs->cache = alloc_percpu(struct bio_alloc_cache);
+	if (!bs->cache)
+		goto bad;
+
 	bs->bio_pool = mempool_create_slab_pool(pool_size, bs->bio_slab);
 	if (!bs->bio_pool)
 		goto bad;
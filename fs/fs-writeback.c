@@ -92,7 +92,8 @@ static inline void bdi_work_init(struct bdi_work *work,
  */
 int writeback_in_progress(struct backing_dev_info *bdi)
 {
-	return !list_empty(&bdi->work_list);
+	return test_bit(BDI_writeback_running, &bdi->state) ||
+		!list_empty(&bdi->work_list);
 }
 
 static void bdi_work_clear(struct bdi_work *work)
@@ -752,6 +753,7 @@ static long wb_writeback(struct bdi_writeback *wb,
 		.for_background		= args->for_background,
 		.range_cyclic		= args->range_cyclic,
 	};
+	unsigned long wb_start = jiffies;
 	unsigned long oldest_jif;
 	long wrote = 0;
 	struct inode *inode;
@@ -787,6 +789,9 @@ static long wb_writeback(struct bdi_writeback *wb,
 		args->nr_pages -= MAX_WRITEBACK_PAGES - wbc.nr_to_write;
 		wrote += MAX_WRITEBACK_PAGES - wbc.nr_to_write;
 
+		/* Keep the estimates going when nobody is being throttled */
+		bdi_update_bandwidth(wb->bdi, 0, 0, 0, 0, 0, wb_start);
+
 		/*
 		 * If we consumed everything, see if we have more
 		 */
@@ -885,6 +890,7 @@ long wb_do_writeback(struct bdi_writeback *wb, int force_wait)
 	struct bdi_work *work;
 	long wrote = 0;
 
+	set_bit(BDI_writeback_running, &bdi->state);
 	while ((work = get_next_work_item(bdi, wb)) != NULL) {
 		struct wb_writeback_args args = work->args;
 
@@ -915,6 +921,7 @@ long wb_do_writeback(struct bdi_writeback *wb, int force_wait)
 	 * Check for periodic writeback, kupdated() style
 	 */
 	wrote += wb_check_old_data_flush(wb);
+	clear_bit(BDI_writeback_running, &bdi->state);
 
 	return wrote;
 }
@@ -0,0 +1,14 @@
+#ifndef _LINUX_BENCH_H
+#define _LINUX_BENCH_H
+
+/*
+ * Support for the benchmark modules (CONFIG_*_BENCH): see kernel/bench.c
+ */
+
+struct cpumask;
+
+extern int bench_on_each_cpu(const char *name,
+			     void (*fn)(int cpu, void *data), void *data,
+			     struct cpumask *ran);
+
+#endif /* _LINUX_BENCH_H */
@@ -432,10 +432,23 @@ static inline void bio_set_completion_cpu(struct bio *bio, unsigned int cpu)
 #define BIOVEC_NR_POOLS 6
 #define BIOVEC_MAX_IDX	(BIOVEC_NR_POOLS - 1)
 
+/*
+ * Per-cpu cache of bio_slab objects in front of the mempool, refilled
+ * and trimmed in batches with the bulk slab calls.
+ */
+#define BIO_CACHE_SIZE		32
+#define BIO_CACHE_BULK		16
+
+struct bio_alloc_cache {
+	unsigned int nr;
+	void *objs[BIO_CACHE_SIZE];
+};
+
 struct bio_set {
 	struct kmem_cache *bio_slab;
 	unsigned int front_pad;
 
+	struct bio_alloc_cache __percpu *cache;
 	mempool_t *bio_pool;
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
 	mempool_t *bio_integrity_pool;
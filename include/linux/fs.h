@@ -884,6 +884,19 @@ struct fown_struct {
 	int signum;		/* posix.1b rt signal to be delivered on IO */
 };
 
+/*
+ * A sequential stream parked while another stream of the same file is
+ * being read.  See "Interleaved streams" in mm/readahead.c.
+ */
+struct ra_stream {
+	pgoff_t start;
+	unsigned int size;
+	unsigned int async_size;
+};
+
+/* Streams tracked per file, including the current one in file_ra_state */
+#define RA_MAX_STREAMS		4
+
 /*
  * Track a single file's readahead state
  */
@@ -896,6 +909,14 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	struct ra_stream streams[RA_MAX_STREAMS - 1];	/* parked streams,
+							   most recent first */
+	pgoff_t stride_prev;		/* last non-sequential miss */
+	pgoff_t stride_next;		/* PG_readahead mark of stride window */
+	long stride;			/* distance between the last misses */
+	unsigned int stride_len;	/* pages read at each stride */
+	unsigned int stride_hits;	/* times in a row stride was seen */
 };
 
 /*
@@ -48,12 +48,18 @@ extern void mem_cgroup_cancel_charge_swapin(struct mem_cgroup *ptr);
 
 extern int mem_cgroup_cache_charge(struct page *page, struct mm_struct *mm,
 					gfp_t gfp_mask);
-extern void mem_cgroup_add_lru_list(struct page *page, enum lru_list lru);
+extern struct list_head *mem_cgroup_add_lru_list(struct zone *zone,
+				struct page *page, enum lru_list lru);
 extern void mem_cgroup_del_lru_list(struct page *page, enum lru_list lru);
-extern void mem_cgroup_rotate_lru_list(struct page *page, enum lru_list lru);
+extern struct list_head *mem_cgroup_lru_list(struct zone *zone,
+				struct page *page, enum lru_list lru);
 extern void mem_cgroup_del_lru(struct page *page);
-extern void mem_cgroup_move_lists(struct page *page,
-				  enum lru_list from, enum lru_list to);
+extern struct list_head *mem_cgroup_move_lists(struct zone *zone,
+		struct page *page, enum lru_list from, enum lru_list to);
+extern struct list_head *mem_cgroup_zone_lru_next(struct zone *zone,
+		enum lru_list lru, struct mem_cgroup **iter,
+		unsigned long *nr_pages);
+extern void mem_cgroup_zone_lru_break(struct mem_cgroup *iter);
 
 /* For coalescing uncharge for reducing memcg' overhead*/
 extern void mem_cgroup_uncharge_start(void);
@@ -180,8 +186,10 @@ static inline int mem_cgroup_shmem_charge_fallback(struct page *page,
 	return 0;
 }
 
-static inline void mem_cgroup_add_lru_list(struct page *page, int lru)
+static inline struct list_head *
+mem_cgroup_add_lru_list(struct zone *zone, struct page *page, int lru)
 {
+	return &zone->lru[lru].list;
 }
 
 static inline void mem_cgroup_del_lru_list(struct page *page, int lru)
@@ -189,9 +197,10 @@ static inline void mem_cgroup_del_lru_list(struct page *page, int lru)
 	return ;
 }
 
-static inline void mem_cgroup_rotate_lru_list(struct page *page, int lru)
+static inline struct list_head *
+mem_cgroup_lru_list(struct zone *zone, struct page *page, int lru)
 {
-	return ;
+	return &zone->lru[lru].list;
 }
 
 static inline void mem_cgroup_del_lru(struct page *page)
@@ -199,8 +208,20 @@ static inline void mem_cgroup_del_lru(struct page *page)
 	return ;
 }
 
-static inline void
-mem_cgroup_move_lists(struct page *page, enum lru_list from, enum lru_list to)
+static inline struct list_head *mem_cgroup_move_lists(struct zone *zone,
+		struct page *page, enum lru_list from, enum lru_list to)
+{
+	return &zone->lru[to].list;
+}
+
+static inline struct list_head *mem_cgroup_zone_lru_next(struct zone *zone,
+		enum lru_list lru, struct mem_cgroup **iter,
+		unsigned long *nr_pages)
+{
+	return NULL;
+}
+
+static inline void mem_cgroup_zone_lru_break(struct mem_cgroup *iter)
 {
 }
 
@@ -183,6 +183,9 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SWAP
+	atomic_long_t swap_readahead_info; /* see swap_vma_readahead() */
+#endif
 };
 
 struct core_thread {
@@ -310,6 +313,10 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_FUTEX
+	/* hash table of the private futexes, see kernel/futex.c */
+	struct futex_hash *futex_hash;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
@@ -166,6 +166,12 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Orders 1 to PCP_MAX_HIGH_ORDER are cached on the per-cpu lists too, so
+ * that kernel stacks, slab refills and jumbo frames avoid zone->lock.
+ */
+#define PCP_MAX_HIGH_ORDER	3
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
@@ -173,6 +179,11 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* Order 1..PCP_MAX_HIGH_ORDER pages, counted in base pages */
+	int high_order_count;
+	int high_order_high;
+	struct list_head high_order_lists[PCP_MAX_HIGH_ORDER][MIGRATE_PCPTYPES];
 };
 
 struct per_cpu_pageset {
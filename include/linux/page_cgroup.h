@@ -9,12 +9,20 @@
  * page_cgroup helps us identify information about the cgroup
  * All page cgroups are allocated at boot or memory hotplug event,
  * then the page cgroup for pfn always exists.
+ *
+ * As there is one per page, it is kept as small as possible:
+ * - the page is found from the position of the page_cgroup in its array,
+ *   whose id (node with flatmem, section with sparsemem) sits in the top
+ *   bits of flags;
+ * - the owner is the css_id of its mem_cgroup, kept in flags on 64bit;
+ * - there is no LRU linkage: a charged page is linked to its mem_cgroup's
+ *   per-zone LRU through page->lru, instead of the zone's LRU.
  */
 struct page_cgroup {
 	unsigned long flags;
-	struct mem_cgroup *mem_cgroup;
-	struct page *page;
-	struct list_head lru;		/* per cgroup LRU list */
+#if BITS_PER_LONG == 32
+	unsigned short mem_cgroup;	/* css_id of the owner */
+#endif
 };
 
 void __meminit pgdat_page_cgroup_init(struct pglist_data *pgdat);
@@ -32,6 +40,7 @@ static inline void __init page_cgroup_init(void)
 #endif
 
 struct page_cgroup *lookup_page_cgroup(struct page *page);
+struct page *lookup_cgroup_page(struct page_cgroup *pc);
 
 enum {
 	/* flags for mem_cgroup */
@@ -40,8 +49,28 @@ enum {
 	PCG_USED, /* this object is in use. */
 	PCG_ACCT_LRU, /* page has been accounted for */
 	PCG_FILE_MAPPED, /* page is accounted as "mapped" */
+	NR_PCG_FLAGS,
 };
 
+/*
+ * Layout of page_cgroup->flags, from the low bits up: the PCG_ flags,
+ * the owner's css_id (64bit only), then the array id.
+ */
+#define PCG_ID_SHIFT		16
+#define PCG_ID_MASK		0xffffUL
+
+#if BITS_PER_LONG == 32
+#define PCG_ARRAYID_SHIFT	16
+#else
+#define PCG_ARRAYID_SHIFT	32
+#endif
+#ifdef CONFIG_SPARSEMEM
+#define PCG_ARRAYID_WIDTH	SECTIONS_SHIFT
+#else
+#define PCG_ARRAYID_WIDTH	NODES_SHIFT
+#endif
+#define PCG_ARRAYID_MASK	((1UL << PCG_ARRAYID_WIDTH) - 1)
+
 #define TESTPCGFLAG(uname, lname)			\
 static inline int PageCgroup##uname(struct page_cgroup *pc)	\
 	{ return test_bit(PCG_##lname, &pc->flags); }
@@ -79,14 +108,43 @@ SETPCGFLAG(FileMapped, FILE_MAPPED)
 CLEARPCGFLAG(FileMapped, FILE_MAPPED)
 TESTPCGFLAG(FileMapped, FILE_MAPPED)
 
-static inline int page_cgroup_nid(struct page_cgroup *pc)
+/* Only set up at init, before anything else can look at the flags */
+static inline void set_page_cgroup_array_id(struct page_cgroup *pc,
+					    unsigned long id)
 {
-	return page_to_nid(pc->page);
+	pc->flags &= ~(PCG_ARRAYID_MASK << PCG_ARRAYID_SHIFT);
+	pc->flags |= (id & PCG_ARRAYID_MASK) << PCG_ARRAYID_SHIFT;
 }
 
-static inline enum zone_type page_cgroup_zid(struct page_cgroup *pc)
+static inline unsigned long page_cgroup_array_id(struct page_cgroup *pc)
 {
-	return page_zonenum(pc->page);
+	return (pc->flags >> PCG_ARRAYID_SHIFT) & PCG_ARRAYID_MASK;
+}
+
+static inline unsigned short page_cgroup_id(struct page_cgroup *pc)
+{
+#if BITS_PER_LONG == 32
+	return pc->mem_cgroup;
+#else
+	return (pc->flags >> PCG_ID_SHIFT) & PCG_ID_MASK;
+#endif
+}
+
+static inline void set_page_cgroup_id(struct page_cgroup *pc,
+				      unsigned short id)
+{
+#if BITS_PER_LONG == 32
+	pc->mem_cgroup = id;
+#else
+	unsigned long old, new;
+
+	/* The flags around it change with atomic bitops, without PCG_LOCK */
+	do {
+		old = pc->flags;
+		new = (old & ~(PCG_ID_MASK << PCG_ID_SHIFT)) |
+			((unsigned long)id << PCG_ID_SHIFT);
+	} while (cmpxchg(&pc->flags, old, new) != old);
+#endif
 }
 
 static inline void lock_page_cgroup(struct page_cgroup *pc)
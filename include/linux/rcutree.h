@@ -36,6 +36,9 @@ extern void rcu_sched_qs(int cpu);
 extern void rcu_bh_qs(int cpu);
 extern int rcu_needs_cpu(int cpu);
 extern int rcu_expedited_torture_stats(char *page);
+#ifdef CONFIG_NO_HZ_FULL
+extern int rcu_nohz_full_needs_cpu(int cpu);
+#endif
 
 #ifdef CONFIG_TREE_PREEMPT_RCU
 
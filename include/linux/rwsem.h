@@ -22,6 +22,14 @@ struct rw_semaphore;
 #include <asm/rwsem.h> /* use an arch-specific implementation */
 #endif
 
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * ->owner of a semaphore last taken for reading: writers do not spin on
+ * it, as there is no telling when the readers will be done.
+ */
+#define RWSEM_READER_OWNED	((struct thread_info *)1UL)
+#endif
+
 /*
  * lock for reading
  */
@@ -195,6 +195,10 @@ extern void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 				     void *timerf, char *comm,
 				     unsigned int timer_flag);
 
+extern void timer_stats_update_cascade(unsigned long nr, u64 ns, int at_wrap);
+extern void timer_stats_update_migration(void);
+extern unsigned long timer_stats_pending_timers(int cpu);
+
 extern void __timer_stats_timer_set_start_info(struct timer_list *timer,
 					       void *addr);
 
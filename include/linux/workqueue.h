@@ -17,8 +17,9 @@ struct work_struct;
 typedef void (*work_func_t)(struct work_struct *work);
 
 /*
- * The first word is the work queue pointer and the flags rolled into
- * one
+ * The first word is the cpu_workqueue_struct pointer and the flags rolled
+ * into one.  cpu_workqueue_structs are aligned to 1 << WORK_STRUCT_FLAG_BITS
+ * to leave room for the flags and the flush color.
  */
 #define work_data_bits(work) ((unsigned long *)(&(work)->data))
 
@@ -26,7 +27,12 @@ struct work_struct {
 	atomic_long_t data;
 #define WORK_STRUCT_PENDING 0		/* T if work item pending execution */
 #define WORK_STRUCT_STATIC  1		/* static initializer (debugobjects) */
-#define WORK_STRUCT_FLAG_MASK (3UL)
+#define WORK_STRUCT_DELAYED 2		/* held back by the wq's max_active */
+#define WORK_STRUCT_LINKED  3		/* next work is a barrier linked to it */
+#define WORK_STRUCT_COLOR_SHIFT 4	/* flush color, see flush_workqueue() */
+#define WORK_STRUCT_COLOR_BITS 2
+#define WORK_STRUCT_FLAG_BITS (WORK_STRUCT_COLOR_SHIFT + WORK_STRUCT_COLOR_BITS)
+#define WORK_STRUCT_FLAG_MASK ((1UL << WORK_STRUCT_FLAG_BITS) - 1)
 #define WORK_STRUCT_WQ_DATA_MASK (~WORK_STRUCT_FLAG_MASK)
 	struct list_head entry;
 	work_func_t func;
@@ -180,13 +186,22 @@ static inline void destroy_work_on_stack(struct work_struct *work) { }
 	clear_bit(WORK_STRUCT_PENDING, work_data_bits(work))
 
 
+/*
+ * Workqueue flags and limits, see alloc_workqueue().
+ */
+#define WQ_FREEZEABLE		(1 << 0) /* max_active drops to 0 while frozen */
+#define WQ_SINGLE_THREAD	(1 << 1) /* all works run on one cpu, in order */
+#define WQ_RESCUER		(1 << 2) /* has a rescuer for memory reclaim */
+
+#define WQ_MAX_ACTIVE		512	 /* in flight per cpu and workqueue */
+#define WQ_DFL_ACTIVE		(WQ_MAX_ACTIVE / 2)
+
 extern struct workqueue_struct *
-__create_workqueue_key(const char *name, int singlethread,
-		       int freezeable, int rt, struct lock_class_key *key,
-		       const char *lock_name);
+__alloc_workqueue_key(const char *name, unsigned int flags, int max_active,
+		      struct lock_class_key *key, const char *lock_name);
 
 #ifdef CONFIG_LOCKDEP
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
+#define alloc_workqueue(name, flags, max_active)		\
 ({								\
 	static struct lock_class_key __key;			\
 	const char *__lock_name;				\
@@ -196,20 +211,26 @@ __create_workqueue_key(const char *name, int singlethread,
 	else							\
 		__lock_name = #name;				\
 								\
-	__create_workqueue_key((name), (singlethread),		\
-			       (freezeable), (rt), &__key,	\
-			       __lock_name);			\
+	__alloc_workqueue_key((name), (flags), (max_active),	\
+			      &__key, __lock_name);		\
 })
 #else
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
-	__create_workqueue_key((name), (singlethread), (freezeable), (rt), \
-			       NULL, NULL)
+#define alloc_workqueue(name, flags, max_active)		\
+	__alloc_workqueue_key((name), (flags), (max_active), NULL, NULL)
 #endif
 
-#define create_workqueue(name) __create_workqueue((name), 0, 0, 0)
-#define create_rt_workqueue(name) __create_workqueue((name), 0, 0, 1)
-#define create_freezeable_workqueue(name) __create_workqueue((name), 1, 1, 0)
-#define create_singlethread_workqueue(name) __create_workqueue((name), 1, 0, 0)
+/*
+ * The legacy interfaces used to give each workqueue its own thread per
+ * cpu (or a single one).  They now map onto the shared worker pools: one
+ * work in flight per cpu (or at all) keeps their ordering, and the rescuer
+ * keeps their forward progress guarantee under memory pressure.
+ */
+#define create_workqueue(name)					\
+	alloc_workqueue((name), WQ_RESCUER, 1)
+#define create_freezeable_workqueue(name)			\
+	alloc_workqueue((name), WQ_FREEZEABLE | WQ_SINGLE_THREAD | WQ_RESCUER, 1)
+#define create_singlethread_workqueue(name)			\
+	alloc_workqueue((name), WQ_SINGLE_THREAD | WQ_RESCUER, 1)
 
 extern void destroy_workqueue(struct workqueue_struct *wq);
 
@@ -289,6 +310,12 @@ void cancel_rearming_delayed_work(struct delayed_work *work)
 	cancel_delayed_work_sync(work);
 }
 
+#ifdef CONFIG_FREEZER
+extern void freeze_workqueues_begin(void);
+extern bool freeze_workqueues_busy(void);
+extern void thaw_workqueues(void);
+#endif /* CONFIG_FREEZER */
+
 #ifndef CONFIG_SMP
 static inline long work_on_cpu(unsigned int cpu, long (*fn)(void *), void *arg)
 {
@@ -0,0 +1,39 @@
+#ifndef _LINUX_ZSWAP_H
+#define _LINUX_ZSWAP_H
+
+#include <linux/types.h>
+
+struct page;
+
+#ifdef CONFIG_ZSWAP
+/*
+ * Compressed swap cache front-end: see mm/zswap.c.
+ *
+ * zswap_store() and zswap_load() return 0 when the page was taken care
+ * of by the pool, non-zero when the caller must fall back to block I/O.
+ */
+extern int zswap_store(struct page *page);
+extern int zswap_load(struct page *page);
+extern void zswap_invalidate_page(unsigned type, pgoff_t offset);
+extern void zswap_invalidate_area(unsigned type);
+#else
+static inline int zswap_store(struct page *page)
+{
+	return -1;
+}
+
+static inline int zswap_load(struct page *page)
+{
+	return -1;
+}
+
+static inline void zswap_invalidate_page(unsigned type, pgoff_t offset)
+{
+}
+
+static inline void zswap_invalidate_area(unsigned type)
+{
+}
+#endif /* CONFIG_ZSWAP */
+
+#endif /* _LINUX_ZSWAP_H */
@@ -0,0 +1,84 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lru
+
+#if !defined(_TRACE_LRU_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LRU_H
+
+#include <linux/types.h>
+#include <linux/mmzone.h>
+#include <linux/tracepoint.h>
+
+/* What a zone->lru_lock hold was taken for */
+#define LRU_OP_ADD		0	/* per-cpu lru_add batch */
+#define LRU_OP_ROTATE		1	/* per-cpu rotate batch */
+#define LRU_OP_ACTIVATE		2	/* per-cpu activate batch */
+#define LRU_OP_DEACTIVATE	3	/* per-cpu deactivate batch */
+#define LRU_OP_ISOLATE		4	/* reclaim isolating inactive pages */
+#define LRU_OP_LAZYFREE		5	/* per-cpu lazyfree batch */
+
+#define show_lru_op(op)							\
+	__print_symbolic(op,						\
+		{ LRU_OP_ADD,		"add" },			\
+		{ LRU_OP_ROTATE,	"rotate" },			\
+		{ LRU_OP_ACTIVATE,	"activate" },			\
+		{ LRU_OP_DEACTIVATE,	"deactivate" },			\
+		{ LRU_OP_ISOLATE,	"isolate" },			\
+		{ LRU_OP_LAZYFREE,	"lazyfree" })
+
+/*
+ * A per-cpu LRU batch being drained: @nr pages, possibly spread over
+ * several zones and so several lock holds.
+ */
+TRACE_EVENT(mm_lru_batch,
+
+	TP_PROTO(int op, unsigned int nr),
+
+	TP_ARGS(op, nr),
+
+	TP_STRUCT__entry(
+		__field(	int,		op	)
+		__field(	unsigned int,	nr	)
+	),
+
+	TP_fast_assign(
+		__entry->op	= op;
+		__entry->nr	= nr;
+	),
+
+	TP_printk("op=%s nr=%u", show_lru_op(__entry->op), __entry->nr)
+);
+
+/*
+ * One zone->lru_lock hold: @nr pages handled in @hold_ns nanoseconds.
+ */
+TRACE_EVENT(mm_lru_lock_hold,
+
+	TP_PROTO(struct zone *zone, int op, unsigned int nr, u64 hold_ns),
+
+	TP_ARGS(zone, op, nr, hold_ns),
+
+	TP_STRUCT__entry(
+		__field(	int,		nid	)
+		__field(	int,		zid	)
+		__field(	int,		op	)
+		__field(	unsigned int,	nr	)
+		__field(	u64,		hold_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->nid		= zone_to_nid(zone);
+		__entry->zid		= zone_idx(zone);
+		__entry->op		= op;
+		__entry->nr		= nr;
+		__entry->hold_ns	= hold_ns;
+	),
+
+	TP_printk("nid=%d zid=%d op=%s nr=%u hold_ns=%llu",
+		__entry->nid, __entry->zid, show_lru_op(__entry->op),
+		__entry->nr, (unsigned long long)__entry->hold_ns)
+);
+
+#endif /* _TRACE_LRU_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
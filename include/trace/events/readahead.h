@@ -0,0 +1,87 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM readahead
+
+#if !defined(_TRACE_READAHEAD_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_READAHEAD_H
+
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/tracepoint.h>
+
+/* Why ondemand_readahead() picked the window it submitted */
+#define RA_PATTERN_INITIAL	0	/* start of file or sequential miss */
+#define RA_PATTERN_SEQUENTIAL	1	/* current stream pushed forward */
+#define RA_PATTERN_STREAM	2	/* a parked stream resumed */
+#define RA_PATTERN_MARKER	3	/* PG_readahead hit, state rebuilt */
+#define RA_PATTERN_CONTEXT	4	/* cached history found */
+#define RA_PATTERN_OVERSIZE	5	/* read larger than the max window */
+#define RA_PATTERN_STRIDE	6	/* strided window */
+#define RA_PATTERN_RANDOM	7	/* read as is */
+
+#define show_ra_pattern(pattern)					\
+	__print_symbolic(pattern,					\
+		{ RA_PATTERN_INITIAL,		"initial" },		\
+		{ RA_PATTERN_SEQUENTIAL,	"sequential" },		\
+		{ RA_PATTERN_STREAM,		"stream" },		\
+		{ RA_PATTERN_MARKER,		"marker" },		\
+		{ RA_PATTERN_CONTEXT,		"context" },		\
+		{ RA_PATTERN_OVERSIZE,		"oversize" },		\
+		{ RA_PATTERN_STRIDE,		"stride" },		\
+		{ RA_PATTERN_RANDOM,		"random" })
+
+/*
+ * One event per readahead decision.  Decisions with async=1 were
+ * triggered by the application reaching a PG_readahead page, that is a
+ * readahead hit; async=0 ones come from a page cache miss.  Comparing
+ * the two for a workload gives the readahead hit rate.
+ */
+TRACE_EVENT(mm_readahead,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t offset,
+		 unsigned long req_size, int async, int pattern,
+		 pgoff_t start, unsigned long size,
+		 unsigned long async_size, unsigned long actual),
+
+	TP_ARGS(mapping, offset, req_size, async, pattern, start, size,
+		async_size, actual),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,		dev		)
+		__field(	ino_t,		ino		)
+		__field(	pgoff_t,	offset		)
+		__field(	unsigned long,	req_size	)
+		__field(	int,		async		)
+		__field(	int,		pattern		)
+		__field(	pgoff_t,	start		)
+		__field(	unsigned long,	size		)
+		__field(	unsigned long,	async_size	)
+		__field(	unsigned long,	actual		)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= mapping->host->i_sb->s_dev;
+		__entry->ino		= mapping->host->i_ino;
+		__entry->offset		= offset;
+		__entry->req_size	= req_size;
+		__entry->async		= async;
+		__entry->pattern	= pattern;
+		__entry->start		= start;
+		__entry->size		= size;
+		__entry->async_size	= async_size;
+		__entry->actual		= actual;
+	),
+
+	TP_printk("dev %d,%d ino %lu offset=%lu req_size=%lu async=%d "
+		  "pattern=%s start=%lu size=%lu async_size=%lu actual=%lu",
+		MAJOR(__entry->dev), MINOR(__entry->dev),
+		(unsigned long)__entry->ino,
+		(unsigned long)__entry->offset, __entry->req_size,
+		__entry->async, show_ra_pattern(__entry->pattern),
+		(unsigned long)__entry->start, __entry->size,
+		__entry->async_size, __entry->actual)
+);
+
+#endif /* _TRACE_READAHEAD_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
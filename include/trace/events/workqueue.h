@@ -8,43 +8,50 @@
 #include <linux/sched.h>
 #include <linux/tracepoint.h>
 
-DECLARE_EVENT_CLASS(workqueue,
+/* Trace a work being queued for the worker pool of a cpu */
+TRACE_EVENT(workqueue_insertion,
 
-	TP_PROTO(struct task_struct *wq_thread, struct work_struct *work),
+	TP_PROTO(unsigned int cpu, struct work_struct *work),
 
-	TP_ARGS(wq_thread, work),
+	TP_ARGS(cpu, work),
 
 	TP_STRUCT__entry(
-		__array(char,		thread_comm,	TASK_COMM_LEN)
-		__field(pid_t,		thread_pid)
+		__field(unsigned int,	cpu)
 		__field(work_func_t,	func)
 	),
 
 	TP_fast_assign(
-		memcpy(__entry->thread_comm, wq_thread->comm, TASK_COMM_LEN);
-		__entry->thread_pid	= wq_thread->pid;
+		__entry->cpu		= cpu;
 		__entry->func		= work->func;
 	),
 
-	TP_printk("thread=%s:%d func=%pf", __entry->thread_comm,
-		__entry->thread_pid, __entry->func)
+	TP_printk("cpu=%u func=%pf", __entry->cpu, __entry->func)
 );
 
-DEFINE_EVENT(workqueue, workqueue_insertion,
+/* Trace a worker thread running a work */
+TRACE_EVENT(workqueue_execution,
 
 	TP_PROTO(struct task_struct *wq_thread, struct work_struct *work),
 
-	TP_ARGS(wq_thread, work)
-);
+	TP_ARGS(wq_thread, work),
 
-DEFINE_EVENT(workqueue, workqueue_execution,
+	TP_STRUCT__entry(
+		__array(char,		thread_comm,	TASK_COMM_LEN)
+		__field(pid_t,		thread_pid)
+		__field(work_func_t,	func)
+	),
 
-	TP_PROTO(struct task_struct *wq_thread, struct work_struct *work),
+	TP_fast_assign(
+		memcpy(__entry->thread_comm, wq_thread->comm, TASK_COMM_LEN);
+		__entry->thread_pid	= wq_thread->pid;
+		__entry->func		= work->func;
+	),
 
-	TP_ARGS(wq_thread, work)
+	TP_printk("thread=%s:%d func=%pf", __entry->thread_comm,
+		__entry->thread_pid, __entry->func)
 );
 
-/* Trace the creation of one workqueue thread on a cpu */
+/* Trace the creation of one worker thread for the pool of a cpu */
 TRACE_EVENT(workqueue_creation,
 
 	TP_PROTO(struct task_struct *wq_thread, int cpu),
@@ -69,21 +76,24 @@ TRACE_EVENT(workqueue_creation,
 
 TRACE_EVENT(workqueue_destruction,
 
-	TP_PROTO(struct task_struct *wq_thread),
+	TP_PROTO(struct task_struct *wq_thread, int cpu),
 
-	TP_ARGS(wq_thread),
+	TP_ARGS(wq_thread, cpu),
 
 	TP_STRUCT__entry(
 		__array(char,	thread_comm,	TASK_COMM_LEN)
 		__field(pid_t,	thread_pid)
+		__field(int,	cpu)
 	),
 
 	TP_fast_assign(
 		memcpy(__entry->thread_comm, wq_thread->comm, TASK_COMM_LEN);
 		__entry->thread_pid	= wq_thread->pid;
+		__entry->cpu		= cpu;
 	),
 
-	TP_printk("thread=%s:%d", __entry->thread_comm, __entry->thread_pid)
+	TP_printk("thread=%s:%d cpu=%d", __entry->thread_comm,
+		__entry->thread_pid, __entry->cpu)
 );
 
 #endif /* _TRACE_WORKQUEUE_H */
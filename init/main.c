@@ -715,6 +715,24 @@ static char msgbuf[64];
 static struct boot_trace_call call;
 static struct boot_trace_ret ret;
 
+/* Boot time spent in initcalls, reported with initcall_debug */
+static ktime_t initcalls_start;
+static unsigned int nr_initcalls;
+static unsigned long long initcalls_usecs, slowest_initcall_usecs;
+static initcall_t slowest_initcall;
+
+static void initcall_account(initcall_t fn, unsigned long long usecs)
+{
+	if (system_state != SYSTEM_BOOTING)
+		return;
+	nr_initcalls++;
+	initcalls_usecs += usecs;
+	if (usecs > slowest_initcall_usecs) {
+		slowest_initcall_usecs = usecs;
+		slowest_initcall = fn;
+	}
+}
+
 int do_one_initcall(initcall_t fn)
 {
 	int count = preempt_count();
@@ -738,6 +756,7 @@ int do_one_initcall(initcall_t fn)
 		trace_boot_ret(&ret, fn);
 		printk("initcall %pF returned %d after %Ld usecs\n", fn,
 			ret.result, ret.duration);
+		initcall_account(fn, ret.duration);
 	}
 
 	msgbuf[0] = 0;
@@ -774,6 +793,25 @@ static void __init do_initcalls(void)
 	flush_scheduled_work();
 }
 
+/*
+ * The boot critical path, from the first initcall to the root filesystem
+ * being mounted: the initcalls, which include the synchronous probes,
+ * the wait for the asynchronous probes still running at the end, and the
+ * mount itself (or, with an initramfs, up to its init being started).
+ * Asynchronous work only adds to it when it is waited for.
+ */
+static void __init initcall_debug_report(void)
+{
+	ktime_t delta = ktime_sub(ktime_get(), initcalls_start);
+
+	printk("initcall: %u initcalls took %Lu usecs, slowest was %pF "
+	       "after %Lu usecs\n", nr_initcalls, initcalls_usecs,
+	       slowest_initcall, slowest_initcall_usecs);
+	driver_probe_report();
+	printk("initcall: boot critical path %Lu usecs to the root "
+	       "filesystem\n", (unsigned long long) ktime_to_ns(delta) >> 10);
+}
+
 /*
  * Ok, the machine is now initialized. None of the devices
  * have been touched yet, but the CPU subsystem is up and
@@ -797,6 +835,7 @@ static void __init do_pre_smp_initcalls(void)
 {
 	initcall_t *fn;
 
+	initcalls_start = ktime_get();
 	for (fn = __initcall_start; fn < __early_initcall_end; fn++)
 		do_one_initcall(*fn);
 }
@@ -813,8 +852,11 @@ static void run_init_process(char *init_filename)
 static noinline int init_post(void)
 	__releases(kernel_lock)
 {
-	/* need to finish all async __init code before freeing the memory */
-	async_synchronize_full();
+	/*
+	 * need to finish all async __init code, the asynchronous probes
+	 * included, before freeing the memory
+	 */
+	wait_for_device_probe();
 	free_initmem();
 	unlock_kernel();
 	mark_rodata_ro();
@@ -903,6 +945,9 @@ static int __init kernel_init(void * unused)
 		prepare_namespace();
 	}
 
+	if (initcall_debug)
+		initcall_debug_report();
+
 	/*
 	 * Ok, we have completed the initial bootup, and
 	 * we're essentially up and running. Get rid of the
@@ -0,0 +1,107 @@
+/*
+ * kernel/bench.c
+ *
+ * What the benchmark modules have in common: they run a measurement on
+ * every online cpu at once, from a thread bound to that cpu, and log
+ * the results once all of them are done.  They do so from their init
+ * function and return an error from it in the end, so that there is no
+ * module to remove before the next run.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/bench.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <asm/atomic.h>
+
+struct bench_run {
+	void (*fn)(int cpu, void *data);
+	void *data;
+	struct completion start;
+	atomic_t pending;
+	struct completion done;
+};
+
+struct bench_thread {
+	struct bench_run *run;
+	int cpu;
+};
+
+static int bench_thread_fn(void *arg)
+{
+	struct bench_thread *bt = arg;
+	struct bench_run *run = bt->run;
+
+	/* Start all together, or the first ones in run uncontended */
+	wait_for_completion(&run->start);
+
+	run->fn(bt->cpu, run->data);
+
+	if (atomic_dec_and_test(&run->pending))
+		complete(&run->done);
+	return 0;
+}
+
+/**
+ * bench_on_each_cpu - run a benchmark on all online cpus at once
+ * @name: name of the threads, followed by "/<cpu>"
+ * @fn: the benchmark, called with the cpu it runs on and @data
+ * @data: passed to @fn
+ * @ran: the cpus @fn ran on are set in it
+ *
+ * Creates a thread bound to each online cpu, lets them all call @fn at
+ * the same time and waits for every one of them to return.  A cpu whose
+ * thread could not be created is left out.  Call with get_online_cpus()
+ * held.
+ *
+ * Returns the number of cpus @fn ran on, or -ENOMEM.
+ */
+int bench_on_each_cpu(const char *name, void (*fn)(int cpu, void *data),
+		      void *data, struct cpumask *ran)
+{
+	struct bench_run run = {
+		.fn	= fn,
+		.data	= data,
+	};
+	struct bench_thread *threads;
+	int cpu, nr = 0;
+
+	threads = kcalloc(nr_cpu_ids, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	init_completion(&run.start);
+	init_completion(&run.done);
+	atomic_set(&run.pending, 1);
+	cpumask_clear(ran);
+
+	for_each_online_cpu(cpu) {
+		struct task_struct *task;
+
+		threads[cpu].run = &run;
+		threads[cpu].cpu = cpu;
+		task = kthread_create(bench_thread_fn, &threads[cpu],
+				      "%s/%d", name, cpu);
+		if (IS_ERR(task))
+			continue;
+		kthread_bind(task, cpu);
+		cpumask_set_cpu(cpu, ran);
+		atomic_inc(&run.pending);
+		nr++;
+		wake_up_process(task);
+	}
+
+	complete_all(&run.start);
+	if (!atomic_dec_and_test(&run.pending))
+		wait_for_completion(&run.done);
+
+	kfree(threads);
+	return nr;
+}
+EXPORT_SYMBOL_GPL(bench_on_each_cpu);
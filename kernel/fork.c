@@ -256,6 +256,8 @@ static struct task_struct *dup_task_struct(struct task_struct *orig)
 	err = prop_local_init_single(&tsk->dirties);
 	if (err)
 		goto out;
+	tsk->nr_dirtied = 0;
+	tsk->nr_dirtied_pause = 128 >> (PAGE_SHIFT - 10);
 
 	setup_thread_stack(tsk, orig);
 	clear_user_return_notifier(tsk);
@@ -456,6 +458,13 @@ static void mm_init_aio(struct mm_struct *mm)
 #endif
 }
 
+static void mm_init_futex(struct mm_struct *mm)
+{
+#ifdef CONFIG_FUTEX
+	mm->futex_hash = NULL;
+#endif
+}
+
 static struct mm_struct * mm_init(struct mm_struct * mm, struct task_struct *p)
 {
 	atomic_set(&mm->mm_users, 1);
@@ -471,6 +480,7 @@ static struct mm_struct * mm_init(struct mm_struct * mm, struct task_struct *p)
 	mm->free_area_cache = TASK_UNMAPPED_BASE;
 	mm->cached_hole_size = ~0UL;
 	mm_init_aio(mm);
+	mm_init_futex(mm);
 	mm_init_owner(mm, p);
 
 	if (likely(!mm_alloc_pgd(mm))) {
@@ -524,6 +534,7 @@ void mmput(struct mm_struct *mm)
 		exit_aio(mm);
 		ksm_exit(mm);
 		exit_mmap(mm);
+		exit_futex_mm(mm);
 		set_mm_exe_file(mm, NULL);
 		if (!list_empty(&mm->mmlist)) {
 			spin_lock(&mmlist_lock);
@@ -886,11 +897,14 @@ static int copy_signal(unsigned long clone_flags, struct task_struct *tsk)
 
 	sig->oom_adj = current->signal->oom_adj;
 
+	sched_autogroup_fork(sig);
+
 	return 0;
 }
 
 void __cleanup_signal(struct signal_struct *sig)
 {
+	sched_autogroup_exit(sig);
 	thread_group_cputime_free(sig);
 	tty_kref_put(sig->tty);
 	kmem_cache_free(signal_cachep, sig);
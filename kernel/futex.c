@@ -59,6 +59,8 @@
 #include <linux/magic.h>
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
+#include <linux/bootmem.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -66,7 +68,12 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
+/*
+ * Private futexes hash into a table of their mm, sized from the number of
+ * its users (threads) when the first private futex operation is made.
+ */
+#define FUTEX_PRIVATE_HASHBITS_MIN	4
+#define FUTEX_PRIVATE_HASHBITS_MAX	(CONFIG_BASE_SMALL ? 4 : 10)
 
 /*
  * Priority Inheritance state:
@@ -132,17 +139,98 @@ struct futex_hash_bucket {
 	struct plist_head chain;
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/*
+ * A table of hash buckets: the global one, for the shared futexes, is
+ * sized at boot from the number of possible cpus; each mm gets its own
+ * for the private futexes of its threads, so that they no longer collide
+ * with the futexes of unrelated processes.
+ */
+struct futex_hash {
+	unsigned long mask;
+	struct futex_hash_bucket *queues;
+};
+
+static struct futex_hash futex_global_hash __read_mostly;
+
+static inline int futex_key_is_private(union futex_key *key)
+{
+	return !(key->both.offset & (FUT_OFF_INODE|FUT_OFF_MMSHARED));
+}
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
+	struct futex_hash *fh = &futex_global_hash;
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+
+	if (futex_key_is_private(key)) {
+		/* Installed by get_futex_key() before the key was used */
+		fh = ACCESS_ONCE(key->private.mm->futex_hash);
+		smp_read_barrier_depends();
+	}
+	return &fh->queues[hash & fh->mask];
+}
+
+static void futex_hash_init(struct futex_hash *fh, unsigned long size)
+{
+	unsigned long i;
+
+	fh->mask = size - 1;
+	for (i = 0; i < size; i++) {
+		plist_head_init(&fh->queues[i].chain, &fh->queues[i].lock);
+		spin_lock_init(&fh->queues[i].lock);
+	}
+}
+
+/*
+ * Install the private hash table of @mm.  Concurrent first users race to
+ * install theirs, the loser frees its copy.  If no table can be had, the
+ * mm uses the global one for good: a futex must always hash to the same
+ * bucket for as long as it has waiters.
+ */
+static void futex_private_hash_alloc(struct mm_struct *mm)
+{
+	struct futex_hash *fh;
+	unsigned int bits;
+
+	bits = ilog2(roundup_pow_of_two(4 * max_t(unsigned int,
+			atomic_read(&mm->mm_users), num_online_cpus())));
+	bits = clamp_t(unsigned int, bits, FUTEX_PRIVATE_HASHBITS_MIN,
+		       FUTEX_PRIVATE_HASHBITS_MAX);
+
+	for (; bits >= FUTEX_PRIVATE_HASHBITS_MIN; bits--) {
+		fh = kmalloc(sizeof(*fh) +
+			     (sizeof(struct futex_hash_bucket) << bits),
+			     GFP_KERNEL | __GFP_NOWARN);
+		if (fh)
+			break;
+	}
+	if (fh) {
+		fh->queues = (struct futex_hash_bucket *)(fh + 1);
+		futex_hash_init(fh, 1UL << bits);
+	} else
+		fh = &futex_global_hash;
+
+	if (cmpxchg(&mm->futex_hash, NULL, fh) && fh != &futex_global_hash)
+		kfree(fh);
+}
+
+/**
+ * exit_futex_mm() - free the private futex hash table of an mm
+ * @mm:		the mm, which has no users left
+ *
+ * Private futexes are only waited on by the threads of their mm, so no
+ * futex_q can be left on the table once the last of them has gone.
+ */
+void exit_futex_mm(struct mm_struct *mm)
+{
+	if (mm->futex_hash != &futex_global_hash)
+		kfree(mm->futex_hash);
+	mm->futex_hash = NULL;
 }
 
 /*
@@ -242,6 +330,8 @@ get_futex_key(u32 __user *uaddr, int fshared, union futex_key *key)
 			return -EFAULT;
 		key->private.mm = mm;
 		key->private.address = address;
+		if (unlikely(!mm->futex_hash))
+			futex_private_hash_alloc(mm);
 		get_futex_key_refs(key);
 		return 0;
 	}
@@ -599,6 +689,15 @@ lookup_pi_state(u32 uval, struct futex_hash_bucket *hb,
 	if (IS_ERR(p))
 		return PTR_ERR(p);
 
+	/*
+	 * A private futex can only be owned by a thread of its mm: the
+	 * pi_state is hashed through that mm when its owner exits.
+	 */
+	if (futex_key_is_private(key) && p->mm != key->private.mm) {
+		put_task_struct(p);
+		return -ESRCH;
+	}
+
 	/*
 	 * We need to look at the task state flags to figure out,
 	 * whether the task is exiting. To protect against the do_exit
@@ -2678,8 +2777,9 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 static int __init futex_init(void)
 {
+	unsigned long size;
+	unsigned int shift;
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2695,10 +2795,15 @@ static int __init futex_init(void)
 	if (curval == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
-		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+#if CONFIG_BASE_SMALL
+	size = 16;
+#else
+	size = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+	futex_global_hash.queues = alloc_large_system_hash("futex",
+				sizeof(struct futex_hash_bucket), size, 0,
+				0, &shift, NULL, size);
+	futex_hash_init(&futex_global_hash, 1UL << shift);
 
 	return 0;
 }
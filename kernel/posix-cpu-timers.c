@@ -8,6 +8,7 @@
 #include <linux/math64.h>
 #include <asm/uaccess.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 #include <trace/events/timer.h>
 
 /*
@@ -650,6 +651,9 @@ static void arm_timer(struct k_itimer *timer, union cpu_time_count now)
 				break;
 			}
 		}
+
+		/* The tickless cpus have to start checking it */
+		tick_nohz_full_kick_all();
 	}
 
 	spin_unlock(&p->sighand->siglock);
@@ -1393,6 +1397,27 @@ static inline int fastpath_timer_check(struct task_struct *tsk)
 	return sig->rlim[RLIMIT_CPU].rlim_cur != RLIM_INFINITY;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Without a cpu timer or cpu time limit armed for @tsk or its thread
+ * group, run_posix_cpu_timers() has nothing to do and the tick can be
+ * stopped.
+ */
+bool posix_cpu_timers_can_stop_tick(struct task_struct *tsk)
+{
+	struct signal_struct *sig = tsk->signal;
+
+	if (unlikely(tsk->exit_state))
+		return false;
+
+	if (!task_cputime_zero(&tsk->cputime_expires) ||
+	    !task_cputime_zero(&sig->cputime_expires))
+		return false;
+
+	return sig->rlim[RLIMIT_CPU].rlim_cur == RLIM_INFINITY;
+}
+#endif
+
 /*
  * This is called from the timer interrupt handler.  The irq handler has
  * already updated our counts.  We need to check if any timers fire now.
@@ -1510,6 +1535,8 @@ void set_process_cpu_timer(struct task_struct *tsk, unsigned int clock_idx,
 			tsk->signal->cputime_expires.virt_exp = *newval;
 			break;
 		}
+
+		tick_nohz_full_kick_all();
 	}
 }
 
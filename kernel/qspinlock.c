@@ -0,0 +1,191 @@
+/*
+ * Queued spinlock
+ *
+ * The slow path of the queued spinlocks (see asm-generic/qspinlock.h and
+ * asm-generic/qspinlock_types.h for the lock word).
+ *
+ * A ticket lock has all its waiters spin on the lock word, so that every
+ * release and every new waiter bounces its cacheline between all of them.
+ * Here waiters queue up MCS style instead: each one spins on a node of its
+ * own cpu, until the waiter ahead of it hands it the head of the queue,
+ * and only the head of the queue spins on the lock word itself.  The tail
+ * of the queue is kept in the lock word, encoded as a cpu number and the
+ * index of the node on that cpu, so that the lock stays 32 bits wide.
+ *
+ * A cpu can be queued on several locks at a time, from different contexts
+ * (task, softirq, hardirq and nmi), one node for each of them.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/smp.h>
+#include <linux/bug.h>
+#include <linux/percpu.h>
+#include <linux/module.h>
+#include <linux/spinlock.h>
+#include <asm/byteorder.h>
+
+struct mcs_spinlock {
+	struct mcs_spinlock *next;
+	int locked;		/* 1 if at the head of the queue */
+	int count;		/* nesting count, in the first node only */
+};
+
+#define MAX_NODES	4
+
+/*
+ * All the nodes of a cpu fit in a single cacheline, which the other cpus
+ * only touch to link behind a node or to hand over the queue head.
+ */
+static DEFINE_PER_CPU_ALIGNED(struct mcs_spinlock, mcs_nodes[MAX_NODES]);
+
+/*
+ * The locked byte of the lock word, set without touching the tail.
+ */
+struct __qspinlock {
+	union {
+		atomic_t val;
+#ifdef __LITTLE_ENDIAN
+		u8 locked;
+#else
+		struct {
+			u8 __unused[3];
+			u8 locked;
+		};
+#endif
+	};
+};
+
+static inline u32 encode_tail(int cpu, int idx)
+{
+	return ((cpu + 1) << _Q_TAIL_CPU_OFFSET) |
+		(idx << _Q_TAIL_IDX_OFFSET);
+}
+
+static inline struct mcs_spinlock *decode_tail(u32 tail)
+{
+	int cpu = (tail >> _Q_TAIL_CPU_OFFSET) - 1;
+	int idx = (tail & _Q_TAIL_IDX_MASK) >> _Q_TAIL_IDX_OFFSET;
+
+	return &per_cpu(mcs_nodes, cpu)[idx];
+}
+
+/*
+ * Put @tail in the lock word, leaving the locked byte alone, and return
+ * the previous value of the lock word.
+ */
+static inline u32 xchg_tail(struct qspinlock *lock, u32 tail)
+{
+	u32 old, new, val = atomic_read(&lock->val);
+
+	for (;;) {
+		new = (val & _Q_LOCKED_MASK) | tail;
+		old = atomic_cmpxchg(&lock->val, val, new);
+		if (old == val)
+			break;
+		val = old;
+	}
+	return old;
+}
+
+static inline void set_locked(struct qspinlock *lock)
+{
+	struct __qspinlock *l = (void *)lock;
+
+	ACCESS_ONCE(l->locked) = _Q_LOCKED_VAL;
+}
+
+/**
+ * queued_spin_lock_slowpath - acquire a contended queued spinlock
+ * @lock: Pointer to queued spinlock structure
+ * @val: Current value of the lock word
+ *
+ * Called with preemption disabled, like arch_spin_lock().
+ */
+void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
+{
+	struct mcs_spinlock *node, *prev, *next;
+	u32 old, tail;
+	int idx;
+
+	BUILD_BUG_ON(CONFIG_NR_CPUS >= (1U << _Q_TAIL_CPU_BITS));
+	BUILD_BUG_ON(sizeof(struct qspinlock) != 4);
+
+	node = __raw_get_cpu_var(mcs_nodes);
+	idx = node->count++;
+	tail = encode_tail(raw_smp_processor_id(), idx);
+
+	/*
+	 * More nesting than task, softirq, hardirq and nmi should not
+	 * happen: don't queue, spin on the lock word as a last resort.
+	 */
+	if (unlikely(idx >= MAX_NODES)) {
+		while (!queued_spin_trylock(lock))
+			cpu_relax();
+		goto release;
+	}
+
+	node += idx;
+	node->locked = 0;
+	node->next = NULL;
+
+	/*
+	 * The lock may have been released while we set up our node:
+	 * try once more before queueing.
+	 */
+	if (queued_spin_trylock(lock))
+		goto release;
+
+	/*
+	 * Publish our node as the new tail.  If there was a tail before,
+	 * link behind it and wait until it hands us the queue head; our
+	 * node was initialized before the (fully ordered) cmpxchg.
+	 */
+	old = xchg_tail(lock, tail);
+	if (old & _Q_TAIL_MASK) {
+		prev = decode_tail(old);
+		ACCESS_ONCE(prev->next) = node;
+
+		while (!ACCESS_ONCE(node->locked))
+			cpu_relax();
+	}
+
+	/*
+	 * We are at the head of the queue: wait for the owner to go away.
+	 * The critical section must not be reordered before this point.
+	 */
+	while ((val = atomic_read(&lock->val)) & _Q_LOCKED_MASK)
+		cpu_relax();
+	smp_mb();
+
+	/*
+	 * Claim the lock.  While the tail is set, no one but the queue head
+	 * takes the lock, so the locked byte alone will do, unless we are
+	 * the last in the queue: then the tail must go away with the same
+	 * cmpxchg, or a new waiter could link behind a node we are about to
+	 * reuse.
+	 */
+	for (;;) {
+		if (val != tail) {
+			set_locked(lock);
+			break;
+		}
+		old = atomic_cmpxchg(&lock->val, val, _Q_LOCKED_VAL);
+		if (old == val)
+			goto release;	/* no one queued behind us */
+		val = old;
+	}
+
+	/*
+	 * Someone queued behind us: wait for it to link in, and hand it
+	 * the queue head.
+	 */
+	while (!(next = ACCESS_ONCE(node->next)))
+		cpu_relax();
+	smp_wmb();
+	ACCESS_ONCE(next->locked) = 1;
+
+release:
+	__raw_get_cpu_var(mcs_nodes)[0].count--;
+}
+EXPORT_SYMBOL(queued_spin_lock_slowpath);
@@ -46,6 +46,8 @@
 #include <linux/cpu.h>
 #include <linux/mutex.h>
 #include <linux/time.h>
+#include <linux/tick.h>
+#include <linux/kthread.h>
 
 #include "rcutree.h"
 
@@ -180,12 +182,14 @@ cpu_has_callbacks_ready_to_invoke(struct rcu_data *rdp)
 }
 
 /*
- * Does the current CPU require a yet-as-unscheduled grace period?
+ * Does the current CPU, or do the rcuo kthreads, require a
+ * yet-as-unscheduled grace period?
  */
 static int
 cpu_needs_another_gp(struct rcu_state *rsp, struct rcu_data *rdp)
 {
-	return *rdp->nxttail[RCU_DONE_TAIL] && !rcu_gp_in_progress(rsp);
+	return (*rdp->nxttail[RCU_DONE_TAIL] || rcu_nocb_needs_gp(rsp)) &&
+	       !rcu_gp_in_progress(rsp);
 }
 
 /*
@@ -220,6 +224,13 @@ static int rcu_implicit_offline_qs(struct rcu_data *rdp)
 		return 1;
 	}
 
+	/*
+	 * A cpu running tickless reports quiescent states from its tick,
+	 * have it take the tick back.
+	 */
+	if (tick_nohz_full_cpu(rdp->cpu))
+		tick_nohz_full_kick_cpu(rdp->cpu);
+
 	/* If preemptable RCU, no point in sending reschedule IPI. */
 	if (rdp->preemptable)
 		return 0;
@@ -776,6 +787,7 @@ static void rcu_report_qs_rsp(struct rcu_state *rsp, unsigned long flags)
 	rsp->completed = rsp->gpnum;
 	rsp->signaled = RCU_GP_IDLE;
 	rcu_start_gp(rsp, flags);  /* releases root node's rnp->lock. */
+	rcu_nocb_gp_cleanup(rsp);
 }
 
 /*
@@ -1366,6 +1378,13 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	 */
 	local_irq_save(flags);
 	rdp = rsp->rda[smp_processor_id()];
+
+	/* Offloaded CPUs leave the callback to their rcuo kthread. */
+	if (rcu_nocb_enqueue(rdp, head)) {
+		local_irq_restore(flags);
+		return;
+	}
+
 	rcu_process_gp_end(rsp, rdp);
 	check_for_new_grace_period(rsp, rdp);
 
@@ -1398,6 +1417,10 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 		rdp->qlen_last_fqs_check = rdp->qlen;
 	} else if (ULONG_CMP_LT(ACCESS_ONCE(rsp->jiffies_force_qs), jiffies))
 		force_quiescent_state(rsp, 1);
+
+	/* A tickless cpu would sit on the callback until its next irq */
+	if (tick_nohz_full_cpu(smp_processor_id()))
+		tick_nohz_full_kick_cpu(smp_processor_id());
 	local_irq_restore(flags);
 }
 
@@ -1564,6 +1587,19 @@ static int rcu_needs_cpu_quick_check(int cpu)
 	       rcu_preempt_needs_cpu(cpu);
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * A nohz_full cpu keeps its tick while it has callbacks, or while a
+ * grace period waits on it: both are dealt with from the tick.  The
+ * nohz_full cpus are offloaded with CONFIG_RCU_NOCB_CPU, so that only
+ * the grace periods remain.
+ */
+int rcu_nohz_full_needs_cpu(int cpu)
+{
+	return rcu_needs_cpu_quick_check(cpu) || rcu_pending(cpu);
+}
+#endif
+
 static DEFINE_PER_CPU(struct rcu_head, rcu_barrier_head) = {NULL};
 static atomic_t rcu_barrier_cpu_count;
 static DEFINE_MUTEX(rcu_barrier_mutex);
@@ -1615,6 +1651,7 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	preempt_disable(); /* stop CPU_DYING from filling orphan_cbs_list */
 	rcu_adopt_orphan_cbs(rsp);
 	on_each_cpu(rcu_barrier_func, (void *)call_rcu_func, 1);
+	rcu_nocb_barrier(rsp);
 	preempt_enable(); /* CPU_DYING can again fill orphan_cbs_list */
 	if (atomic_dec_and_test(&rcu_barrier_cpu_count))
 		complete(&rcu_barrier_completion);
@@ -1662,6 +1699,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->dynticks = &per_cpu(rcu_dynticks, cpu);
 #endif /* #ifdef CONFIG_NO_HZ */
 	rdp->cpu = cpu;
+	rcu_boot_init_nocb_percpu_data(rdp, rsp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
@@ -1888,6 +1926,7 @@ void __init rcu_init(void)
 	RCU_INIT_FLAVOR(&rcu_sched_state, rcu_sched_data);
 	RCU_INIT_FLAVOR(&rcu_bh_state, rcu_bh_data);
 	__rcu_init_preempt();
+	rcu_init_nocb();
 	open_softirq(RCU_SOFTIRQ, rcu_process_callbacks);
 
 	/*
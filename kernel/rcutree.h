@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -230,6 +231,38 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/*
+	 * 6) Callback offloading.  The callbacks of a CPU listed in
+	 * rcu_nocbs= are queued on ->nocb_head, without locks, and are
+	 * waited for and invoked by the rcuo kthread of the CPU's group,
+	 * which sleeps on the ->nocb_wq of the group's leader.
+	 */
+	struct rcu_head *nocb_head;	/* Callbacks not yet taken by */
+	struct rcu_head **nocb_tail;	/*  the rcuo kthread. */
+	atomic_long_t nocb_q_count;	/* # of callbacks not yet invoked. */
+	unsigned long nocb_queued_at;	/* When ->nocb_head was queued. */
+	struct rcu_head *nocb_gp_head;	/* Callbacks taken by the rcuo */
+	struct rcu_head **nocb_gp_tail;	/*  kthread, waiting for a GP. */
+	unsigned long nocb_gp_queued_at; /* When ->nocb_gp_head was queued. */
+	struct rcu_data *nocb_leader;	/* First rcu_data of the group, */
+					/*  NULL if not offloaded. */
+	struct rcu_data *nocb_next_follower;
+					/* Next rcu_data of the group. */
+	wait_queue_head_t nocb_wq;	/* Leader: rcuo kthread waits here. */
+	struct task_struct *nocb_kthread; /* Leader: the rcuo kthread. */
+	struct rcu_state *nocb_rsp;	/* Flavor the callbacks belong to. */
+
+	/* Offloaded callback statistics, times are in jiffies. */
+	unsigned long n_nocb_invoked;	/* Callbacks invoked. */
+	unsigned long n_nocb_batches;	/* Lists invoked. */
+	unsigned long nocb_cb_lat;	/* Sum and max over the lists of */
+	unsigned long nocb_cb_lat_max;	/*  their oldest callback's wait. */
+	unsigned long n_nocb_gps;	/* Leader: GPs waited for, */
+	unsigned long nocb_gp_wait;	/*  sum and max of the waits. */
+	unsigned long nocb_gp_wait_max;
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 };
 
@@ -320,6 +353,13 @@ struct rcu_state {
 						/*  due to lock unavailable. */
 	unsigned long n_force_qs_ngp;		/* Number of calls leaving */
 						/*  due to no GP active. */
+#ifdef CONFIG_RCU_NOCB_CPU
+	unsigned long nocb_gp_target;		/* GP the rcuo kthreads wait */
+						/*  for, guarded by root */
+						/*  rcu_node's lock. */
+	wait_queue_head_t nocb_gp_wq;		/* rcuo kthreads wait for GP */
+						/*  ends here. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 #ifdef CONFIG_RCU_CPU_STALL_DETECTOR
 	unsigned long gp_start;			/* Time at which GP started, */
 						/*  but in jiffies. */
@@ -383,5 +423,12 @@ static void __cpuinit rcu_preempt_init_percpu_data(int cpu);
 static void rcu_preempt_send_cbs_to_orphanage(void);
 static void __init __rcu_init_preempt(void);
 static void rcu_needs_cpu_flush(void);
+static int rcu_nocb_needs_gp(struct rcu_state *rsp);
+static void rcu_nocb_gp_cleanup(struct rcu_state *rsp);
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head);
+static void rcu_nocb_barrier(struct rcu_state *rsp);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp);
+static void __init rcu_init_nocb(void);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
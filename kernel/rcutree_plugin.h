@@ -1067,3 +1067,385 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Callback offloading.  The callbacks queued on the CPUs given with
+ * rcu_nocbs= are not invoked from RCU_SOFTIRQ on those CPUs but by rcuo
+ * kthreads, one per flavor for each group of rcu_nocb_group offloaded
+ * CPUs, which can be affined and niced like any other task.  call_rcu()
+ * queues the callback on a per-CPU list without taking any lock, and
+ * wakes up the group's kthread if the list was empty.  The kthread
+ * takes the lists of all the CPUs of its group at once, waits for a
+ * grace period to elapse for all of them, then invokes the callbacks.
+ */
+
+static cpumask_var_t rcu_nocb_mask;
+static bool have_rcu_nocb_mask;
+static int rcu_nocb_group;
+
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+static int __init rcu_nocb_group_setup(char *str)
+{
+	get_option(&str, &rcu_nocb_group);
+	return 1;
+}
+__setup("rcu_nocb_group=", rcu_nocb_group_setup);
+
+/*
+ * Is the grace period the rcuo kthreads wait for not yet started?  The
+ * caller must check that no grace period is in progress.
+ */
+static int rcu_nocb_needs_gp(struct rcu_state *rsp)
+{
+	return ULONG_CMP_LT(ACCESS_ONCE(rsp->completed),
+			    ACCESS_ONCE(rsp->nocb_gp_target));
+}
+
+/*
+ * Wake up the rcuo kthreads waiting for the end of a grace period.
+ */
+static void rcu_nocb_gp_cleanup(struct rcu_state *rsp)
+{
+	if (waitqueue_active(&rsp->nocb_gp_wq))
+		wake_up_all(&rsp->nocb_gp_wq);
+}
+
+/*
+ * Queue a callback on the list of an offloaded CPU, returning false if
+ * the CPU is not offloaded.  Callers on the CPU itself have irqs
+ * disabled, but the list may also be appended to from other CPUs, see
+ * rcu_nocb_barrier(): the tail is claimed with xchg(), then linked to.
+ */
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head)
+{
+	struct rcu_head **old_tail;
+
+	if (!rdp->nocb_leader)
+		return false;
+
+	atomic_long_inc(&rdp->nocb_q_count);
+	old_tail = xchg(&rdp->nocb_tail, &head->next);
+	ACCESS_ONCE(*old_tail) = head;
+
+	/* The kthread rechecks the list after queueing itself to sleep. */
+	if (old_tail == &rdp->nocb_head) {
+		rdp->nocb_queued_at = jiffies;
+		wake_up(&rdp->nocb_leader->nocb_wq);
+	}
+	return true;
+}
+
+/*
+ * The callbacks of the offline CPUs are still pending on their lists,
+ * and are not reached by the IPIs of _rcu_barrier(): queue the barrier
+ * callback behind them from here.  Preemption is disabled by the caller.
+ */
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+	struct rcu_data *rdp;
+	struct rcu_head *head;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rdp = rsp->rda[cpu];
+		if (cpu_online(cpu) || !rdp->nocb_leader ||
+		    !atomic_long_read(&rdp->nocb_q_count))
+			continue;
+		head = &per_cpu(rcu_barrier_head, cpu);
+		head->func = rcu_barrier_callback;
+		head->next = NULL;
+		atomic_inc(&rcu_barrier_cpu_count);
+		rcu_nocb_enqueue(rdp, head);
+	}
+}
+
+static bool rcu_nocb_group_pending(struct rcu_data *leader)
+{
+	struct rcu_data *rdp;
+
+	for (rdp = leader; rdp; rdp = rdp->nocb_next_follower)
+		if (ACCESS_ONCE(rdp->nocb_head))
+			return true;
+	return false;
+}
+
+/*
+ * Take all the callbacks queued so far on a CPU's list.  An enqueuer
+ * that claimed the tail before the xchg() here may not have linked its
+ * callback yet, rcu_nocb_invoke() waits for it.
+ */
+static bool rcu_nocb_take(struct rcu_data *rdp)
+{
+	struct rcu_head *list = ACCESS_ONCE(rdp->nocb_head);
+
+	if (!list)
+		return false;
+	ACCESS_ONCE(rdp->nocb_head) = NULL;
+	rdp->nocb_gp_tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+	rdp->nocb_gp_head = list;
+	rdp->nocb_gp_queued_at = rdp->nocb_queued_at;
+	return true;
+}
+
+/*
+ * Start the next grace period if RCU is idle and the rcuo kthreads still
+ * wait for one.  rcu_report_qs_rsp() starts the following ones until
+ * ->nocb_gp_target is reached, see cpu_needs_another_gp().
+ */
+static void rcu_nocb_start_gp(struct rcu_state *rsp)
+{
+	struct rcu_node *rnp = rcu_get_root(rsp);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&rnp->lock, flags);
+	rcu_start_gp(rsp, flags);  /* releases rnp->lock. */
+}
+
+static int rcu_nocb_gp_done(struct rcu_state *rsp, unsigned long target)
+{
+	return ULONG_CMP_GE(ACCESS_ONCE(rsp->completed), target);
+}
+
+/*
+ * Wait for a full grace period to elapse after the callbacks were taken:
+ * the one after the current grace period, if any, so that the readers
+ * that started before the current grace period reached this CPU are
+ * waited for too.  No CPU may be holding callbacks, hence keeping its
+ * tick to push the grace period along, so the kthread forces quiescent
+ * states itself while it waits.
+ */
+static void rcu_nocb_wait_gp(struct rcu_state *rsp)
+{
+	struct rcu_node *rnp = rcu_get_root(rsp);
+	unsigned long flags;
+	unsigned long target;
+
+	smp_mb(); /* Callbacks taken before the grace period is chosen. */
+	raw_spin_lock_irqsave(&rnp->lock, flags);
+	target = rsp->gpnum + 1;
+	if (ULONG_CMP_LT(rsp->nocb_gp_target, target))
+		rsp->nocb_gp_target = target;
+	rcu_start_gp(rsp, flags);  /* releases rnp->lock. */
+
+	while (!rcu_nocb_gp_done(rsp, target)) {
+		if (wait_event_interruptible_timeout(rsp->nocb_gp_wq,
+				rcu_nocb_gp_done(rsp, target),
+				RCU_JIFFIES_TILL_FORCE_QS))
+			continue;
+		rcu_nocb_start_gp(rsp);
+		force_quiescent_state(rsp, 1);
+	}
+	smp_mb(); /* Grace period ends before the callbacks are invoked. */
+}
+
+static void rcu_nocb_invoke(struct rcu_data *rdp)
+{
+	struct rcu_head *list = rdp->nocb_gp_head;
+	struct rcu_head **tail = rdp->nocb_gp_tail;
+	struct rcu_head *next;
+	unsigned long lat;
+	long count = 0;
+
+	if (!list)
+		return;
+	rdp->nocb_gp_head = NULL;
+
+	while (list) {
+		next = ACCESS_ONCE(list->next);
+		while (!next && &list->next != tail) {
+			schedule_timeout_interruptible(1);
+			next = ACCESS_ONCE(list->next);
+		}
+		local_bh_disable();
+		list->func(list);
+		local_bh_enable();
+		list = next;
+		count++;
+		cond_resched();
+	}
+	atomic_long_sub(count, &rdp->nocb_q_count);
+
+	lat = jiffies - rdp->nocb_gp_queued_at;
+	rdp->n_nocb_invoked += count;
+	rdp->n_nocb_batches++;
+	rdp->nocb_cb_lat += lat;
+	if (lat > rdp->nocb_cb_lat_max)
+		rdp->nocb_cb_lat_max = lat;
+}
+
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *leader = arg;
+	struct rcu_state *rsp = leader->nocb_rsp;
+	struct rcu_data *rdp;
+	unsigned long start, wait;
+	bool taken;
+
+	for (;;) {
+		wait_event_interruptible(leader->nocb_wq,
+					 rcu_nocb_group_pending(leader));
+		taken = false;
+		for (rdp = leader; rdp; rdp = rdp->nocb_next_follower)
+			taken |= rcu_nocb_take(rdp);
+		if (!taken)
+			continue;
+
+		start = jiffies;
+		rcu_nocb_wait_gp(rsp);
+		wait = jiffies - start;
+		leader->n_nocb_gps++;
+		leader->nocb_gp_wait += wait;
+		if (wait > leader->nocb_gp_wait_max)
+			leader->nocb_gp_wait_max = wait;
+
+		for (rdp = leader; rdp; rdp = rdp->nocb_next_follower)
+			rcu_nocb_invoke(rdp);
+	}
+	return 0;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp)
+{
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = &rdp->nocb_head;
+	atomic_long_set(&rdp->nocb_q_count, 0);
+	init_waitqueue_head(&rdp->nocb_wq);
+	rdp->nocb_rsp = rsp;
+}
+
+/*
+ * Split the offloaded CPUs of a flavor into groups of rcu_nocb_group,
+ * each handled by the kthread of its first CPU.
+ */
+static void __init rcu_organize_nocb(struct rcu_state *rsp)
+{
+	struct rcu_data *leader = NULL;
+	struct rcu_data *prev = NULL;
+	struct rcu_data *rdp;
+	int nr = 0;
+	int cpu;
+
+	rsp->nocb_gp_target = rsp->completed;
+	init_waitqueue_head(&rsp->nocb_gp_wq);
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = rsp->rda[cpu];
+		if (nr++ % rcu_nocb_group == 0)
+			leader = rdp;
+		else
+			prev->nocb_next_follower = rdp;
+		rdp->nocb_leader = leader;
+		prev = rdp;
+	}
+}
+
+static void __init rcu_init_nocb(void)
+{
+	int cpu = smp_processor_id();
+	char buf[128];
+
+#ifdef CONFIG_NO_HZ_FULL
+	/* The callbacks would otherwise keep the tick of nohz_full cpus. */
+	if (tick_nohz_full_running) {
+		if (!have_rcu_nocb_mask) {
+			if (!zalloc_cpumask_var(&rcu_nocb_mask, GFP_NOWAIT))
+				return;
+			have_rcu_nocb_mask = true;
+		}
+		cpumask_or(rcu_nocb_mask, rcu_nocb_mask, tick_nohz_full_mask);
+	}
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
+	if (!have_rcu_nocb_mask)
+		return;
+
+	cpumask_and(rcu_nocb_mask, rcu_nocb_mask, cpu_possible_mask);
+	/* Early boot callbacks can't wait for the kthreads. */
+	if (cpumask_test_cpu(cpu, rcu_nocb_mask)) {
+		printk(KERN_WARNING "RCU: Not offloading boot CPU %d.\n", cpu);
+		cpumask_clear_cpu(cpu, rcu_nocb_mask);
+	}
+	if (cpumask_empty(rcu_nocb_mask))
+		return;
+	if (rcu_nocb_group <= 0)
+		rcu_nocb_group = int_sqrt(nr_cpu_ids);
+
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "RCU: Offloading callbacks from CPUs %s, "
+	       "%d per rcuo kthread.\n", buf, rcu_nocb_group);
+	rcu_organize_nocb(&rcu_sched_state);
+	rcu_organize_nocb(&rcu_bh_state);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_organize_nocb(&rcu_preempt_state);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+}
+
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp, char abbr)
+{
+	struct task_struct *t;
+	struct rcu_data *rdp;
+	int cpu;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = rsp->rda[cpu];
+		if (rdp->nocb_leader != rdp)
+			continue;
+		t = kthread_run(rcu_nocb_kthread, rdp, "rcuo%c/%d", abbr, cpu);
+		BUG_ON(IS_ERR(t));
+		rdp->nocb_kthread = t;
+	}
+}
+
+static int __init rcu_spawn_nocb(void)
+{
+	if (!have_rcu_nocb_mask || cpumask_empty(rcu_nocb_mask))
+		return 0;
+	rcu_spawn_nocb_kthreads(&rcu_sched_state, 's');
+	rcu_spawn_nocb_kthreads(&rcu_bh_state, 'b');
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state, 'p');
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	return 0;
+}
+early_initcall(rcu_spawn_nocb);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static int rcu_nocb_needs_gp(struct rcu_state *rsp)
+{
+	return 0;
+}
+
+static void rcu_nocb_gp_cleanup(struct rcu_state *rsp)
+{
+}
+
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head)
+{
+	return false;
+}
+
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp)
+{
+}
+
+static void __init rcu_init_nocb(void)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -292,6 +292,64 @@ static const struct file_operations rcu_pending_fops = {
 	.release = single_release,
 };
 
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offloaded CPUs: callbacks waiting and invoked, the average and worst
+ * wait of the oldest callback of the lists invoked, and for the first
+ * CPU of each group, the average and worst grace-period wait of its
+ * rcuo kthread.  Times are in milliseconds.
+ */
+static void print_one_rcu_nocb(struct seq_file *m, struct rcu_data *rdp)
+{
+	unsigned long nb = rdp->n_nocb_batches;
+	unsigned long ngp = rdp->n_nocb_gps;
+
+	if (!rdp->nocb_leader)
+		return;
+	seq_printf(m, "%3d%cl=%d ql=%ld ni=%lu nb=%lu cbl=%u/%u",
+		   rdp->cpu,
+		   cpu_is_offline(rdp->cpu) ? '!' : ' ',
+		   rdp->nocb_leader->cpu,
+		   atomic_long_read(&rdp->nocb_q_count),
+		   rdp->n_nocb_invoked, nb,
+		   jiffies_to_msecs(nb ? rdp->nocb_cb_lat / nb : 0),
+		   jiffies_to_msecs(rdp->nocb_cb_lat_max));
+	if (rdp->nocb_leader == rdp)
+		seq_printf(m, " ngp=%lu gpw=%u/%u", ngp,
+			   jiffies_to_msecs(ngp ? rdp->nocb_gp_wait / ngp : 0),
+			   jiffies_to_msecs(rdp->nocb_gp_wait_max));
+	seq_puts(m, "\n");
+}
+
+static int show_rcu_nocb(struct seq_file *m, void *unused)
+{
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	seq_puts(m, "rcu_preempt:\n");
+	PRINT_RCU_DATA(rcu_preempt_data, print_one_rcu_nocb, m);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	seq_puts(m, "rcu_sched:\n");
+	PRINT_RCU_DATA(rcu_sched_data, print_one_rcu_nocb, m);
+	seq_puts(m, "rcu_bh:\n");
+	PRINT_RCU_DATA(rcu_bh_data, print_one_rcu_nocb, m);
+	return 0;
+}
+
+static int rcu_nocb_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_rcu_nocb, NULL);
+}
+
+static const struct file_operations rcu_nocb_fops = {
+	.owner = THIS_MODULE,
+	.open = rcu_nocb_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 static struct dentry *rcudir;
 
 static int __init rcuclassic_trace_init(void)
@@ -325,6 +383,13 @@ static int __init rcuclassic_trace_init(void)
 						NULL, &rcu_pending_fops);
 	if (!retval)
 		goto free_out;
+
+#ifdef CONFIG_RCU_NOCB_CPU
+	retval = debugfs_create_file("rcu_nocb", 0444, rcudir,
+						NULL, &rcu_nocb_fops);
+	if (!retval)
+		goto free_out;
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 	return 0;
 free_out:
 	debugfs_remove_recursive(rcudir);
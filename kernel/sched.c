@@ -77,6 +77,7 @@
 #include <asm/irq_regs.h>
 
 #include "sched_cpupri.h"
+#include "workqueue_sched.h"
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/sched.h>
@@ -267,10 +268,16 @@ struct task_group {
 	struct task_group *parent;
 	struct list_head siblings;
 	struct list_head children;
+
+#ifdef CONFIG_SCHED_AUTOGROUP
+	struct autogroup *autogroup;
+#endif
 };
 
 #define root_task_group init_task_group
 
+#include "sched_autogroup.h"
+
 /* task_group_lock serializes add/remove of task groups and also changes to
  * a task group's cpu shares.
  */
@@ -317,7 +324,7 @@ static inline struct task_group *task_group(struct task_struct *p)
 #else
 	tg = &init_task_group;
 #endif
-	return tg;
+	return autogroup_task_group(p, tg);
 }
 
 /* Change a task's cfs_rq and parent entity if it moves across CPUs/groups */
@@ -559,6 +566,11 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+#ifdef CONFIG_HAVE_SCHEDULER_IPI
+	/* tasks woken by other cpus, to be enqueued by this one: */
+	struct task_struct *wake_list;
+#endif
 #endif
 
 	/* calc_load related fields */
@@ -926,6 +938,41 @@ static inline int task_is_waking(struct task_struct *p)
 	return unlikely((p->state == TASK_WAKING) && !(p->flags & PF_STARTING));
 }
 
+#ifdef CONFIG_HAVE_SCHEDULER_IPI
+static void ttwu_drain(struct rq *rq);
+
+/*
+ * A remote wakeup leaves the task TASK_WAKING until the cpu it was
+ * queued on enqueues it.  Never wait for that cpu's IPI: it might be
+ * spinning with interrupts disabled itself, on a task queued to us.
+ * Enqueue whatever is queued to that cpu ourselves instead.
+ *
+ * So every __task_rq_lock()/task_rq_lock() caller may, from its spin
+ * loop and before it holds any rq->lock, take the rq->lock of another
+ * cpu and activate the tasks queued there, as that cpu's scheduler_ipi()
+ * would.  The locks callers may hold there (p->pi_lock, tasklist_lock,
+ * a siglock...) all nest outside rq->lock, as they do for callers of
+ * try_to_wake_up(); none of them holds another rq->lock.
+ */
+static inline void task_waking_relax(struct task_struct *p)
+{
+	struct rq *rq = cpu_rq(task_cpu(p));
+	unsigned long flags;
+
+	if (ACCESS_ONCE(rq->wake_list)) {
+		local_irq_save(flags);
+		ttwu_drain(rq);
+		local_irq_restore(flags);
+	}
+	cpu_relax();
+}
+#else
+static inline void task_waking_relax(struct task_struct *p)
+{
+	cpu_relax();
+}
+#endif
+
 /*
  * __task_rq_lock - lock the runqueue a given task resides on.
  * Must be called interrupts disabled.
@@ -937,7 +984,7 @@ static inline struct rq *__task_rq_lock(struct task_struct *p)
 
 	for (;;) {
 		while (task_is_waking(p))
-			cpu_relax();
+			task_waking_relax(p);
 		rq = task_rq(p);
 		raw_spin_lock(&rq->lock);
 		if (likely(rq == task_rq(p) && !task_is_waking(p)))
@@ -958,7 +1005,7 @@ static struct rq *task_rq_lock(struct task_struct *p, unsigned long *flags)
 
 	for (;;) {
 		while (task_is_waking(p))
-			cpu_relax();
+			task_waking_relax(p);
 		local_irq_save(*flags);
 		rq = task_rq(p);
 		raw_spin_lock(&rq->lock);
@@ -1200,6 +1247,33 @@ static void resched_cpu(int cpu)
 }
 
 #ifdef CONFIG_NO_HZ
+/*
+ * Pick the cpu a timer that isn't pinned should be queued on, from the
+ * current one: a cpu that is idle, or runs tickless with nohz_full=,
+ * would only have to wake up or restart its tick for it.  Take the
+ * nearest busy cpu that still has its tick instead, from the smallest
+ * sched domain up.  Stay put when there is none: the timer would be
+ * just as late on another idle cpu, whose timer wheel may also be
+ * behind jiffies.  Called with preemption disabled.
+ */
+int get_nohz_timer_target(void)
+{
+	int cpu = smp_processor_id();
+	struct sched_domain *sd;
+	int i;
+
+	if (!idle_cpu(cpu) && !tick_nohz_full_cpu(cpu))
+		return cpu;
+
+	for_each_domain(cpu, sd) {
+		for_each_cpu(i, sched_domain_span(sd)) {
+			if (!idle_cpu(i) && !tick_nohz_full_cpu(i))
+				return i;
+		}
+	}
+	return cpu;
+}
+
 /*
  * When add_timer_on() enqueues a timer into the timer wheel of an
  * idle CPU then this timer might expire before the next timer event
@@ -1842,6 +1916,10 @@ static const struct sched_class rt_sched_class;
 static void inc_nr_running(struct rq *rq)
 {
 	rq->nr_running++;
+
+	/* A second task: a tickless nohz_full cpu needs its tick back */
+	if (unlikely(rq->nr_running == 2 && tick_nohz_full_cpu(cpu_of(rq))))
+		tick_nohz_full_kick_cpu(cpu_of(rq));
 }
 
 static void dec_nr_running(struct rq *rq)
@@ -1932,6 +2010,7 @@ static void deactivate_task(struct rq *rq, struct task_struct *p, int sleep)
 #include "sched_idletask.c"
 #include "sched_fair.c"
 #include "sched_rt.c"
+#include "sched_autogroup.c"
 #ifdef CONFIG_SCHED_DEBUG
 # include "sched_debug.c"
 #endif
@@ -2351,6 +2430,170 @@ int select_task_rq(struct task_struct *p, int sd_flags, int wake_flags)
 }
 #endif
 
+static void
+ttwu_stat(struct task_struct *p, int cpu, int orig_cpu, int this_cpu,
+	  int wake_flags)
+{
+	schedstat_inc(p, se.nr_wakeups);
+	if (wake_flags & WF_SYNC)
+		schedstat_inc(p, se.nr_wakeups_sync);
+	if (orig_cpu != cpu)
+		schedstat_inc(p, se.nr_wakeups_migrate);
+	if (cpu == this_cpu)
+		schedstat_inc(p, se.nr_wakeups_local);
+	else
+		schedstat_inc(p, se.nr_wakeups_remote);
+
+	/*
+	 * Only attribute actual wakeups done by this task.
+	 */
+	if (!in_interrupt()) {
+		struct sched_entity *se = &current->se;
+		u64 sample = se->sum_exec_runtime;
+
+		if (se->last_wakeup)
+			sample -= se->last_wakeup;
+		else
+			sample -= se->start_runtime;
+		update_avg(&se->avg_wakeup, sample);
+
+		se->last_wakeup = se->sum_exec_runtime;
+	}
+}
+
+/*
+ * Mark the task runnable and see whether it should preempt the current
+ * one, with rq->lock held.
+ */
+static void
+ttwu_do_wakeup(struct rq *rq, struct task_struct *p, int wake_flags,
+	       int success)
+{
+	trace_sched_wakeup(rq, p, success);
+	check_preempt_curr(rq, p, wake_flags);
+
+	p->state = TASK_RUNNING;
+#ifdef CONFIG_SMP
+	if (p->sched_class->task_woken)
+		p->sched_class->task_woken(rq, p);
+
+	if (unlikely(rq->idle_stamp)) {
+		u64 delta = rq->clock - rq->idle_stamp;
+		u64 max = 2*sysctl_sched_migration_cost;
+
+		if (delta > max)
+			rq->avg_idle = max;
+		else
+			update_avg(&rq->avg_idle, delta);
+		rq->idle_stamp = 0;
+	}
+#endif
+}
+
+static void
+ttwu_do_activate(struct rq *rq, struct task_struct *p, int wake_flags)
+{
+	activate_task(rq, p, 1);
+
+	/* if a worker is waking up, notify workqueue */
+	if (p->flags & PF_WQ_WORKER)
+		wq_worker_waking_up(p, cpu_of(rq));
+
+	ttwu_do_wakeup(rq, p, wake_flags, 1);
+}
+
+#ifdef CONFIG_HAVE_SCHEDULER_IPI
+/*
+ * Enqueue the tasks queued on @rq's wake_list, with interrupts disabled.
+ * Usually done by the cpu of @rq, but also by any cpu that would
+ * otherwise have to wait for one of these tasks to leave TASK_WAKING.
+ */
+static void ttwu_drain(struct rq *rq)
+{
+	struct task_struct *list, *p;
+
+	list = xchg(&rq->wake_list, NULL);
+	if (!list)
+		return;
+
+	raw_spin_lock(&rq->lock);
+	update_rq_clock(rq);
+	while (list) {
+		p = list;
+		list = p->wake_entry;
+
+		WARN_ON(task_cpu(p) != cpu_of(rq));
+		WARN_ON(p->state != TASK_WAKING);
+
+		schedstat_inc(rq, ttwu_count);
+		ttwu_do_activate(rq, p, p->wake_flags);
+	}
+	raw_spin_unlock(&rq->lock);
+}
+
+/*
+ * Enqueue the tasks other cpus have queued on our wake_list.  Called from
+ * scheduler_ipi(), and from the places that have to make sure nothing is
+ * left behind.
+ */
+static void sched_ttwu_pending(void)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	ttwu_drain(this_rq());
+	local_irq_restore(flags);
+}
+
+/*
+ * Called by the architecture from the reschedule IPI, which is also what
+ * ttwu_queue_remote() sends.  The IPI itself already made us reschedule
+ * on the way out of the interrupt, should a woken task preempt.
+ */
+void scheduler_ipi(void)
+{
+	if (!ACCESS_ONCE(this_rq()->wake_list))
+		return;
+
+	irq_enter();
+	sched_ttwu_pending();
+	irq_exit();
+}
+
+/*
+ * Hand @p, in TASK_WAKING state and already moved to @cpu, over to that
+ * cpu for the enqueue: a lockless push onto its wake_list instead of a
+ * trip through its rq->lock.
+ *
+ * Only the wakeup that finds the list empty kicks the cpu: whoever empties
+ * the list, its cpu from scheduler_ipi() or another one from
+ * task_waking_relax(), takes all that was pushed onto it.  The kick is a
+ * plain reschedule IPI, no call_single_data, so there is nothing for the
+ * next wakeup to wait on while the target has interrupts disabled.
+ *
+ * Must be called with interrupts disabled.
+ */
+static void ttwu_queue_remote(struct task_struct *p, int cpu, int wake_flags)
+{
+	struct rq *rq = cpu_rq(cpu);
+	struct task_struct *next = rq->wake_list, *old;
+
+	p->wake_flags = wake_flags;
+	do {
+		old = next;
+		p->wake_entry = old;
+		next = cmpxchg(&rq->wake_list, old, p);
+	} while (next != old);
+
+	if (!old)
+		smp_send_reschedule(cpu);
+}
+#else
+static inline void sched_ttwu_pending(void)
+{
+}
+#endif /* CONFIG_HAVE_SCHEDULER_IPI */
+
 /***
  * try_to_wake_up - wake up a thread
  * @p: the to-be-woken-up thread
@@ -2363,6 +2606,9 @@ int select_task_rq(struct task_struct *p, int sd_flags, int wake_flags)
  * the simpler "current->state = TASK_RUNNING" to mark yourself
  * runnable without the overhead of this.
  *
+ * Wakeups of tasks that end up on another cpu are queued to that cpu,
+ * which does the enqueue itself, rather than taking its rq->lock here.
+ *
  * returns failure only if the task is already active.
  */
 static int try_to_wake_up(struct task_struct *p, unsigned int state,
@@ -2418,6 +2664,29 @@ static int try_to_wake_up(struct task_struct *p, unsigned int state,
 		set_task_cpu(p, cpu);
 	}
 
+#ifdef CONFIG_SCHEDSTATS
+	if (cpu != this_cpu) {
+		struct sched_domain *sd;
+		for_each_domain(this_cpu, sd) {
+			if (cpumask_test_cpu(cpu, sched_domain_span(sd))) {
+				schedstat_inc(sd, ttwu_wake_remote);
+				break;
+			}
+		}
+	}
+#endif /* CONFIG_SCHEDSTATS */
+
+#ifdef CONFIG_HAVE_SCHEDULER_IPI
+	if (sched_feat(TTWU_QUEUE) && cpu != this_cpu) {
+		ttwu_stat(p, cpu, orig_cpu, this_cpu, wake_flags);
+		ttwu_queue_remote(p, cpu, wake_flags);
+		local_irq_restore(flags);
+		put_cpu();
+
+		return 1;
+	}
+#endif
+
 	rq = cpu_rq(cpu);
 	raw_spin_lock(&rq->lock);
 	update_rq_clock(rq);
@@ -2431,76 +2700,67 @@ static int try_to_wake_up(struct task_struct *p, unsigned int state,
 	WARN_ON(task_cpu(p) != cpu);
 	WARN_ON(p->state != TASK_WAKING);
 
-#ifdef CONFIG_SCHEDSTATS
 	schedstat_inc(rq, ttwu_count);
 	if (cpu == this_cpu)
 		schedstat_inc(rq, ttwu_local);
-	else {
-		struct sched_domain *sd;
-		for_each_domain(this_cpu, sd) {
-			if (cpumask_test_cpu(cpu, sched_domain_span(sd))) {
-				schedstat_inc(sd, ttwu_wake_remote);
-				break;
-			}
-		}
-	}
-#endif /* CONFIG_SCHEDSTATS */
 
 out_activate:
 #endif /* CONFIG_SMP */
-	schedstat_inc(p, se.nr_wakeups);
-	if (wake_flags & WF_SYNC)
-		schedstat_inc(p, se.nr_wakeups_sync);
-	if (orig_cpu != cpu)
-		schedstat_inc(p, se.nr_wakeups_migrate);
-	if (cpu == this_cpu)
-		schedstat_inc(p, se.nr_wakeups_local);
-	else
-		schedstat_inc(p, se.nr_wakeups_remote);
-	activate_task(rq, p, 1);
+	ttwu_stat(p, cpu, orig_cpu, this_cpu, wake_flags);
+	ttwu_do_activate(rq, p, wake_flags);
 	success = 1;
+	goto out;
 
-	/*
-	 * Only attribute actual wakeups done by this task.
-	 */
-	if (!in_interrupt()) {
-		struct sched_entity *se = &current->se;
-		u64 sample = se->sum_exec_runtime;
+out_running:
+	ttwu_do_wakeup(rq, p, wake_flags, 0);
+out:
+	task_rq_unlock(rq, &flags);
+	put_cpu();
 
-		if (se->last_wakeup)
-			sample -= se->last_wakeup;
-		else
-			sample -= se->start_runtime;
-		update_avg(&se->avg_wakeup, sample);
+	return success;
+}
 
-		se->last_wakeup = se->sum_exec_runtime;
+/**
+ * try_to_wake_up_local - try to wake up a local task with rq lock held
+ * @p: the thread to be awakened
+ *
+ * Put @p on the run-queue if it's not already there.  The caller must
+ * ensure that this_rq() is locked, @p is bound to this_rq() and not
+ * the current task.  this_rq() stays locked over invocation.
+ */
+static void try_to_wake_up_local(struct task_struct *p)
+{
+	struct rq *rq = task_rq(p);
+	int success = 0;
+
+	BUG_ON(rq != this_rq());
+	BUG_ON(p == current);
+	lockdep_assert_held(&rq->lock);
+
+	if (!(p->state & TASK_NORMAL))
+		return;
+
+	if (!p->se.on_rq) {
+		if (likely(!task_running(rq, p))) {
+			schedstat_inc(rq, ttwu_count);
+			schedstat_inc(rq, ttwu_local);
+		}
+		if (task_contributes_to_load(p))
+			rq->nr_uninterruptible--;
+		activate_task(rq, p, 1);
+		if (p->flags & PF_WQ_WORKER)
+			wq_worker_waking_up(p, cpu_of(rq));
+		success = 1;
 	}
 
-out_running:
 	trace_sched_wakeup(rq, p, success);
-	check_preempt_curr(rq, p, wake_flags);
+	check_preempt_curr(rq, p, 0);
 
 	p->state = TASK_RUNNING;
 #ifdef CONFIG_SMP
 	if (p->sched_class->task_woken)
 		p->sched_class->task_woken(rq, p);
-
-	if (unlikely(rq->idle_stamp)) {
-		u64 delta = rq->clock - rq->idle_stamp;
-		u64 max = 2*sysctl_sched_migration_cost;
-
-		if (delta > max)
-			rq->avg_idle = max;
-		else
-			update_avg(&rq->avg_idle, delta);
-		rq->idle_stamp = 0;
-	}
 #endif
-out:
-	task_rq_unlock(rq, &flags);
-	put_cpu();
-
-	return success;
 }
 
 /**
@@ -3534,6 +3794,74 @@ void scheduler_tick(void)
 #endif
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * A nohz_full cpu can do without its tick as long as it runs a single
+ * task: there is nothing to preempt it for.
+ */
+bool sched_can_stop_tick(void)
+{
+	return this_rq()->nr_running <= 1;
+}
+
+static void sched_tick_remote(struct work_struct *work);
+static DECLARE_DELAYED_WORK(sched_tick_remote_work, sched_tick_remote);
+
+static void sched_tick_remote_queue(void)
+{
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		if (!tick_nohz_full_cpu(cpu))
+			break;
+	}
+	if (cpu >= nr_cpu_ids)
+		cpu = raw_smp_processor_id();
+
+	schedule_delayed_work_on(cpu, &sched_tick_remote_work, HZ);
+}
+
+/*
+ * The scheduler tick of the nohz_full cpus that have stopped theirs,
+ * done once a second from a housekeeping cpu: it keeps the runtime
+ * statistics of the task and the load of the cpu from going stale.
+ */
+static void sched_tick_remote(struct work_struct *work)
+{
+	struct task_struct *curr;
+	unsigned long flags;
+	struct rq *rq;
+	int cpu;
+
+	get_online_cpus();
+	for_each_cpu_and(cpu, tick_nohz_full_mask, cpu_online_mask) {
+		if (!tick_nohz_full_stopped(cpu))
+			continue;
+
+		rq = cpu_rq(cpu);
+		raw_spin_lock_irqsave(&rq->lock, flags);
+		curr = rq->curr;
+		if (curr != rq->idle) {
+			update_rq_clock(rq);
+			update_cpu_load(rq);
+			curr->sched_class->task_tick(rq, curr, 0);
+		}
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+	}
+	put_online_cpus();
+
+	sched_tick_remote_queue();
+}
+
+static int __init sched_tick_remote_init(void)
+{
+	if (tick_nohz_full_enabled())
+		sched_tick_remote_queue();
+	return 0;
+}
+late_initcall(sched_tick_remote_init);
+#endif /* CONFIG_NO_HZ_FULL */
+
 notrace unsigned long get_parent_ip(unsigned long addr)
 {
 	if (in_lock_functions(addr)) {
@@ -3723,10 +4051,24 @@ need_resched_nonpreemptible:
 	clear_tsk_need_resched(prev);
 
 	if (prev->state && !(preempt_count() & PREEMPT_ACTIVE)) {
-		if (unlikely(signal_pending_state(prev->state, prev)))
+		if (unlikely(signal_pending_state(prev->state, prev))) {
 			prev->state = TASK_RUNNING;
-		else
+		} else {
+			/*
+			 * If a worker is going to sleep, notify and
+			 * ask workqueue whether it wants to wake up a
+			 * task to maintain concurrency.  If so, wake
+			 * up the task.
+			 */
+			if (prev->flags & PF_WQ_WORKER) {
+				struct task_struct *to_wakeup;
+
+				to_wakeup = wq_worker_sleeping(prev, cpu);
+				if (to_wakeup)
+					try_to_wake_up_local(to_wakeup);
+			}
 			deactivate_task(rq, prev, 1);
+		}
 		switch_count = &prev->nvcsw;
 	}
 
@@ -3741,6 +4083,8 @@ need_resched_nonpreemptible:
 	if (likely(prev != next)) {
 		sched_info_switch(prev, next);
 		perf_event_task_sched_out(prev, next);
+		if (tick_nohz_full_cpu(cpu))
+			tick_nohz_full_kick_cpu(cpu);
 
 		rq->nr_switches++;
 		rq->curr = next;
@@ -3770,12 +4114,16 @@ need_resched_nonpreemptible:
 }
 EXPORT_SYMBOL(schedule);
 
-#ifdef CONFIG_MUTEX_SPIN_ON_OWNER
+#if defined(CONFIG_MUTEX_SPIN_ON_OWNER) || defined(CONFIG_RWSEM_SPIN_ON_OWNER)
 /*
  * Look out! "owner" is an entirely speculative pointer
  * access and not reliable.
+ *
+ * Spin as long as @owner is the owner recorded in @lock_owner and runs:
+ * returns 1 when the owner changed, 0 when it was not running.
  */
-int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner)
+static int spin_on_owner(struct thread_info **lock_owner,
+			 struct thread_info *owner)
 {
 	unsigned int cpu;
 	struct rq *rq;
@@ -3815,7 +4163,7 @@ int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner)
 		/*
 		 * Owner changed, break to re-assess state.
 		 */
-		if (lock->owner != owner)
+		if (*lock_owner != owner)
 			break;
 
 		/*
@@ -3831,6 +4179,29 @@ int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner)
 }
 #endif
 
+#ifdef CONFIG_MUTEX_SPIN_ON_OWNER
+int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner)
+{
+	return spin_on_owner(&lock->owner, owner);
+}
+#endif
+
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+int rwsem_spin_on_owner(struct rw_semaphore *sem, struct thread_info *owner)
+{
+	return spin_on_owner(&sem->owner, owner);
+}
+
+/*
+ * With NO_OWNER_SPIN, rwsem writers don't spin at all, not even while
+ * the owner is unknown.
+ */
+int rwsem_spin_enabled(void)
+{
+	return sched_feat(OWNER_SPIN);
+}
+#endif
+
 #ifdef CONFIG_PREEMPT
 /*
  * this is the entry point to schedule() from in-kernel preemption
@@ -5983,6 +6354,9 @@ migration_call(struct notifier_block *nfb, unsigned long action, void *hcpu)
 
 	case CPU_DYING:
 	case CPU_DYING_FROZEN:
+		/* Enqueue the wakeups still queued to us before going away */
+		sched_ttwu_pending();
+
 		/* Update our root-domain */
 		rq = cpu_rq(cpu);
 		raw_spin_lock_irqsave(&rq->lock, flags);
@@ -7735,6 +8109,7 @@ void __init sched_init(void)
 #ifdef CONFIG_CGROUP_SCHED
 	list_add(&init_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&init_task_group.children);
+	autogroup_init(&init_task);
 
 #endif /* CONFIG_CGROUP_SCHED */
 
@@ -7803,6 +8178,9 @@ void __init sched_init(void)
 		rq->avg_idle = 2*sysctl_sched_migration_cost;
 		INIT_LIST_HEAD(&rq->migration_queue);
 		rq_attach_root(rq, &def_root_domain);
+#ifdef CONFIG_HAVE_SCHEDULER_IPI
+		rq->wake_list = NULL;
+#endif
 #endif
 		init_rq_hrtick(rq);
 		atomic_set(&rq->nr_iowait, 0);
@@ -8184,6 +8562,7 @@ static void free_sched_group(struct task_group *tg)
 {
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
+	autogroup_free(tg);
 	kfree(tg);
 }
 
@@ -8806,12 +9185,31 @@ static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
 	return cgroup_add_files(cont, ss, cpu_files, ARRAY_SIZE(cpu_files));
 }
 
+static void
+cpu_cgroup_exit(struct cgroup_subsys *ss, struct task_struct *task)
+{
+	/*
+	 * cgroup_exit() is called in the copy_process() failure path.
+	 * Ignore this case since the task hasn't ran yet, this avoids
+	 * trying to poke a half freed task state from generic code.
+	 */
+	if (!(task->flags & PF_EXITING))
+		return;
+
+	/*
+	 * An exiting task no longer belongs to its autogroup, which can
+	 * go away with its signal_struct: move it to the root group.
+	 */
+	sched_move_task(task);
+}
+
 struct cgroup_subsys cpu_cgroup_subsys = {
 	.name		= "cpu",
 	.create		= cpu_cgroup_create,
 	.destroy	= cpu_cgroup_destroy,
 	.can_attach	= cpu_cgroup_can_attach,
 	.attach		= cpu_cgroup_attach,
+	.exit		= cpu_cgroup_exit,
 	.populate	= cpu_cgroup_populate,
 	.subsys_id	= cpu_cgroup_subsys_id,
 	.early_init	= 1,
@@ -111,8 +111,14 @@ SCHED_FEAT(LB_SHARES_UPDATE, 1)
 SCHED_FEAT(ASYM_EFF_LOAD, 1)
 
 /*
- * Spin-wait on mutex acquisition when the mutex owner is running on
- * another cpu -- assumes that when the owner is running, it will soon
- * release the lock. Decreases scheduling overhead.
+ * Spin-wait on mutex (and rwsem write) acquisition when the lock owner is
+ * running on another cpu -- assumes that when the owner is running, it
+ * will soon release the lock. Decreases scheduling overhead.
  */
 SCHED_FEAT(OWNER_SPIN, 1)
+
+/*
+ * Queue remote wakeups on the target cpu's wake_list and let it do the
+ * enqueue from an IPI, instead of taking its rq->lock from the waker.
+ */
+SCHED_FEAT(TTWU_QUEUE, 1)
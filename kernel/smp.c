@@ -41,6 +41,8 @@ struct call_single_queue {
 
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct call_single_queue, call_single_queue);
 
+static void flush_smp_call_function_queue(bool warn_cpu_offline);
+
 static int
 hotplug_cfd(struct notifier_block *nfb, unsigned long action, void *hcpu)
 {
@@ -63,6 +65,16 @@ hotplug_cfd(struct notifier_block *nfb, unsigned long action, void *hcpu)
 	case CPU_DEAD_FROZEN:
 		free_cpumask_var(cfd->cpumask);
 		break;
+
+	case CPU_DYING:
+	case CPU_DYING_FROZEN:
+		/*
+		 * Run what was queued to us before we went offline: nothing
+		 * else will, and a csd left locked would make the next user
+		 * of it spin forever.
+		 */
+		flush_smp_call_function_queue(false);
+		break;
 #endif
 	};
 
@@ -220,6 +232,15 @@ void generic_smp_call_function_interrupt(void)
  * called from the arch with interrupts disabled.
  */
 void generic_smp_call_function_single_interrupt(void)
+{
+	flush_smp_call_function_queue(true);
+}
+
+/*
+ * Run the functions queued to this cpu, with interrupts disabled.  Also
+ * called from CPU_DYING, when the cpu is already marked offline.
+ */
+static void flush_smp_call_function_queue(bool warn_cpu_offline)
 {
 	struct call_single_queue *q = &__get_cpu_var(call_single_queue);
 	unsigned int data_flags;
@@ -228,7 +249,7 @@ void generic_smp_call_function_single_interrupt(void)
 	/*
 	 * Shouldn't receive this interrupt on a cpu that is not yet online.
 	 */
-	WARN_ON_ONCE(!cpu_online(smp_processor_id()));
+	WARN_ON_ONCE(warn_cpu_offline && !cpu_online(smp_processor_id()));
 
 	raw_spin_lock(&q->lock);
 	list_replace_init(&q->list, &list);
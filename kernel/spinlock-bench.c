@@ -0,0 +1,146 @@
+/*
+ * kernel/spinlock-bench.c
+ *
+ * Contended spinlock microbenchmark.  On load, a thread is bound to every
+ * online cpu and all of them keep taking and releasing a shared spinlock
+ * for runtime seconds, updating a shared counter and spinning for a few
+ * iterations with the lock held, and then a few more with it released.
+ * The lock acquisitions per second are reported for all the cpus and for
+ * the slowest and the fastest one: with ticket locks, the throughput
+ * drops as cpus are added and every release has the lock cacheline
+ * bounce between all the waiters; queued spinlocks
+ * (CONFIG_QUEUED_SPINLOCKS) hand the lock over to a single waiter.
+ *
+ * nr_locks > 1 spreads the threads over several locks, for less
+ * contention on each; hold_loops and release_loops set the critical
+ * section and the time between two acquisitions.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/jiffies.h>
+#include <linux/cpu.h>
+#include <linux/bench.h>
+#include <linux/math64.h>
+
+static int runtime = 5;
+module_param(runtime, int, 0444);
+MODULE_PARM_DESC(runtime, "Seconds the lock is hammered for");
+
+static int nr_locks = 1;
+module_param(nr_locks, int, 0444);
+MODULE_PARM_DESC(nr_locks, "Shared locks, taken in turn by each thread");
+
+static int hold_loops = 10;
+module_param(hold_loops, int, 0444);
+MODULE_PARM_DESC(hold_loops, "Iterations spent with the lock held");
+
+static int release_loops = 10;
+module_param(release_loops, int, 0444);
+MODULE_PARM_DESC(release_loops, "Iterations spent with the lock released");
+
+struct bench_lock {
+	spinlock_t lock;
+	unsigned long counter;
+} ____cacheline_aligned_in_smp;
+
+#ifdef CONFIG_QUEUED_SPINLOCKS
+#define BENCH_LOCK_TYPE	"queued"
+#else
+#define BENCH_LOCK_TYPE	"ticket"
+#endif
+
+static struct bench_lock *bench_locks;
+
+static void spin_loops(int loops)
+{
+	while (loops-- > 0)
+		cpu_relax();
+}
+
+static void spinlock_bench_cpu(int cpu, void *data)
+{
+	unsigned long long *ops_out = (unsigned long long *)data + cpu;
+	unsigned long end = jiffies + runtime * HZ;
+	struct bench_lock *bl;
+	unsigned long long ops = 0;
+	int i = 0;
+
+	while (time_before(jiffies, end)) {
+		bl = &bench_locks[i];
+		if (++i == nr_locks)
+			i = 0;
+
+		spin_lock(&bl->lock);
+		bl->counter++;
+		spin_loops(hold_loops);
+		spin_unlock(&bl->lock);
+
+		spin_loops(release_loops);
+		ops++;
+		if (!(ops & 1023))
+			cond_resched();
+	}
+
+	*ops_out = ops;
+}
+
+static int __init spinlock_bench_init(void)
+{
+	unsigned long long *ops;
+	unsigned long long total = 0, slowest = ULLONG_MAX, fastest = 0;
+	cpumask_var_t ran;
+	int cpu, i, nr, ret = -ENOMEM;
+
+	if (runtime <= 0 || nr_locks <= 0 || hold_loops < 0 ||
+	    release_loops < 0)
+		return -EINVAL;
+
+	bench_locks = kcalloc(nr_locks, sizeof(*bench_locks), GFP_KERNEL);
+	ops = kcalloc(nr_cpu_ids, sizeof(*ops), GFP_KERNEL);
+	if (!bench_locks || !ops)
+		goto out;
+	if (!alloc_cpumask_var(&ran, GFP_KERNEL))
+		goto out;
+	for (i = 0; i < nr_locks; i++)
+		spin_lock_init(&bench_locks[i].lock);
+
+	get_online_cpus();
+	nr = bench_on_each_cpu("spinlock_bench", spinlock_bench_cpu, ops, ran);
+	put_online_cpus();
+
+	for_each_cpu(cpu, ran) {
+		total += ops[cpu];
+		slowest = min(slowest, ops[cpu]);
+		fastest = max(fastest, ops[cpu]);
+	}
+	free_cpumask_var(ran);
+
+	if (nr <= 0) {
+		ret = nr ? nr : -ENOMEM;
+		goto out;
+	}
+
+	printk(KERN_INFO "spinlock-bench: %d cpus on %d %s lock(s), %d/%d "
+	       "loops held/released: %llu acquisitions/sec, per cpu %llu "
+	       "slowest, %llu fastest\n", nr, nr_locks, BENCH_LOCK_TYPE,
+	       hold_loops, release_loops, div_u64(total, runtime),
+	       div_u64(slowest, runtime), div_u64(fastest, runtime));
+
+	/* Fails on purpose, so that the next insmod runs it again */
+	ret = -EAGAIN;
+out:
+	kfree(ops);
+	kfree(bench_locks);
+	return ret;
+}
+module_init(spinlock_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Contended spinlock throughput benchmark");
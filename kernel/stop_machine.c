@@ -9,6 +9,7 @@
 #include <linux/stop_machine.h>
 #include <linux/syscalls.h>
 #include <linux/interrupt.h>
+#include <linux/notifier.h>
 
 #include <asm/atomic.h>
 #include <asm/uaccess.h>
@@ -38,14 +39,25 @@ struct stop_machine_data {
 static unsigned int num_threads;
 static atomic_t thread_ack;
 static DEFINE_MUTEX(lock);
-/* setup_lock protects refcount, stop_machine_wq and stop_machine_work. */
+/* setup_lock protects refcount. */
 static DEFINE_MUTEX(setup_lock);
 /* Users of stop_machine. */
 static int refcount;
-static struct workqueue_struct *stop_machine_wq;
 static struct stop_machine_data active, idle;
 static const struct cpumask *active_cpus;
-static void __percpu *stop_machine_work;
+
+/*
+ * The per-cpu "kstop" threads.  They used to come from an rt workqueue,
+ * but workqueues no longer own their threads, so they are managed here
+ * with the same lifetime: they exist while refcount is elevated and
+ * follow cpu hotplug meanwhile.  threads_up and the per-cpu pointers
+ * are only changed under cpu_maps_update_begin().
+ */
+static DEFINE_PER_CPU(struct task_struct *, stop_machine_thread);
+static DEFINE_PER_CPU(int, stop_machine_queued);
+static int threads_up;
+static atomic_t threads_running;
+static DECLARE_COMPLETION(threads_done);
 
 static void set_state(enum stopmachine_state newstate)
 {
@@ -63,8 +75,8 @@ static void ack_state(void)
 }
 
 /* This is the actual function which stops the CPU. It runs
- * in the context of a dedicated stopmachine workqueue. */
-static void stop_cpu(struct work_struct *unused)
+ * in the context of the dedicated stopmachine thread of each cpu. */
+static void stop_cpu(void)
 {
 	enum stopmachine_state curstate = STOPMACHINE_NONE;
 	struct stop_machine_data *smdata = &idle;
@@ -112,38 +124,124 @@ static int chill(void *unused)
 	return 0;
 }
 
+static int stop_machine_cpu_thread(void *__cpu)
+{
+	int *queued = &per_cpu(stop_machine_queued, (long)__cpu);
+
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop())
+			break;
+		if (!*queued) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+		*queued = 0;
+		stop_cpu();
+		if (atomic_dec_and_test(&threads_running))
+			complete(&threads_done);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static int create_stop_machine_thread(int cpu)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+	struct task_struct *p;
+
+	p = kthread_create(stop_machine_cpu_thread, (void *)(long)cpu,
+			   "kstop/%d", cpu);
+	if (IS_ERR(p))
+		return PTR_ERR(p);
+	sched_setscheduler_nocheck(p, SCHED_FIFO, &param);
+	kthread_bind(p, cpu);
+	per_cpu(stop_machine_queued, cpu) = 0;
+	per_cpu(stop_machine_thread, cpu) = p;
+	return 0;
+}
+
+static void destroy_stop_machine_thread(int cpu)
+{
+	struct task_struct *p = per_cpu(stop_machine_thread, cpu);
+
+	if (p) {
+		kthread_stop(p);
+		per_cpu(stop_machine_thread, cpu) = NULL;
+	}
+}
+
+static int __cpuinit stop_machine_cpu_callback(struct notifier_block *nfb,
+					       unsigned long action,
+					       void *hcpu)
+{
+	int cpu = (long)hcpu;
+
+	/* cpu_add_remove_lock is held: threads_up can't change */
+	if (!threads_up)
+		return NOTIFY_OK;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_UP_PREPARE:
+		if (create_stop_machine_thread(cpu))
+			return notifier_from_errno(-ENOMEM);
+		break;
+	case CPU_ONLINE:
+		wake_up_process(per_cpu(stop_machine_thread, cpu));
+		break;
+	case CPU_UP_CANCELED:
+	case CPU_POST_DEAD:
+		destroy_stop_machine_thread(cpu);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
 int stop_machine_create(void)
 {
+	int cpu, err = 0;
+
 	mutex_lock(&setup_lock);
 	if (refcount)
 		goto done;
-	stop_machine_wq = create_rt_workqueue("kstop");
-	if (!stop_machine_wq)
-		goto err_out;
-	stop_machine_work = alloc_percpu(struct work_struct);
-	if (!stop_machine_work)
-		goto err_out;
+	cpu_maps_update_begin();
+	for_each_online_cpu(cpu) {
+		err = create_stop_machine_thread(cpu);
+		if (err)
+			break;
+		wake_up_process(per_cpu(stop_machine_thread, cpu));
+	}
+	if (err) {
+		for_each_online_cpu(cpu)
+			destroy_stop_machine_thread(cpu);
+	} else
+		threads_up = 1;
+	cpu_maps_update_done();
+	if (err) {
+		mutex_unlock(&setup_lock);
+		return err;
+	}
 done:
 	refcount++;
 	mutex_unlock(&setup_lock);
 	return 0;
-
-err_out:
-	if (stop_machine_wq)
-		destroy_workqueue(stop_machine_wq);
-	mutex_unlock(&setup_lock);
-	return -ENOMEM;
 }
 EXPORT_SYMBOL_GPL(stop_machine_create);
 
 void stop_machine_destroy(void)
 {
+	int cpu;
+
 	mutex_lock(&setup_lock);
 	refcount--;
 	if (refcount)
 		goto done;
-	destroy_workqueue(stop_machine_wq);
-	free_percpu(stop_machine_work);
+	cpu_maps_update_begin();
+	threads_up = 0;
+	for_each_possible_cpu(cpu)
+		destroy_stop_machine_thread(cpu);
+	cpu_maps_update_done();
 done:
 	mutex_unlock(&setup_lock);
 }
@@ -151,7 +249,6 @@ EXPORT_SYMBOL_GPL(stop_machine_destroy);
 
 int __stop_machine(int (*fn)(void *), void *data, const struct cpumask *cpus)
 {
-	struct work_struct *sm_work;
 	int i, ret;
 
 	/* Set up initial state. */
@@ -165,18 +262,19 @@ int __stop_machine(int (*fn)(void *), void *data, const struct cpumask *cpus)
 	idle.data = NULL;
 
 	set_state(STOPMACHINE_PREPARE);
+	atomic_set(&threads_running, num_threads);
+	INIT_COMPLETION(threads_done);
 
-	/* Schedule the stop_cpu work on all cpus: hold this CPU so one
+	/* Kick the stop_cpu thread on all cpus: hold this CPU so one
 	 * doesn't hit this CPU until we're ready. */
 	get_cpu();
 	for_each_online_cpu(i) {
-		sm_work = per_cpu_ptr(stop_machine_work, i);
-		INIT_WORK(sm_work, stop_cpu);
-		queue_work_on(i, stop_machine_wq, sm_work);
+		per_cpu(stop_machine_queued, i) = 1;
+		wake_up_process(per_cpu(stop_machine_thread, i));
 	}
 	/* This will release the thread on our CPU. */
 	put_cpu();
-	flush_workqueue(stop_machine_wq);
+	wait_for_completion(&threads_done);
 	ret = active.fnret;
 	mutex_unlock(&lock);
 	return ret;
@@ -197,3 +295,10 @@ int stop_machine(int (*fn)(void *), void *data, const struct cpumask *cpus)
 	return ret;
 }
 EXPORT_SYMBOL_GPL(stop_machine);
+
+static int __init stop_machine_init(void)
+{
+	hotcpu_notifier(stop_machine_cpu_callback, 0);
+	return 0;
+}
+early_initcall(stop_machine_init);
@@ -21,6 +21,9 @@
 #include <linux/sched.h>
 #include <linux/tick.h>
 #include <linux/module.h>
+#include <linux/posix-timers.h>
+#include <linux/rcupdate.h>
+#include <linux/smp.h>
 
 #include <asm/irq_regs.h>
 
@@ -124,6 +127,10 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_FULL
+static void tick_nohz_full_restart(struct tick_sched *ts);
+#endif
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -216,6 +223,12 @@ void tick_nohz_stop_sched_tick(int inidle)
 	cpu = smp_processor_id();
 	ts = &per_cpu(tick_cpu_sched, cpu);
 
+#ifdef CONFIG_NO_HZ_FULL
+	/* The tick was stopped for a busy cpu, idle has its own rules */
+	if (inidle && ts->full_stopped)
+		tick_nohz_full_restart(ts);
+#endif
+
 	/*
 	 * Call to tick_nohz_start_idle stops the last_update_time from being
 	 * updated. Thus, it must not be called in the event we are called from
@@ -251,6 +264,13 @@ void tick_nohz_stop_sched_tick(int inidle)
 	if (need_resched())
 		goto end;
 
+	/*
+	 * The nohz_full cpus never take the do_timer duty, so the cpu
+	 * which has it keeps it, and its tick.
+	 */
+	if (tick_nohz_full_enabled() && cpu == tick_do_timer_cpu)
+		goto end;
+
 	if (unlikely(local_softirq_pending() && cpu_online(cpu))) {
 		static int ratelimit;
 
@@ -506,6 +526,243 @@ void tick_nohz_restart_sched_tick(void)
 	local_irq_enable();
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Full dynticks: the cpus given with nohz_full= also stop their tick
+ * while they run a single task, until a second task, an armed posix cpu
+ * timer or RCU needs it back.  The do_timer duty stays with the other,
+ * housekeeping, cpus and so does the scheduler tick of the task, see
+ * sched_tick_remote().  The tick is stopped and restarted from irq_exit(),
+ * other cpus kick a tickless cpu there with an IPI.
+ */
+cpumask_var_t tick_nohz_full_mask;
+bool tick_nohz_full_running;
+
+static void tick_nohz_full_kick_func(void *info);
+
+static DEFINE_PER_CPU(atomic_t, tick_nohz_full_kick_pending);
+static DEFINE_PER_CPU(struct call_single_data, tick_nohz_full_kick_csd) = {
+	.func	= tick_nohz_full_kick_func,
+};
+
+static int __init tick_nohz_full_setup(char *str)
+{
+	int cpu = smp_processor_id();
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		printk(KERN_WARNING "NOHZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+
+	/* Someone has to do the timekeeping */
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		printk(KERN_WARNING "NOHZ: Clearing boot cpu %d from the "
+		       "nohz_full range for timekeeping\n", cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+
+	tick_nohz_full_running = !cpumask_empty(tick_nohz_full_mask);
+	return 1;
+}
+
+__setup("nohz_full=", tick_nohz_full_setup);
+
+bool tick_nohz_full_stopped(int cpu)
+{
+	return per_cpu(tick_cpu_sched, cpu).full_stopped;
+}
+
+/*
+ * Account the ticks missed while stopped to the task.  They go to user
+ * time: the tick only stays stopped across a syscall if it is short,
+ * a task left alone on a nohz_full cpu spends its time in user space.
+ */
+static void tick_nohz_full_account(struct tick_sched *ts)
+{
+#ifndef CONFIG_VIRT_CPU_ACCOUNTING
+	unsigned long ticks = jiffies - ts->full_jiffies;
+
+	/*
+	 * We might be one off. Do not randomly account a huge number of ticks!
+	 */
+	if (ticks && ticks < LONG_MAX) {
+		cputime_t cputime = jiffies_to_cputime(ticks);
+
+		account_user_time(current, cputime, cputime_to_scaled(cputime));
+	}
+#endif
+	ts->full_jiffies = jiffies;
+}
+
+static void tick_nohz_full_restart(struct tick_sched *ts)
+{
+	tick_nohz_full_account(ts);
+	ts->tick_stopped = 0;
+	ts->full_stopped = 0;
+	tick_nohz_restart(ts, ktime_get());
+}
+
+static bool tick_nohz_full_can_stop(int cpu, struct tick_sched *ts)
+{
+	if (ts->nohz_mode != NOHZ_MODE_HIGHRES)
+		return false;
+
+	if (cpu == tick_do_timer_cpu)
+		return false;
+
+	if (!sched_can_stop_tick())
+		return false;
+
+	if (!posix_cpu_timers_can_stop_tick(current))
+		return false;
+
+	if (rcu_nohz_full_needs_cpu(cpu) || printk_needs_cpu(cpu) ||
+	    arch_needs_cpu(cpu))
+		return false;
+
+	if (local_softirq_pending())
+		return false;
+
+	return true;
+}
+
+static void tick_nohz_full_stop_tick(struct tick_sched *ts)
+{
+	struct clock_event_device *dev = __get_cpu_var(tick_cpu_device).evtdev;
+	unsigned long seq, last_jiffies, delta_jiffies;
+	ktime_t last_update, expires;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		last_update = last_jiffies_update;
+		last_jiffies = jiffies;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	delta_jiffies = get_next_timer_interrupt(last_jiffies) - last_jiffies;
+
+	/* A timer is due within a tick: just keep ticking */
+	if ((long)delta_jiffies <= 1) {
+		if (ts->tick_stopped)
+			tick_nohz_full_restart(ts);
+		return;
+	}
+
+	if (likely(delta_jiffies < NEXT_TIMER_MAX_DELTA))
+		expires = ktime_add_ns(last_update,
+				       tick_period.tv64 * delta_jiffies);
+	else
+		expires.tv64 = KTIME_MAX;
+
+	/* Skip reprogram of event if its not changed */
+	if (ts->tick_stopped && ktime_equal(expires, dev->next_event))
+		return;
+
+	if (!ts->tick_stopped) {
+		ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
+		ts->tick_stopped = 1;
+		ts->full_stopped = 1;
+		ts->full_jiffies = last_jiffies;
+	}
+
+	if (unlikely(expires.tv64 == KTIME_MAX)) {
+		hrtimer_cancel(&ts->sched_timer);
+		return;
+	}
+
+	hrtimer_start(&ts->sched_timer, expires, HRTIMER_MODE_ABS_PINNED);
+	/* Check, if the timer was already in the past */
+	if (!hrtimer_active(&ts->sched_timer))
+		tick_nohz_full_restart(ts);
+}
+
+/**
+ * tick_nohz_full_check - stop or restart the tick of a busy nohz_full cpu
+ *
+ * Called from irq_exit() with interrupts disabled, when the cpu is not
+ * idle.
+ */
+void tick_nohz_full_check(void)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (!tick_nohz_full_cpu(cpu) || idle_cpu(cpu))
+		return;
+
+	if (tick_nohz_full_can_stop(cpu, ts)) {
+		if (ts->full_stopped)
+			tick_nohz_full_account(ts);
+		tick_nohz_full_stop_tick(ts);
+	} else if (ts->full_stopped) {
+		tick_nohz_full_restart(ts);
+	}
+}
+
+static void tick_nohz_full_kick_func(void *info)
+{
+	/* irq_exit() has a look at the tick */
+	atomic_set(&__get_cpu_var(tick_nohz_full_kick_pending), 0);
+}
+
+/**
+ * tick_nohz_full_kick_cpu - have a nohz_full cpu reconsider its tick
+ * @cpu: the cpu, which might have stopped its tick
+ *
+ * For another cpu, this is an IPI, the irq_exit() of which does the
+ * work.  For this cpu, outside of hardirq context, the tick is made to
+ * fire within a period instead, as we might be called with a runqueue
+ * lock held: rearming the tick timer without a softirq wakeup is safe
+ * there, restarting the tick is not.  Called with preemption disabled.
+ */
+void tick_nohz_full_kick_cpu(int cpu)
+{
+	struct tick_sched *ts;
+	unsigned long flags;
+
+	if (!tick_nohz_full_cpu(cpu))
+		return;
+
+	if (cpu != smp_processor_id()) {
+		if (atomic_xchg(&per_cpu(tick_nohz_full_kick_pending, cpu), 1))
+			return;
+		__smp_call_function_single(cpu,
+				&per_cpu(tick_nohz_full_kick_csd, cpu), 0);
+		return;
+	}
+
+	if (in_irq())
+		return;
+
+	local_irq_save(flags);
+	ts = &__get_cpu_var(tick_cpu_sched);
+	if (ts->full_stopped) {
+		tick_nohz_full_account(ts);
+		__hrtimer_start_range_ns(&ts->sched_timer,
+					 ktime_add(ktime_get(), tick_period), 0,
+					 HRTIMER_MODE_ABS_PINNED, 0);
+	}
+	local_irq_restore(flags);
+}
+
+/*
+ * Kick all the nohz_full cpus, for the rare events every one of them
+ * might have to look at, like a new posix cpu timer.
+ */
+void tick_nohz_full_kick_all(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_enabled())
+		return;
+
+	preempt_disable();
+	for_each_cpu_and(cpu, tick_nohz_full_mask, cpu_online_mask)
+		tick_nohz_full_kick_cpu(cpu);
+	preempt_enable();
+}
+#endif /* CONFIG_NO_HZ_FULL */
+
 static int tick_nohz_reprogram(struct tick_sched *ts, ktime_t now)
 {
 	hrtimer_forward(&ts->sched_timer, now, tick_period);
@@ -684,9 +941,10 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * concurrency: This happens only when the cpu in charge went
 	 * into a long sleep. If two cpus happen to assign themself to
 	 * this duty, then the jiffies update is still serialized by
-	 * xtime_lock.
+	 * xtime_lock. The nohz_full cpus leave it to the others.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -710,6 +968,9 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 		if (ts->tick_stopped) {
 			touch_softlockup_watchdog();
 			ts->idle_jiffies++;
+#ifdef CONFIG_NO_HZ_FULL
+			ts->full_jiffies++;
+#endif
 		}
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
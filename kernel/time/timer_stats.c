@@ -118,6 +118,23 @@ static struct entry entries[MAX_ENTRIES];
 
 static atomic_t overflow_count;
 
+/*
+ * Per-CPU timer wheel activity: timers moved between the wheel levels
+ * (cascaded), in total and when a new round of tv1 started, the most
+ * moved in a single tick and the time spent moving them, and the timers
+ * queued on another CPU than the one arming them (migrated).  Only
+ * updated by the CPU itself, with interrupts disabled:
+ */
+struct tstat_cpu {
+	unsigned long		cascaded;
+	unsigned long		cascaded_at_wrap;
+	unsigned long		cascade_max;
+	u64			cascade_ns;
+	unsigned long		migrated;
+};
+
+static DEFINE_PER_CPU(struct tstat_cpu, tstat_cpu);
+
 /*
  * The entries are in a hash-table, for fast lookup:
  */
@@ -137,6 +154,10 @@ static struct entry *tstat_hash_table[TSTAT_HASH_SIZE] __read_mostly;
 
 static void reset_entries(void)
 {
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(tstat_cpu, cpu), 0, sizeof(struct tstat_cpu));
 	nr_entries = 0;
 	memset(entries, 0, sizeof(entries));
 	memset(tstat_hash_table, 0, sizeof(tstat_hash_table));
@@ -267,6 +288,23 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	raw_spin_unlock_irqrestore(lock, flags);
 }
 
+void timer_stats_update_cascade(unsigned long nr, u64 ns, int at_wrap)
+{
+	struct tstat_cpu *tc = &__get_cpu_var(tstat_cpu);
+
+	tc->cascaded += nr;
+	if (at_wrap)
+		tc->cascaded_at_wrap += nr;
+	if (nr > tc->cascade_max)
+		tc->cascade_max = nr;
+	tc->cascade_ns += ns;
+}
+
+void timer_stats_update_migration(void)
+{
+	__get_cpu_var(tstat_cpu).migrated++;
+}
+
 static void print_name_offset(struct seq_file *m, unsigned long addr)
 {
 	char symname[KSYM_NAME_LEN];
@@ -333,6 +371,18 @@ static int tstats_show(struct seq_file *m, void *v)
 	else
 		seq_printf(m, "%ld total events\n", events);
 
+	seq_puts(m, "\nTimer wheel:\n"
+		 "  cpu  pending migrated cascaded  at wrap max/tick   cascade us\n");
+	for_each_online_cpu(i) {
+		struct tstat_cpu *tc = &per_cpu(tstat_cpu, i);
+
+		seq_printf(m, "%5d %8lu %8lu %8lu %8lu %8lu %12llu\n", i,
+			   timer_stats_pending_timers(i), tc->migrated,
+			   tc->cascaded, tc->cascaded_at_wrap, tc->cascade_max,
+			   (unsigned long long)div_u64(tc->cascade_ns,
+						       NSEC_PER_USEC));
+	}
+
 	mutex_unlock(&show_mutex);
 
 	return 0;
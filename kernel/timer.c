@@ -72,12 +72,25 @@ struct tvec_root {
 	struct list_head vec[TVR_SIZE];
 };
 
+/*
+ * tv1 holds the timers of the current round of TVR_SIZE jiffies, and
+ * tv1_next those of the next round: instead of cascading the whole tv2
+ * bucket of a round into tv1 when the round starts, a batch of it is
+ * moved into tv1_next on every jiffy of the previous round, and the two
+ * are swapped when the round starts.
+ */
 struct tvec_base {
 	spinlock_t lock;
 	struct timer_list *running_timer;
 	unsigned long timer_jiffies;
 	unsigned long next_timer;
-	struct tvec_root tv1;
+	unsigned long active_timers;
+	unsigned long cascade_batch;
+	unsigned long cascade_round;
+	unsigned long nr_cascaded;
+	struct tvec_root *tv1;
+	struct tvec_root *tv1_next;
+	struct tvec_root tv1_vecs[2];
 	struct tvec tv2;
 	struct tvec tv3;
 	struct tvec tv4;
@@ -332,11 +345,16 @@ static void internal_add_timer(struct tvec_base *base, struct timer_list *timer)
 {
 	unsigned long expires = timer->expires;
 	unsigned long idx = expires - base->timer_jiffies;
+	unsigned long round = (expires >> TVR_BITS) -
+			      (base->timer_jiffies >> TVR_BITS);
 	struct list_head *vec;
 
-	if (idx < TVR_SIZE) {
+	if (idx < TVR_SIZE && !round) {
+		int i = expires & TVR_MASK;
+		vec = base->tv1->vec + i;
+	} else if (idx < 2 * TVR_SIZE && round == 1) {
 		int i = expires & TVR_MASK;
-		vec = base->tv1.vec + i;
+		vec = base->tv1_next->vec + i;
 	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
 		int i = (expires >> TVR_BITS) & TVN_MASK;
 		vec = base->tv2.vec + i;
@@ -351,7 +369,7 @@ static void internal_add_timer(struct tvec_base *base, struct timer_list *timer)
 		 * Can happen if you add a timer with expires == jiffies,
 		 * or you set a timer to go off in the past
 		 */
-		vec = base->tv1.vec + (base->timer_jiffies & TVR_MASK);
+		vec = base->tv1->vec + (base->timer_jiffies & TVR_MASK);
 	} else {
 		int i;
 		/* If the timeout is larger than 0xffffffff on 64-bit
@@ -394,8 +412,38 @@ static void timer_stats_account_timer(struct timer_list *timer)
 				 timer->function, timer->start_comm, flag);
 }
 
+static inline void timer_stats_account_migration(void)
+{
+	if (unlikely(timer_stats_active))
+		timer_stats_update_migration();
+}
+
+static inline u64 timer_stats_cascade_start(void)
+{
+	return unlikely(timer_stats_active) ? sched_clock() : 0;
+}
+
+static void timer_stats_account_cascade(struct tvec_base *base, u64 start,
+					int at_wrap)
+{
+	if (likely(!start) || !base->nr_cascaded)
+		return;
+
+	timer_stats_update_cascade(base->nr_cascaded, sched_clock() - start,
+				   at_wrap);
+}
+
+unsigned long timer_stats_pending_timers(int cpu)
+{
+	return per_cpu(tvec_bases, cpu)->active_timers;
+}
+
 #else
 static void timer_stats_account_timer(struct timer_list *timer) {}
+static inline void timer_stats_account_migration(void) {}
+static inline u64 timer_stats_cascade_start(void) { return 0; }
+static inline void timer_stats_account_cascade(struct tvec_base *base,
+					       u64 start, int at_wrap) {}
 #endif
 
 #ifdef CONFIG_DEBUG_OBJECTS_TIMERS
@@ -646,6 +694,7 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 
 	if (timer_pending(timer)) {
 		detach_timer(timer, 0);
+		base->active_timers--;
 		if (timer->expires == base->next_timer &&
 		    !tbase_get_deferrable(timer->base))
 			base->next_timer = base->timer_jiffies;
@@ -660,11 +709,10 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	cpu = smp_processor_id();
 
 #if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
-	if (!pinned && get_sysctl_timer_migration() && idle_cpu(cpu)) {
-		int preferred_cpu = get_nohz_load_balancer();
-
-		if (preferred_cpu >= 0)
-			cpu = preferred_cpu;
+	if (!pinned && get_sysctl_timer_migration()) {
+		cpu = get_nohz_timer_target();
+		if (cpu != smp_processor_id())
+			timer_stats_account_migration();
 	}
 #endif
 	new_base = per_cpu(tvec_bases, cpu);
@@ -692,6 +740,7 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	    !tbase_get_deferrable(timer->base))
 		base->next_timer = timer->expires;
 	internal_add_timer(base, timer);
+	base->active_timers++;
 
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
@@ -813,6 +862,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	    !tbase_get_deferrable(timer->base))
 		base->next_timer = timer->expires;
 	internal_add_timer(base, timer);
+	base->active_timers++;
 	/*
 	 * Check whether the other CPU is idle and needs to be
 	 * triggered to reevaluate the timer wheel when nohz is
@@ -848,6 +898,7 @@ int del_timer(struct timer_list *timer)
 		base = lock_timer_base(timer, &flags);
 		if (timer_pending(timer)) {
 			detach_timer(timer, 1);
+			base->active_timers--;
 			if (timer->expires == base->next_timer &&
 			    !tbase_get_deferrable(timer->base))
 				base->next_timer = base->timer_jiffies;
@@ -885,6 +936,7 @@ int try_to_del_timer_sync(struct timer_list *timer)
 	ret = 0;
 	if (timer_pending(timer)) {
 		detach_timer(timer, 1);
+		base->active_timers--;
 		if (timer->expires == base->next_timer &&
 		    !tbase_get_deferrable(timer->base))
 			base->next_timer = base->timer_jiffies;
@@ -950,11 +1002,36 @@ static int cascade(struct tvec_base *base, struct tvec *tv, int index)
 	list_for_each_entry_safe(timer, tmp, &tv_list, entry) {
 		BUG_ON(tbase_get_base(timer->base) != base);
 		internal_add_timer(base, timer);
+		base->nr_cascaded++;
 	}
 
 	return index;
 }
 
+/*
+ * Cascade up to ->cascade_batch timers of the tv2 bucket of the next
+ * round into ->tv1_next.  The batch is sized from the timers the bucket
+ * of the previous round held, so that a bucket is normally emptied
+ * halfway through the round and the cascade at the start of the next
+ * one is left with the timers added to it since.
+ */
+static void cascade_next(struct tvec_base *base)
+{
+	int index = ((base->timer_jiffies >> TVR_BITS) + 1) & TVN_MASK;
+	struct list_head *head = base->tv2.vec + index;
+	unsigned long batch = base->cascade_batch;
+	struct timer_list *timer;
+
+	while (batch-- && !list_empty(head)) {
+		timer = list_first_entry(head, struct timer_list, entry);
+		BUG_ON(tbase_get_base(timer->base) != base);
+		list_del(&timer->entry);
+		internal_add_timer(base, timer);
+		base->nr_cascaded++;
+		base->cascade_round++;
+	}
+}
+
 #define INDEX(N) ((base->timer_jiffies >> (TVR_BITS + (N) * TVN_BITS)) & TVN_MASK)
 
 /**
@@ -962,7 +1039,8 @@ static int cascade(struct tvec_base *base, struct tvec *tv, int index)
  * @base: the timer vector to be processed.
  *
  * This function cascades all vectors and executes all expired timer
- * vectors.
+ * vectors.  Only the timers tv2 did not already hand over to ->tv1_next
+ * are left to cascade when a new round of tv1 starts.
  */
 static inline void __run_timers(struct tvec_base *base)
 {
@@ -973,17 +1051,32 @@ static inline void __run_timers(struct tvec_base *base)
 		struct list_head work_list;
 		struct list_head *head = &work_list;
 		int index = base->timer_jiffies & TVR_MASK;
+		u64 start = timer_stats_cascade_start();
 
 		/*
 		 * Cascade timers:
 		 */
-		if (!index &&
-			(!cascade(base, &base->tv2, INDEX(0))) &&
+		base->nr_cascaded = 0;
+		if (!index) {
+			int more = !cascade(base, &base->tv2, INDEX(0));
+
+			base->cascade_round += base->nr_cascaded;
+			if (more &&
 				(!cascade(base, &base->tv3, INDEX(1))) &&
 					!cascade(base, &base->tv4, INDEX(2)))
-			cascade(base, &base->tv5, INDEX(3));
+				cascade(base, &base->tv5, INDEX(3));
+
+			base->cascade_batch = max(DIV_ROUND_UP(base->cascade_round,
+							       TVR_SIZE / 2), 1UL);
+			base->cascade_round = 0;
+		}
+		cascade_next(base);
+		timer_stats_account_cascade(base, start, !index);
+
 		++base->timer_jiffies;
-		list_replace_init(base->tv1.vec + index, &work_list);
+		list_replace_init(base->tv1->vec + index, &work_list);
+		if (!(base->timer_jiffies & TVR_MASK))
+			swap(base->tv1, base->tv1_next);
 		while (!list_empty(head)) {
 			void (*fn)(unsigned long);
 			unsigned long data;
@@ -996,6 +1089,7 @@ static inline void __run_timers(struct tvec_base *base)
 
 			set_running_timer(base, timer);
 			detach_timer(timer, 1);
+			base->active_timers--;
 
 			spin_unlock_irq(&base->lock);
 			{
@@ -1061,7 +1155,7 @@ static unsigned long __next_timer_interrupt(struct tvec_base *base)
 	/* Look for timer events in tv1. */
 	index = slot = timer_jiffies & TVR_MASK;
 	do {
-		list_for_each_entry(nte, base->tv1.vec + slot, entry) {
+		list_for_each_entry(nte, base->tv1->vec + slot, entry) {
 			if (tbase_get_deferrable(nte->base))
 				continue;
 
@@ -1075,6 +1169,18 @@ static unsigned long __next_timer_interrupt(struct tvec_base *base)
 		slot = (slot + 1) & TVR_MASK;
 	} while (slot != index);
 
+	/* Then in the next round, already cascaded to tv1_next. */
+	for (slot = 0; slot < TVR_SIZE; slot++) {
+		list_for_each_entry(nte, base->tv1_next->vec + slot, entry) {
+			if (tbase_get_deferrable(nte->base))
+				continue;
+
+			found = 1;
+			expires = nte->expires;
+			goto cascade;
+		}
+	}
+
 cascade:
 	/* Calculate the next cascade event */
 	if (index)
@@ -1559,11 +1665,18 @@ static int __cpuinit init_timers_cpu(int cpu)
 		INIT_LIST_HEAD(base->tv3.vec + j);
 		INIT_LIST_HEAD(base->tv2.vec + j);
 	}
-	for (j = 0; j < TVR_SIZE; j++)
-		INIT_LIST_HEAD(base->tv1.vec + j);
+	for (j = 0; j < TVR_SIZE; j++) {
+		INIT_LIST_HEAD(base->tv1_vecs[0].vec + j);
+		INIT_LIST_HEAD(base->tv1_vecs[1].vec + j);
+	}
+	base->tv1 = &base->tv1_vecs[0];
+	base->tv1_next = &base->tv1_vecs[1];
 
 	base->timer_jiffies = jiffies;
 	base->next_timer = base->timer_jiffies;
+	base->active_timers = 0;
+	base->cascade_batch = 1;
+	base->cascade_round = 0;
 	return 0;
 }
 
@@ -1601,14 +1714,18 @@ static void __cpuinit migrate_timers(int cpu)
 
 	BUG_ON(old_base->running_timer);
 
-	for (i = 0; i < TVR_SIZE; i++)
-		migrate_timer_list(new_base, old_base->tv1.vec + i);
+	for (i = 0; i < TVR_SIZE; i++) {
+		migrate_timer_list(new_base, old_base->tv1->vec + i);
+		migrate_timer_list(new_base, old_base->tv1_next->vec + i);
+	}
 	for (i = 0; i < TVN_SIZE; i++) {
 		migrate_timer_list(new_base, old_base->tv2.vec + i);
 		migrate_timer_list(new_base, old_base->tv3.vec + i);
 		migrate_timer_list(new_base, old_base->tv4.vec + i);
 		migrate_timer_list(new_base, old_base->tv5.vec + i);
 	}
+	new_base->active_timers += old_base->active_timers;
+	old_base->active_timers = 0;
 
 	spin_unlock(&old_base->lock);
 	spin_unlock_irq(&new_base->lock);
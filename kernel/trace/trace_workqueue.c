@@ -7,65 +7,35 @@
 
 
 #include <trace/events/workqueue.h>
-#include <linux/list.h>
 #include <linux/percpu.h>
-#include <linux/slab.h>
-#include <linux/kref.h>
 #include "trace_stat.h"
 #include "trace.h"
 
 
-/* A cpu workqueue thread */
-struct cpu_workqueue_stats {
-	struct list_head            list;
-	struct kref                 kref;
-	int		            cpu;
-	pid_t			    pid;
-/* Can be inserted from interrupt or user context, need to be atomic */
-	atomic_t	            inserted;
 /*
- *  Don't need to be atomic, works are serialized in a single workqueue thread
- *  on a single CPU.
+ * The worker pool of a cpu.  Works are inserted from interrupt or user
+ * context and executed by any of the pool's workers, so everything is
+ * atomic.
  */
-	unsigned int		    executed;
-};
-
-/* List of workqueue threads on one cpu */
-struct workqueue_global_stats {
-	struct list_head	list;
-	spinlock_t		lock;
+struct cpu_workqueue_stats {
+	int			cpu;
+	atomic_t		inserted;
+	atomic_t		executed;
+	atomic_t		workers;
+	int			max_workers;
 };
 
 /* Don't need a global lock because allocated before the workqueues, and
  * never freed.
  */
-static DEFINE_PER_CPU(struct workqueue_global_stats, all_workqueue_stat);
+static DEFINE_PER_CPU(struct cpu_workqueue_stats, all_workqueue_stat);
 #define workqueue_cpu_stat(cpu) (&per_cpu(all_workqueue_stat, cpu))
 
-static void cpu_workqueue_stat_free(struct kref *kref)
-{
-	kfree(container_of(kref, struct cpu_workqueue_stats, kref));
-}
-
 /* Insertion of a work */
 static void
-probe_workqueue_insertion(struct task_struct *wq_thread,
-			  struct work_struct *work)
+probe_workqueue_insertion(unsigned int cpu, struct work_struct *work)
 {
-	int cpu = cpumask_first(&wq_thread->cpus_allowed);
-	struct cpu_workqueue_stats *node;
-	unsigned long flags;
-
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	list_for_each_entry(node, &workqueue_cpu_stat(cpu)->list, list) {
-		if (node->pid == wq_thread->pid) {
-			atomic_inc(&node->inserted);
-			goto found;
-		}
-	}
-	pr_debug("trace_workqueue: entry not found\n");
-found:
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
+	atomic_inc(&workqueue_cpu_stat(cpu)->inserted);
 }
 
 /* Execution of a work */
@@ -73,160 +43,56 @@ static void
 probe_workqueue_execution(struct task_struct *wq_thread,
 			  struct work_struct *work)
 {
-	int cpu = cpumask_first(&wq_thread->cpus_allowed);
-	struct cpu_workqueue_stats *node;
-	unsigned long flags;
-
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	list_for_each_entry(node, &workqueue_cpu_stat(cpu)->list, list) {
-		if (node->pid == wq_thread->pid) {
-			node->executed++;
-			goto found;
-		}
-	}
-	pr_debug("trace_workqueue: entry not found\n");
-found:
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
+	atomic_inc(&workqueue_cpu_stat(raw_smp_processor_id())->executed);
 }
 
-/* Creation of a cpu workqueue thread */
+/* Creation of a worker thread */
 static void probe_workqueue_creation(struct task_struct *wq_thread, int cpu)
 {
-	struct cpu_workqueue_stats *cws;
-	unsigned long flags;
-
-	WARN_ON(cpu < 0);
-
-	/* Workqueues are sometimes created in atomic context */
-	cws = kzalloc(sizeof(struct cpu_workqueue_stats), GFP_ATOMIC);
-	if (!cws) {
-		pr_warning("trace_workqueue: not enough memory\n");
-		return;
-	}
-	INIT_LIST_HEAD(&cws->list);
-	kref_init(&cws->kref);
-	cws->cpu = cpu;
-	cws->pid = wq_thread->pid;
+	struct cpu_workqueue_stats *cws = workqueue_cpu_stat(cpu);
+	int workers = atomic_inc_return(&cws->workers);
 
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	list_add_tail(&cws->list, &workqueue_cpu_stat(cpu)->list);
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
+	/* Workers are only created by the pool manager, one at a time */
+	if (workers > cws->max_workers)
+		cws->max_workers = workers;
 }
 
-/* Destruction of a cpu workqueue thread */
-static void probe_workqueue_destruction(struct task_struct *wq_thread)
+/* Destruction of a worker thread */
+static void probe_workqueue_destruction(struct task_struct *wq_thread, int cpu)
 {
-	/* Workqueue only execute on one cpu */
-	int cpu = cpumask_first(&wq_thread->cpus_allowed);
-	struct cpu_workqueue_stats *node, *next;
-	unsigned long flags;
-
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	list_for_each_entry_safe(node, next, &workqueue_cpu_stat(cpu)->list,
-							list) {
-		if (node->pid == wq_thread->pid) {
-			list_del(&node->list);
-			kref_put(&node->kref, cpu_workqueue_stat_free);
-			goto found;
-		}
-	}
-
-	pr_debug("trace_workqueue: don't find workqueue to destroy\n");
-found:
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
-
-}
-
-static struct cpu_workqueue_stats *workqueue_stat_start_cpu(int cpu)
-{
-	unsigned long flags;
-	struct cpu_workqueue_stats *ret = NULL;
-
-
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-
-	if (!list_empty(&workqueue_cpu_stat(cpu)->list)) {
-		ret = list_entry(workqueue_cpu_stat(cpu)->list.next,
-				 struct cpu_workqueue_stats, list);
-		kref_get(&ret->kref);
-	}
-
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
-
-	return ret;
+	atomic_dec(&workqueue_cpu_stat(cpu)->workers);
 }
 
 static void *workqueue_stat_start(struct tracer_stat *trace)
 {
-	int cpu;
-	void *ret = NULL;
+	int cpu = cpumask_first(cpu_possible_mask);
 
-	for_each_possible_cpu(cpu) {
-		ret = workqueue_stat_start_cpu(cpu);
-		if (ret)
-			return ret;
-	}
-	return NULL;
+	return cpu < nr_cpu_ids ? workqueue_cpu_stat(cpu) : NULL;
 }
 
 static void *workqueue_stat_next(void *prev, int idx)
 {
 	struct cpu_workqueue_stats *prev_cws = prev;
-	struct cpu_workqueue_stats *ret;
-	int cpu = prev_cws->cpu;
-	unsigned long flags;
-
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	if (list_is_last(&prev_cws->list, &workqueue_cpu_stat(cpu)->list)) {
-		spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
-		do {
-			cpu = cpumask_next(cpu, cpu_possible_mask);
-			if (cpu >= nr_cpu_ids)
-				return NULL;
-		} while (!(ret = workqueue_stat_start_cpu(cpu)));
-		return ret;
-	} else {
-		ret = list_entry(prev_cws->list.next,
-				 struct cpu_workqueue_stats, list);
-		kref_get(&ret->kref);
-	}
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
+	int cpu = cpumask_next(prev_cws->cpu, cpu_possible_mask);
 
-	return ret;
+	return cpu < nr_cpu_ids ? workqueue_cpu_stat(cpu) : NULL;
 }
 
 static int workqueue_stat_show(struct seq_file *s, void *p)
 {
 	struct cpu_workqueue_stats *cws = p;
-	struct pid *pid;
-	struct task_struct *tsk;
 
-	pid = find_get_pid(cws->pid);
-	if (pid) {
-		tsk = get_pid_task(pid, PIDTYPE_PID);
-		if (tsk) {
-			seq_printf(s, "%3d %6d     %6u       %s\n", cws->cpu,
-				   atomic_read(&cws->inserted), cws->executed,
-				   tsk->comm);
-			put_task_struct(tsk);
-		}
-		put_pid(pid);
-	}
+	seq_printf(s, "%3d %8d  %8d  %7d  %7d\n", cws->cpu,
+		   atomic_read(&cws->inserted), atomic_read(&cws->executed),
+		   atomic_read(&cws->workers), cws->max_workers);
 
 	return 0;
 }
 
-static void workqueue_stat_release(void *stat)
-{
-	struct cpu_workqueue_stats *node = stat;
-
-	kref_put(&node->kref, cpu_workqueue_stat_free);
-}
-
 static int workqueue_stat_headers(struct seq_file *s)
 {
-	seq_printf(s, "# CPU  INSERTED  EXECUTED   NAME\n");
-	seq_printf(s, "# |      |         |          |\n");
+	seq_printf(s, "# CPU  INSERTED  EXECUTED  WORKERS  MAX_WORKERS\n");
+	seq_printf(s, "# |      |         |         |        |\n");
 	return 0;
 }
 
@@ -235,7 +101,6 @@ struct tracer_stat workqueue_stats __read_mostly = {
 	.stat_start = workqueue_stat_start,
 	.stat_next = workqueue_stat_next,
 	.stat_show = workqueue_stat_show,
-	.stat_release = workqueue_stat_release,
 	.stat_headers = workqueue_stat_headers
 };
 
@@ -275,10 +140,8 @@ int __init trace_workqueue_early_init(void)
 	if (ret)
 		goto no_creation;
 
-	for_each_possible_cpu(cpu) {
-		spin_lock_init(&workqueue_cpu_stat(cpu)->lock);
-		INIT_LIST_HEAD(&workqueue_cpu_stat(cpu)->list);
-	}
+	for_each_possible_cpu(cpu)
+		workqueue_cpu_stat(cpu)->cpu = cpu;
 
 	return 0;
 
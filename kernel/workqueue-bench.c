@@ -0,0 +1,175 @@
+/*
+ * kernel/workqueue-bench.c
+ *
+ * Workqueue microbenchmark.  On load, nr_wqs workqueues are created with
+ * create_workqueue(), as the many drivers that each own one do, and the
+ * kernel threads and their stacks this costs are reported.  Then short
+ * works are queued to the system workqueue on every online cpu, behind
+ * works that block in msleep(), and the average and worst latency from
+ * queueing a short work to its execution is reported: with the shared
+ * worker pools, a blocked work no longer holds up the works queued
+ * behind it.
+ *
+ * Everything is torn down before the init function returns, with an
+ * error: the module never stays loaded, the numbers are in the log.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/delay.h>
+#include <linux/cpu.h>
+#include <linux/rcupdate.h>
+#include <linux/completion.h>
+#include <linux/timex.h>
+#include <linux/math64.h>
+#include <asm/atomic.h>
+
+static int nr_wqs = 16;
+module_param(nr_wqs, int, 0444);
+MODULE_PARM_DESC(nr_wqs, "Workqueues created by the benchmark");
+
+static int nr_works = 1000;
+module_param(nr_works, int, 0444);
+MODULE_PARM_DESC(nr_works, "Short works queued on each cpu");
+
+static int nr_blocking = 4;
+module_param(nr_blocking, int, 0444);
+MODULE_PARM_DESC(nr_blocking, "Blocking works queued on each cpu");
+
+static int block_ms = 10;
+module_param(block_ms, int, 0444);
+MODULE_PARM_DESC(block_ms, "How long each blocking work sleeps");
+
+struct bench_work {
+	struct work_struct work;
+	cycles_t queued, latency;
+};
+
+static atomic_t bench_pending;
+static DECLARE_COMPLETION(bench_done);
+
+static int count_kernel_threads(void)
+{
+	struct task_struct *g, *p;
+	int nr = 0;
+
+	rcu_read_lock();
+	do_each_thread(g, p) {
+		if (!p->mm)
+			nr++;
+	} while_each_thread(g, p);
+	rcu_read_unlock();
+	return nr;
+}
+
+static void bench_block_fn(struct work_struct *work)
+{
+	msleep(block_ms);
+	if (atomic_dec_and_test(&bench_pending))
+		complete(&bench_done);
+}
+
+static void bench_short_fn(struct work_struct *work)
+{
+	struct bench_work *bw = container_of(work, struct bench_work, work);
+
+	bw->latency = get_cycles() - bw->queued;
+	if (atomic_dec_and_test(&bench_pending))
+		complete(&bench_done);
+}
+
+static void wq_bench_latency(struct bench_work *bws, struct bench_work *blocks)
+{
+	unsigned long long total = 0, worst = 0;
+	int cpu, i = 0, b = 0, j, nr = 0;
+
+	atomic_set(&bench_pending, 1);
+	INIT_COMPLETION(bench_done);
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		for (j = 0; j < nr_blocking; j++, b++) {
+			INIT_WORK(&blocks[b].work, bench_block_fn);
+			atomic_inc(&bench_pending);
+			schedule_work_on(cpu, &blocks[b].work);
+		}
+		for (j = 0; j < nr_works; j++, i++) {
+			INIT_WORK(&bws[i].work, bench_short_fn);
+			atomic_inc(&bench_pending);
+			bws[i].queued = get_cycles();
+			schedule_work_on(cpu, &bws[i].work);
+		}
+	}
+	put_online_cpus();
+
+	if (!atomic_dec_and_test(&bench_pending))
+		wait_for_completion(&bench_done);
+
+	while (i--) {
+		total += bws[i].latency;
+		worst = max_t(unsigned long long, worst, bws[i].latency);
+		nr++;
+	}
+
+	printk(KERN_INFO "workqueue-bench: %d short works behind %d blocking "
+	       "%d ms ones per cpu: %llu cycles average latency, %llu worst\n",
+	       nr, nr_blocking, block_ms, div_u64(total, max(nr, 1)), worst);
+}
+
+static int __init wq_bench_init(void)
+{
+	struct workqueue_struct **wqs;
+	struct bench_work *bws = NULL, *blocks = NULL;
+	int i, nr_cpus, threads, created = 0, ret = -ENOMEM;
+
+	if (nr_wqs < 1 || nr_works <= 0 || nr_blocking < 0 || block_ms < 0)
+		return -EINVAL;
+
+	wqs = kcalloc(nr_wqs, sizeof(*wqs), GFP_KERNEL);
+	if (!wqs)
+		return -ENOMEM;
+
+	nr_cpus = num_online_cpus();
+
+	threads = count_kernel_threads();
+	for (; created < nr_wqs; created++) {
+		wqs[created] = create_workqueue("wq_bench");
+		if (!wqs[created])
+			goto out;
+	}
+	threads = count_kernel_threads() - threads;
+	printk(KERN_INFO "workqueue-bench: %d workqueues on %d cpus: "
+	       "%d new kernel threads, %lu KB of stacks\n", nr_wqs, nr_cpus,
+	       threads, (unsigned long)max(threads, 0) * THREAD_SIZE >> 10);
+
+	bws = kcalloc(nr_cpu_ids * nr_works, sizeof(*bws), GFP_KERNEL);
+	blocks = kcalloc(nr_cpu_ids * nr_blocking + 1, sizeof(*blocks),
+			 GFP_KERNEL);
+	if (!bws || !blocks)
+		goto out;
+
+	wq_bench_latency(bws, blocks);
+
+	printk(KERN_INFO "workqueue-bench: %d kernel threads after the run\n",
+	       count_kernel_threads());
+
+	/* The workqueues go away below, nothing is left to unload */
+	ret = -EAGAIN;
+out:
+	for (i = 0; i < created; i++)
+		destroy_workqueue(wqs[i]);
+	kfree(blocks);
+	kfree(bws);
+	kfree(wqs);
+	return ret;
+}
+module_init(wq_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Workqueue thread count and latency benchmark");
@@ -890,6 +890,56 @@ GENERATE_PERMUTATIONS_3_EVENTS(irq_read_recursion_soft)
 #include "locking-selftest-softirq.h"
 // GENERATE_PERMUTATIONS_3_EVENTS(irq_read_recursion2_soft)
 
+#ifdef CONFIG_QUEUED_SPINLOCKS
+/*
+ * The states of a queued spinlock's word.  Only the single owner case
+ * goes through the lock itself; the queued states are written by hand
+ * the way kernel/qspinlock.c encodes its tail, with the highest cpu and
+ * every nesting level.  Real contention is left to spinlock-bench.
+ */
+static void qspinlock_states(void)
+{
+	arch_spinlock_t lock = __ARCH_SPIN_LOCK_UNLOCKED;
+	int cpu = nr_cpu_ids - 1, idx;
+
+	DEBUG_LOCKS_WARN_ON(arch_spin_is_locked(&lock));
+	arch_spin_lock(&lock);
+	DEBUG_LOCKS_WARN_ON(!arch_spin_is_locked(&lock));
+	DEBUG_LOCKS_WARN_ON(arch_spin_is_contended(&lock));
+	DEBUG_LOCKS_WARN_ON(arch_spin_trylock(&lock));
+	arch_spin_unlock(&lock);
+	DEBUG_LOCKS_WARN_ON(arch_spin_is_locked(&lock));
+	DEBUG_LOCKS_WARN_ON(!arch_spin_trylock(&lock));
+	arch_spin_unlock(&lock);
+
+	for (idx = 0; idx <= _Q_TAIL_IDX_MASK >> _Q_TAIL_IDX_OFFSET; idx++) {
+		u32 tail = ((u32)(cpu + 1) << _Q_TAIL_CPU_OFFSET) |
+			   (idx << _Q_TAIL_IDX_OFFSET);
+
+		/* The tail must round trip, and stay out of the locked byte */
+		DEBUG_LOCKS_WARN_ON((tail & ~_Q_TAIL_MASK) != 0);
+		DEBUG_LOCKS_WARN_ON((tail >> _Q_TAIL_CPU_OFFSET) - 1 != cpu);
+		DEBUG_LOCKS_WARN_ON((tail & _Q_TAIL_IDX_MASK) >>
+				    _Q_TAIL_IDX_OFFSET != idx);
+
+		/* Owned, with a waiter queued behind the owner */
+		atomic_set(&lock.val, tail | _Q_LOCKED_VAL);
+		DEBUG_LOCKS_WARN_ON(!arch_spin_is_locked(&lock));
+		DEBUG_LOCKS_WARN_ON(!arch_spin_is_contended(&lock));
+		DEBUG_LOCKS_WARN_ON(arch_spin_trylock(&lock));
+
+		/* Released, but the queue head has yet to take it over */
+		arch_spin_unlock(&lock);
+		DEBUG_LOCKS_WARN_ON(atomic_read(&lock.val) != tail);
+		DEBUG_LOCKS_WARN_ON(!arch_spin_is_locked(&lock));
+		DEBUG_LOCKS_WARN_ON(!arch_spin_is_contended(&lock));
+		DEBUG_LOCKS_WARN_ON(arch_spin_trylock(&lock));
+
+		atomic_set(&lock.val, 0);
+	}
+}
+#endif
+
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 # define I_SPINLOCK(x)	lockdep_reset_lock(&lock_##x.dep_map)
 # define I_RWLOCK(x)	lockdep_reset_lock(&rwlock_##x.dep_map)
@@ -1174,6 +1224,12 @@ void locking_selftest(void)
 	dotest(rsem_AA3, FAILURE, LOCKTYPE_RWSEM);
 	printk("\n");
 
+#ifdef CONFIG_QUEUED_SPINLOCKS
+	print_testname("queued spinlock");
+	dotest(qspinlock_states, SUCCESS, LOCKTYPE_SPIN);
+	printk("\n");
+#endif
+
 	printk("  --------------------------------------------------------------------------\n");
 
 	/*
@@ -24,6 +24,9 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	sem->count = RWSEM_UNLOCKED_VALUE;
 	spin_lock_init(&sem->wait_lock);
 	INIT_LIST_HEAD(&sem->wait_list);
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	sem->owner = NULL;
+#endif
 }
 
 EXPORT_SYMBOL(__init_rwsem);
@@ -36,6 +39,21 @@ struct rwsem_waiter {
 #define RWSEM_WAITING_FOR_WRITE	0x00000002
 };
 
+/*
+ * The waiting part of the count holds a single RWSEM_WAITING_BIAS as long
+ * as the queue is not empty, whatever the number of waiters.
+ *
+ * Who to wake when the semaphore may have become available:
+ * - RWSEM_WAKE_ANY: the waiter at the front, writer or readers
+ * - RWSEM_WAKE_READERS: only readers, the caller is a queueing writer
+ * - RWSEM_WAKE_READ_OWNED: only readers, the caller holds a read lock
+ */
+enum rwsem_wake_type {
+	RWSEM_WAKE_ANY,
+	RWSEM_WAKE_READERS,
+	RWSEM_WAKE_READ_OWNED,
+};
+
 /*
  * handle the lock release when processes blocked on it that can now run
  * - if we come here from up_xxxx(), then:
@@ -44,85 +62,69 @@ struct rwsem_waiter {
  *   - there must be someone on the queue
  * - the spinlock must be held by the caller
  * - woken process blocks are discarded from the list after having task zeroed
- * - writers are only woken if downgrading is false
+ * - a writer at the front of the queue is only woken, not granted the lock:
+ *   it takes it itself when it runs, unless another writer already running
+ *   stole it in the meantime
+ * - readers are granted the lock, all those in the queue at once
  */
-static inline struct rw_semaphore *
-__rwsem_do_wake(struct rw_semaphore *sem, int downgrading)
+static struct rw_semaphore *
+__rwsem_do_wake(struct rw_semaphore *sem, enum rwsem_wake_type wake_type)
 {
-	struct rwsem_waiter *waiter;
+	struct rwsem_waiter *waiter, *tmp;
 	struct task_struct *tsk;
-	struct list_head *next;
-	signed long oldcount, woken, loop;
-
-	if (downgrading)
-		goto dont_wake_writers;
-
-	/* if we came through an up_xxxx() call, we only only wake someone up
-	 * if we can transition the active part of the count from 0 -> 1
-	 */
- try_again:
-	oldcount = rwsem_atomic_update(RWSEM_ACTIVE_BIAS, sem)
-						- RWSEM_ACTIVE_BIAS;
-	if (oldcount & RWSEM_ACTIVE_MASK)
-		goto undo;
+	signed long oldcount, woken, adjustment;
+	LIST_HEAD(wake_list);
 
 	waiter = list_entry(sem->wait_list.next, struct rwsem_waiter, list);
+	if (waiter->flags & RWSEM_WAITING_FOR_WRITE) {
+		if (wake_type == RWSEM_WAKE_ANY)
+			wake_up_process(waiter->task);
+		goto out;
+	}
 
-	/* try to grant a single write lock if there's a writer at the front
-	 * of the queue - note we leave the 'active part' of the count
-	 * incremented by 1 and the waiting part incremented by 0x00010000
-	 */
-	if (!(waiter->flags & RWSEM_WAITING_FOR_WRITE))
-		goto readers_only;
-
-	/* We must be careful not to touch 'waiter' after we set ->task = NULL.
-	 * It is an allocated on the waiter's stack and may become invalid at
-	 * any time after that point (due to a wakeup from another source).
+	/* Writers may steal the lock before we grant it to the readers: do
+	 * the first grant before counting the readers, so as to bail out
+	 * early if one did.
 	 */
-	list_del(&waiter->list);
-	tsk = waiter->task;
-	smp_mb();
-	waiter->task = NULL;
-	wake_up_process(tsk);
-	put_task_struct(tsk);
-	goto out;
-
-	/* don't want to wake any writers */
- dont_wake_writers:
-	waiter = list_entry(sem->wait_list.next, struct rwsem_waiter, list);
-	if (waiter->flags & RWSEM_WAITING_FOR_WRITE)
-		goto out;
+	adjustment = 0;
+	if (wake_type != RWSEM_WAKE_READ_OWNED) {
+		adjustment = RWSEM_ACTIVE_READ_BIAS;
+ try_reader_grant:
+		oldcount = rwsem_atomic_update(adjustment, sem) - adjustment;
+		if (unlikely(oldcount < RWSEM_WAITING_BIAS)) {
+			/* A writer stole the lock, undo our grant */
+			if (rwsem_atomic_update(-adjustment, sem) &
+						RWSEM_ACTIVE_MASK)
+				goto out;
+			/* Last active locker left, try again */
+			goto try_reader_grant;
+		}
+	}
 
-	/* grant an infinite number of read locks to the readers at the front
-	 * of the queue
-	 * - note we increment the 'active part' of the count by the number of
-	 *   readers before waking any processes up
+	/* Grant read locks to all the readers in the queue, not only those
+	 * at its front: they then run as one batch, instead of taking turns
+	 * with the writers queued between them and bouncing the semaphore
+	 * around.  The writers keep their order.
 	 */
- readers_only:
 	woken = 0;
-	do {
+	list_for_each_entry_safe(waiter, tmp, &sem->wait_list, list) {
+		if (waiter->flags & RWSEM_WAITING_FOR_WRITE)
+			continue;
+		list_move_tail(&waiter->list, &wake_list);
 		woken++;
+	}
 
-		if (waiter->list.next == &sem->wait_list)
-			break;
-
-		waiter = list_entry(waiter->list.next,
-					struct rwsem_waiter, list);
-
-	} while (waiter->flags & RWSEM_WAITING_FOR_READ);
-
-	loop = woken;
-	woken *= RWSEM_ACTIVE_BIAS - RWSEM_WAITING_BIAS;
-	if (!downgrading)
-		/* we'd already done one increment earlier */
-		woken -= RWSEM_ACTIVE_BIAS;
-
-	rwsem_atomic_add(woken, sem);
+	adjustment = woken * RWSEM_ACTIVE_READ_BIAS - adjustment;
+	if (list_empty(&sem->wait_list))
+		adjustment -= RWSEM_WAITING_BIAS;
+	if (adjustment)
+		rwsem_atomic_add(adjustment, sem);
 
-	next = sem->wait_list.next;
-	for (; loop > 0; loop--) {
-		waiter = list_entry(next, struct rwsem_waiter, list);
-		next = waiter->list.next;
+	/* We must be careful not to touch 'waiter' after we set ->task = NULL.
+	 * It is an allocated on the waiter's stack and may become invalid at
+	 * any time after that point (due to a wakeup from another source).
+	 */
+	list_for_each_entry_safe(waiter, tmp, &wake_list, list) {
 		tsk = waiter->task;
 		smp_mb();
 		waiter->task = NULL;
@@ -130,54 +132,50 @@ __rwsem_do_wake(struct rw_semaphore *sem, int downgrading)
 		put_task_struct(tsk);
 	}
 
-	sem->wait_list.next = next;
-	next->prev = &sem->wait_list;
-
  out:
 	return sem;
-
-	/* undo the change to the active count, but check for a transition
-	 * 1->0 */
- undo:
-	if (rwsem_atomic_update(-RWSEM_ACTIVE_BIAS, sem) & RWSEM_ACTIVE_MASK)
-		goto out;
-	goto try_again;
 }
 
 /*
- * wait for a lock to be granted
+ * wait for the read lock to be granted
  */
-static struct rw_semaphore __sched *
-rwsem_down_failed_common(struct rw_semaphore *sem,
-			struct rwsem_waiter *waiter, signed long adjustment)
+asmregparm struct rw_semaphore __sched *
+rwsem_down_read_failed(struct rw_semaphore *sem)
 {
+	signed long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
+	struct rwsem_waiter waiter;
 	struct task_struct *tsk = current;
-	signed long count;
-
-	set_task_state(tsk, TASK_UNINTERRUPTIBLE);
 
 	/* set up my own style of waitqueue */
-	spin_lock_irq(&sem->wait_lock);
-	waiter->task = tsk;
+	waiter.task = tsk;
+	waiter.flags = RWSEM_WAITING_FOR_READ;
 	get_task_struct(tsk);
 
-	list_add_tail(&waiter->list, &sem->wait_list);
+	spin_lock_irq(&sem->wait_lock);
+	if (list_empty(&sem->wait_list))
+		adjustment += RWSEM_WAITING_BIAS;
+	list_add_tail(&waiter.list, &sem->wait_list);
 
-	/* we're now waiting on the lock, but no longer actively read-locking */
+	/* we're now waiting on the lock, but no longer actively locking */
 	count = rwsem_atomic_update(adjustment, sem);
 
-	/* if there are no active locks, wake the front queued process(es) up */
-	if (!(count & RWSEM_ACTIVE_MASK))
-		sem = __rwsem_do_wake(sem, 0);
+	/* If there are no active locks, wake the front queued process(es).
+	 * If there are only readers active and we are the first in the
+	 * queue, wake ourselves up to join them.
+	 */
+	if (count == RWSEM_WAITING_BIAS ||
+	    (count > RWSEM_WAITING_BIAS &&
+	     adjustment != -RWSEM_ACTIVE_READ_BIAS))
+		sem = __rwsem_do_wake(sem, RWSEM_WAKE_ANY);
 
 	spin_unlock_irq(&sem->wait_lock);
 
 	/* wait to be given the lock */
 	for (;;) {
-		if (!waiter->task)
+		set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+		if (!waiter.task)
 			break;
 		schedule();
-		set_task_state(tsk, TASK_UNINTERRUPTIBLE);
 	}
 
 	tsk->state = TASK_RUNNING;
@@ -186,18 +184,94 @@ rwsem_down_failed_common(struct rw_semaphore *sem,
 }
 
 /*
- * wait for the read lock to be granted
+ * Try to take the write lock from the queue: only when there is no active
+ * locker, and with the waiting bias left in place for the other waiters.
+ * Called with the wait_lock held.
  */
-asmregparm struct rw_semaphore __sched *
-rwsem_down_read_failed(struct rw_semaphore *sem)
+static inline int rwsem_try_write_lock(signed long count,
+				       struct rw_semaphore *sem)
 {
-	struct rwsem_waiter waiter;
+	if (count & RWSEM_ACTIVE_MASK)
+		return 0;
+
+	if (sem->count == RWSEM_WAITING_BIAS &&
+	    cmpxchg(&sem->count, RWSEM_WAITING_BIAS,
+		    RWSEM_ACTIVE_WRITE_BIAS) == RWSEM_WAITING_BIAS) {
+		if (!list_is_singular(&sem->wait_list))
+			rwsem_atomic_update(RWSEM_WAITING_BIAS, sem);
+		return 1;
+	}
+	return 0;
+}
 
-	waiter.flags = RWSEM_WAITING_FOR_READ;
-	rwsem_down_failed_common(sem, &waiter,
-				RWSEM_WAITING_BIAS - RWSEM_ACTIVE_BIAS);
-	return sem;
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * Try to take the write lock without queueing, waiters or not: this is
+ * where a writer already running steals it from the ones woken up.
+ */
+static inline int rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
+{
+	signed long old, count = ACCESS_ONCE(sem->count);
+
+	while (!count || count == RWSEM_WAITING_BIAS) {
+		old = cmpxchg(&sem->count, count,
+			      count + RWSEM_ACTIVE_WRITE_BIAS);
+		if (old == count)
+			return 1;
+		count = old;
+	}
+	return 0;
+}
+
+/*
+ * Optimistic spinning, as for mutexes (see __mutex_lock_common()): while
+ * the semaphore is held by a writer running on another cpu, it is likely
+ * to be released soon, and spinning for it is cheaper than sleeping.  No
+ * spinning on readers, there is no telling how long they will take.
+ */
+static int rwsem_optimistic_spin(struct rw_semaphore *sem)
+{
+	struct task_struct *task = current;
+	int taken = 0;
+
+	if (!rwsem_spin_enabled())
+		return 0;
+
+	preempt_disable();
+	for (;;) {
+		struct thread_info *owner = ACCESS_ONCE(sem->owner);
+
+		if (owner == RWSEM_READER_OWNED)
+			break;
+		if (owner && !rwsem_spin_on_owner(sem, owner))
+			break;
+
+		if (rwsem_try_write_lock_unqueued(sem)) {
+			taken = 1;
+			break;
+		}
+
+		/*
+		 * When there's no owner, we might have preempted between the
+		 * owner acquiring the lock and setting the owner field. If
+		 * we're an RT task that will live-lock because we won't let
+		 * the owner complete.
+		 */
+		if (!owner && (need_resched() || rt_task(task)))
+			break;
+
+		cpu_relax();
+	}
+	preempt_enable();
+
+	return taken;
+}
+#else
+static inline int rwsem_optimistic_spin(struct rw_semaphore *sem)
+{
+	return 0;
 }
+#endif
 
 /*
  * wait for the write lock to be granted
@@ -205,10 +279,57 @@ rwsem_down_read_failed(struct rw_semaphore *sem)
 asmregparm struct rw_semaphore __sched *
 rwsem_down_write_failed(struct rw_semaphore *sem)
 {
+	signed long count;
 	struct rwsem_waiter waiter;
+	struct task_struct *tsk = current;
+	int waiting = 1;
 
+	/* undo the write bias of down_write(), we're not active anymore */
+	rwsem_atomic_add(-RWSEM_ACTIVE_WRITE_BIAS, sem);
+
+	if (rwsem_optimistic_spin(sem))
+		return sem;
+
+	/* set up my own style of waitqueue */
+	waiter.task = tsk;
 	waiter.flags = RWSEM_WAITING_FOR_WRITE;
-	rwsem_down_failed_common(sem, &waiter, -RWSEM_ACTIVE_BIAS);
+
+	spin_lock_irq(&sem->wait_lock);
+	if (list_empty(&sem->wait_list))
+		waiting = 0;
+	list_add_tail(&waiter.list, &sem->wait_list);
+
+	if (waiting) {
+		count = ACCESS_ONCE(sem->count);
+
+		/* If there were already threads queued before us and there
+		 * are no active writers, the lock must be read owned: wake
+		 * the readers queued ahead of us so that they join in.
+		 */
+		if (count > RWSEM_WAITING_BIAS)
+			sem = __rwsem_do_wake(sem, RWSEM_WAKE_READERS);
+	} else
+		count = rwsem_atomic_update(RWSEM_WAITING_BIAS, sem);
+
+	/* wait until we manage to take the lock */
+	set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+	for (;;) {
+		if (rwsem_try_write_lock(count, sem))
+			break;
+		spin_unlock_irq(&sem->wait_lock);
+
+		/* block until there are no active lockers */
+		do {
+			schedule();
+			set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+		} while ((count = sem->count) & RWSEM_ACTIVE_MASK);
+
+		spin_lock_irq(&sem->wait_lock);
+	}
+	tsk->state = TASK_RUNNING;
+
+	list_del(&waiter.list);
+	spin_unlock_irq(&sem->wait_lock);
 
 	return sem;
 }
@@ -225,7 +346,7 @@ asmregparm struct rw_semaphore *rwsem_wake(struct rw_semaphore *sem)
 
 	/* do nothing if list empty */
 	if (!list_empty(&sem->wait_list))
-		sem = __rwsem_do_wake(sem, 0);
+		sem = __rwsem_do_wake(sem, RWSEM_WAKE_ANY);
 
 	spin_unlock_irqrestore(&sem->wait_lock, flags);
 
@@ -245,7 +366,7 @@ asmregparm struct rw_semaphore *rwsem_downgrade_wake(struct rw_semaphore *sem)
 
 	/* do nothing if list empty */
 	if (!list_empty(&sem->wait_list))
-		sem = __rwsem_do_wake(sem, 1);
+		sem = __rwsem_do_wake(sem, RWSEM_WAKE_READ_OWNED);
 
 	spin_unlock_irqrestore(&sem->wait_lock, flags);
 
@@ -45,6 +45,13 @@ extern unsigned long highest_memmap_pfn;
 extern int isolate_lru_page(struct page *page);
 extern void putback_lru_page(struct page *page);
 
+/*
+ * in mm/swap.c
+ */
+extern u64 lru_lock_hold_start(void);
+extern void lru_lock_hold_end(struct zone *zone, int op, unsigned int nr,
+			      u64 start);
+
 /*
  * in mm/page_alloc.c
  */
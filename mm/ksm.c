@@ -33,6 +33,7 @@
 #include <linux/mmu_notifier.h>
 #include <linux/swap.h>
 #include <linux/ksm.h>
+#include <linux/math64.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -83,12 +84,14 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @worker: the ksmd worker which scans this mm
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	unsigned int worker;
 };
 
 /**
@@ -96,9 +99,10 @@ struct mm_slot {
  * @mm_slot: the current mm_slot we are scanning
  * @address: the next address inside that to be scanned
  * @rmap_list: link to the next rmap to be scanned in the rmap_list
- * @seqnr: count of completed full scans (needed when removing unstable node)
+ * @seqnr: the full scan this cursor is working on, or waiting to start
  *
- * There is only the one ksm_scan instance of this cursor structure.
+ * Each ksmd worker has its own cursor, which only stops on the mm_slots
+ * that worker owns.
  */
 struct ksm_scan {
 	struct mm_slot *mm_slot;
@@ -107,6 +111,27 @@ struct ksm_scan {
 	unsigned long seqnr;
 };
 
+/**
+ * struct ksm_worker - one of the ksmd threads
+ * @scan: cursor over the mm_slots owned by this worker
+ * @task: the thread itself, once started
+ * @stale_items: rmap_items unlinked from their rmap_list, still to be
+ *	removed from the stable or unstable tree
+ * @id: index in ksm_workers[]
+ * @cpu_ns: cpu time spent scanning
+ * @pages_merged: pages freed by merging
+ * @pages_skipped: volatile pages not checksummed
+ */
+struct ksm_worker {
+	struct ksm_scan scan;
+	struct task_struct *task;
+	struct rmap_item *stale_items;
+	unsigned int id;
+	u64 cpu_ns;
+	unsigned long pages_merged;
+	unsigned long pages_skipped;
+};
+
 /**
  * struct stable_node - node of the stable rbtree
  * @node: rb node of this ksm page in the stable tree
@@ -126,6 +151,8 @@ struct stable_node {
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
  * @oldchecksum: previous checksum of the page at that virtual address
+ * @volatility: number of scans in a row which found the checksum changed
+ * @skips: number of scans still to skip this volatile page
  * @node: rb node of this rmap_item in the unstable tree
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
@@ -136,6 +163,8 @@ struct rmap_item {
 	struct mm_struct *mm;
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
+	unsigned char volatility;
+	unsigned char skips;
 	union {
 		struct rb_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
@@ -159,8 +188,13 @@ static struct hlist_head *mm_slots_hash;
 static struct mm_slot ksm_mm_head = {
 	.mm_list = LIST_HEAD_INIT(ksm_mm_head.mm_list),
 };
-static struct ksm_scan ksm_scan = {
-	.mm_slot = &ksm_mm_head,
+
+#define KSM_MAX_WORKERS	16
+
+static struct ksm_worker ksm_workers[KSM_MAX_WORKERS] = {
+	[0 ... KSM_MAX_WORKERS - 1] = {
+		.scan.mm_slot = &ksm_mm_head,
+	},
 };
 
 static struct kmem_cache *rmap_item_cache;
@@ -177,21 +211,41 @@ static unsigned long ksm_pages_sharing;
 static unsigned long ksm_pages_unshared;
 
 /* The number of rmap_items in use: to calculate pages_volatile */
-static unsigned long ksm_rmap_items;
+static atomic_long_t ksm_rmap_items = ATOMIC_LONG_INIT(0);
 
-/* Number of pages ksmd should scan in one batch */
+/* Number of full scans completed (needed when removing unstable node) */
+static unsigned long ksm_seqnr;
+
+/* Number of workers scanning, and number wanted from the next full scan */
+static unsigned int ksm_nr_workers = 1;
+static unsigned int ksm_nr_workers_wanted = 1;
+
+/* Number of workers which have completed the current full scan */
+static unsigned int ksm_workers_done;
+
+/* Round robin assignment of new mm_slots to workers */
+static unsigned int ksm_next_worker;
+
+/* Number of pages each worker should scan in one batch */
 static unsigned int ksm_thread_pages_to_scan = 100;
 
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Skip checksumming pages found changing scan after scan */
+static unsigned int ksm_smart_scan = 1;
+
+/* Percent of one cpu the workers may use together: 0 to not tune */
+static unsigned int ksm_cpu_budget;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
 static unsigned int ksm_run = KSM_RUN_STOP;
 
 static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
-static DEFINE_MUTEX(ksm_thread_mutex);
+static DECLARE_RWSEM(ksm_thread_sem);	/* held for read by each worker */
+static DEFINE_MUTEX(ksm_tree_mutex);	/* stable and unstable trees */
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
 
 #define KSM_KMEM_CACHE(__struct, __flags) kmem_cache_create("ksm_"#__struct,\
@@ -236,13 +290,13 @@ static inline struct rmap_item *alloc_rmap_item(void)
 
 	rmap_item = kmem_cache_zalloc(rmap_item_cache, GFP_KERNEL);
 	if (rmap_item)
-		ksm_rmap_items++;
+		atomic_long_inc(&ksm_rmap_items);
 	return rmap_item;
 }
 
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
-	ksm_rmap_items--;
+	atomic_long_dec(&ksm_rmap_items);
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -497,7 +551,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
  * a page to put something that might look like our key in page->mapping.
  *
  * include/linux/pagemap.h page_cache_get_speculative() is a good reference,
- * but this is different - made simpler by ksm_thread_mutex being held, but
+ * but this is different - made simpler by ksm_tree_mutex being held, but
  * interesting for assuming that no other use of the struct page could ever
  * put our expected_mapping into page->mapping (or a field of the union which
  * coincides with page->mapping).  The RCU calls are not for KSM at all, but
@@ -570,7 +624,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		 * if this rmap_item was inserted by this scan, rather
 		 * than left over from before.
 		 */
-		age = (unsigned char)(ksm_scan.seqnr - rmap_item->address);
+		age = (unsigned char)(ksm_seqnr - rmap_item->address);
 		BUG_ON(age > 1);
 		if (!age)
 			rb_erase(&rmap_item->node, &root_unstable_tree);
@@ -593,6 +647,110 @@ static void remove_trailing_rmap_items(struct mm_slot *mm_slot,
 	}
 }
 
+/*
+ * A worker holding mmap_sem must not take ksm_tree_mutex: other workers
+ * take mmap_sem while holding it.  So the worker just unlinks rmap_items
+ * from their rmap_list (which only it modifies), and removes them from
+ * the trees with ksm_flush_stale_items() once mmap_sem is dropped.  Even
+ * an rmap_item in neither tree might be about to enter the stable tree
+ * from another worker's cmp_and_merge_page(), so they all go that way.
+ */
+static void defer_remove_rmap_item(struct ksm_worker *worker,
+				   struct rmap_item *rmap_item)
+{
+	rmap_item->rmap_list = worker->stale_items;
+	worker->stale_items = rmap_item;
+}
+
+static void defer_trailing_rmap_items(struct ksm_worker *worker,
+				      struct rmap_item **rmap_list)
+{
+	while (*rmap_list) {
+		struct rmap_item *rmap_item = *rmap_list;
+		*rmap_list = rmap_item->rmap_list;
+		defer_remove_rmap_item(worker, rmap_item);
+	}
+}
+
+static void ksm_flush_stale_items(struct ksm_worker *worker)
+{
+	struct rmap_item *rmap_item;
+
+	if (!worker->stale_items)
+		return;
+
+	mutex_lock(&ksm_tree_mutex);
+	while ((rmap_item = worker->stale_items)) {
+		worker->stale_items = rmap_item->rmap_list;
+		remove_rmap_item_from_tree(rmap_item);
+		free_rmap_item(rmap_item);
+	}
+	mutex_unlock(&ksm_tree_mutex);
+}
+
+/*
+ * Start a new full scan: called by the last worker to complete the one
+ * before, with ksm_tree_mutex held, or with ksm_thread_sem held for write.
+ * This is also when a new number of workers takes effect, the mm_slots
+ * being handed out again round robin.
+ */
+static void ksm_start_full_scan(void)
+{
+	struct mm_slot *mm_slot;
+	unsigned int i;
+
+	root_unstable_tree = RB_ROOT;
+	ksm_workers_done = 0;
+
+	spin_lock(&ksm_mmlist_lock);
+	if (ksm_nr_workers != ksm_nr_workers_wanted) {
+		ksm_nr_workers = ksm_nr_workers_wanted;
+		i = 0;
+		list_for_each_entry(mm_slot, &ksm_mm_head.mm_list, mm_list)
+			mm_slot->worker = i++ % ksm_nr_workers;
+		ksm_next_worker = i;
+	}
+	spin_unlock(&ksm_mmlist_lock);
+
+	for (i = 0; i < KSM_MAX_WORKERS; i++)
+		ksm_workers[i].scan.seqnr = ksm_seqnr;
+}
+
+/*
+ * Called by a worker which has scanned all the mm_slots it owns: it then
+ * waits for the others, the last of which completes the full scan.
+ */
+static void ksm_worker_scan_done(struct ksm_worker *worker)
+{
+	mutex_lock(&ksm_tree_mutex);
+	worker->scan.seqnr++;
+	if (++ksm_workers_done >= ksm_nr_workers) {
+		ksm_seqnr++;
+		ksm_start_full_scan();
+	}
+	mutex_unlock(&ksm_tree_mutex);
+}
+
+/*
+ * Next mm_slot after mm_slot owned by worker, or ksm_mm_head:
+ * called with ksm_mmlist_lock held.
+ */
+static struct mm_slot *ksm_next_mm_slot(struct ksm_worker *worker,
+					struct mm_slot *mm_slot)
+{
+	do {
+		mm_slot = list_entry(mm_slot->mm_list.next,
+				     struct mm_slot, mm_list);
+	} while (mm_slot != &ksm_mm_head && mm_slot->worker != worker->id);
+	return mm_slot;
+}
+
+/* The cursor which protects mm_slot from being freed by __ksm_exit */
+static inline struct ksm_scan *mm_slot_cursor(struct mm_slot *mm_slot)
+{
+	return &ksm_workers[mm_slot->worker].scan;
+}
+
 /*
  * Though it's very tempting to unmerge in_stable_tree(rmap_item)s rather
  * than check every pte of a given vma, the locking doesn't quite work for
@@ -629,18 +787,25 @@ static int unmerge_ksm_pages(struct vm_area_struct *vma,
  */
 static int unmerge_and_remove_all_rmap_items(void)
 {
-	struct mm_slot *mm_slot;
+	struct mm_slot *mm_slot, *next;
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
-	int err = 0;
+	int i, err = 0;
 
+	/*
+	 * No worker is scanning: walk the list with the cursor of each mm's
+	 * owner pointing to it, which keeps __ksm_exit from freeing it.
+	 */
 	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = list_entry(ksm_mm_head.mm_list.next,
-						struct mm_slot, mm_list);
+	for (i = 0; i < KSM_MAX_WORKERS; i++)
+		ksm_workers[i].scan.mm_slot = &ksm_mm_head;
+	mm_slot = list_entry(ksm_mm_head.mm_list.next,
+			     struct mm_slot, mm_list);
+	if (mm_slot != &ksm_mm_head)
+		mm_slot_cursor(mm_slot)->mm_slot = mm_slot;
 	spin_unlock(&ksm_mmlist_lock);
 
-	for (mm_slot = ksm_scan.mm_slot;
-			mm_slot != &ksm_mm_head; mm_slot = ksm_scan.mm_slot) {
+	for (; mm_slot != &ksm_mm_head; mm_slot = next) {
 		mm = mm_slot->mm;
 		down_read(&mm->mmap_sem);
 		for (vma = mm->mmap; vma; vma = vma->vm_next) {
@@ -657,8 +822,11 @@ static int unmerge_and_remove_all_rmap_items(void)
 		remove_trailing_rmap_items(mm_slot, &mm_slot->rmap_list);
 
 		spin_lock(&ksm_mmlist_lock);
-		ksm_scan.mm_slot = list_entry(mm_slot->mm_list.next,
-						struct mm_slot, mm_list);
+		next = list_entry(mm_slot->mm_list.next,
+				  struct mm_slot, mm_list);
+		mm_slot_cursor(mm_slot)->mm_slot = &ksm_mm_head;
+		if (next != &ksm_mm_head)
+			mm_slot_cursor(next)->mm_slot = next;
 		if (ksm_test_exit(mm)) {
 			hlist_del(&mm_slot->link);
 			list_del(&mm_slot->mm_list);
@@ -674,13 +842,14 @@ static int unmerge_and_remove_all_rmap_items(void)
 		}
 	}
 
-	ksm_scan.seqnr = 0;
+	ksm_seqnr = 0;
+	ksm_start_full_scan();
 	return 0;
 
 error:
 	up_read(&mm->mmap_sem);
 	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = &ksm_mm_head;
+	mm_slot_cursor(mm_slot)->mm_slot = &ksm_mm_head;
 	spin_unlock(&ksm_mmlist_lock);
 	return err;
 }
@@ -1113,7 +1282,7 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 	}
 
 	rmap_item->address |= UNSTABLE_FLAG;
-	rmap_item->address |= (ksm_scan.seqnr & SEQNR_MASK);
+	rmap_item->address |= (ksm_seqnr & SEQNR_MASK);
 	rb_link_node(&rmap_item->node, parent, new);
 	rb_insert_color(&rmap_item->node, &root_unstable_tree);
 
@@ -1148,7 +1317,38 @@ static void stable_tree_append(struct rmap_item *rmap_item,
  * @page: the page that we are searching identical page to.
  * @rmap_item: the reverse mapping into the virtual address of this page
  */
-static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
+/*
+ * The checksum of the page at rmap_item has changed again: the more scans
+ * in a row it changes, the more scans it will now be skipped for.
+ */
+#define KSM_VOLATILE_SKIP	2	/* changes in a row before skipping */
+#define KSM_VOLATILE_MAX	(KSM_VOLATILE_SKIP + 4)	/* up to 16 skips */
+
+static void rmap_item_changed(struct rmap_item *rmap_item)
+{
+	if (rmap_item->volatility < KSM_VOLATILE_MAX)
+		rmap_item->volatility++;
+	if (ksm_smart_scan && rmap_item->volatility >= KSM_VOLATILE_SKIP)
+		rmap_item->skips =
+			1 << (rmap_item->volatility - KSM_VOLATILE_SKIP);
+}
+
+static bool skip_volatile_rmap_item(struct ksm_worker *worker,
+				    struct rmap_item *rmap_item)
+{
+	if (!rmap_item->skips)
+		return false;
+	rmap_item->skips--;
+	worker->pages_skipped++;
+	return true;
+}
+
+/*
+ * Workers compare and merge their pages under ksm_tree_mutex, except for
+ * the checksum, which is where they mostly run in parallel.
+ */
+static void cmp_and_merge_page(struct ksm_worker *worker,
+			       struct page *page, struct rmap_item *rmap_item)
 {
 	struct rmap_item *tree_rmap_item;
 	struct page *tree_page = NULL;
@@ -1157,6 +1357,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	unsigned int checksum;
 	int err;
 
+	mutex_lock(&ksm_tree_mutex);
 	remove_rmap_item_from_tree(rmap_item);
 
 	/* We first start with searching the page inside the stable tree */
@@ -1171,10 +1372,12 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			worker->pages_merged++;
 		}
 		put_page(kpage);
-		return;
+		goto out;
 	}
+	mutex_unlock(&ksm_tree_mutex);
 
 	/*
 	 * If the hash value of the page has changed from the last time
@@ -1185,9 +1388,12 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
+		rmap_item_changed(rmap_item);
 		return;
 	}
+	rmap_item->volatility = 0;
 
+	mutex_lock(&ksm_tree_mutex);
 	tree_rmap_item =
 		unstable_tree_search_insert(rmap_item, page, &tree_page);
 	if (tree_rmap_item) {
@@ -1219,12 +1425,16 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			if (!stable_node) {
 				break_cow(tree_rmap_item);
 				break_cow(rmap_item);
-			}
+			} else
+				worker->pages_merged++;
 		}
 	}
+out:
+	mutex_unlock(&ksm_tree_mutex);
 }
 
-static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
+static struct rmap_item *get_next_rmap_item(struct ksm_worker *worker,
+					    struct mm_slot *mm_slot,
 					    struct rmap_item **rmap_list,
 					    unsigned long addr)
 {
@@ -1237,8 +1447,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 		if (rmap_item->address > addr)
 			break;
 		*rmap_list = rmap_item->rmap_list;
-		remove_rmap_item_from_tree(rmap_item);
-		free_rmap_item(rmap_item);
+		defer_remove_rmap_item(worker, rmap_item);
 	}
 
 	rmap_item = alloc_rmap_item();
@@ -1252,8 +1461,10 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
-static struct rmap_item *scan_get_next_rmap_item(struct page **page)
+static struct rmap_item *scan_get_next_rmap_item(struct ksm_worker *worker,
+						 struct page **page)
 {
+	struct ksm_scan *scan = &worker->scan;
 	struct mm_struct *mm;
 	struct mm_slot *slot;
 	struct vm_area_struct *vma;
@@ -1262,17 +1473,21 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 	if (list_empty(&ksm_mm_head.mm_list))
 		return NULL;
 
-	slot = ksm_scan.mm_slot;
-	if (slot == &ksm_mm_head) {
-		root_unstable_tree = RB_ROOT;
+	/* Done with this full scan: wait for the other workers */
+	if (scan->seqnr != ksm_seqnr)
+		return NULL;
 
+	slot = scan->mm_slot;
+	if (slot == &ksm_mm_head) {
 		spin_lock(&ksm_mmlist_lock);
-		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
-		ksm_scan.mm_slot = slot;
+		slot = ksm_next_mm_slot(worker, slot);
+		scan->mm_slot = slot;
 		spin_unlock(&ksm_mmlist_lock);
+		if (slot == &ksm_mm_head)
+			goto done;
 next_mm:
-		ksm_scan.address = 0;
-		ksm_scan.rmap_list = &slot->rmap_list;
+		scan->address = 0;
+		scan->rmap_list = &slot->rmap_list;
 	}
 
 	mm = slot->mm;
@@ -1280,29 +1495,29 @@ next_mm:
 	if (ksm_test_exit(mm))
 		vma = NULL;
 	else
-		vma = find_vma(mm, ksm_scan.address);
+		vma = find_vma(mm, scan->address);
 
 	for (; vma; vma = vma->vm_next) {
 		if (!(vma->vm_flags & VM_MERGEABLE))
 			continue;
-		if (ksm_scan.address < vma->vm_start)
-			ksm_scan.address = vma->vm_start;
+		if (scan->address < vma->vm_start)
+			scan->address = vma->vm_start;
 		if (!vma->anon_vma)
-			ksm_scan.address = vma->vm_end;
+			scan->address = vma->vm_end;
 
-		while (ksm_scan.address < vma->vm_end) {
+		while (scan->address < vma->vm_end) {
 			if (ksm_test_exit(mm))
 				break;
-			*page = follow_page(vma, ksm_scan.address, FOLL_GET);
+			*page = follow_page(vma, scan->address, FOLL_GET);
 			if (!IS_ERR_OR_NULL(*page) && PageAnon(*page)) {
-				flush_anon_page(vma, *page, ksm_scan.address);
+				flush_anon_page(vma, *page, scan->address);
 				flush_dcache_page(*page);
-				rmap_item = get_next_rmap_item(slot,
-					ksm_scan.rmap_list, ksm_scan.address);
+				rmap_item = get_next_rmap_item(worker, slot,
+					scan->rmap_list, scan->address);
 				if (rmap_item) {
-					ksm_scan.rmap_list =
+					scan->rmap_list =
 							&rmap_item->rmap_list;
-					ksm_scan.address += PAGE_SIZE;
+					scan->address += PAGE_SIZE;
 				} else
 					put_page(*page);
 				up_read(&mm->mmap_sem);
@@ -1310,25 +1525,24 @@ next_mm:
 			}
 			if (!IS_ERR_OR_NULL(*page))
 				put_page(*page);
-			ksm_scan.address += PAGE_SIZE;
+			scan->address += PAGE_SIZE;
 			cond_resched();
 		}
 	}
 
 	if (ksm_test_exit(mm)) {
-		ksm_scan.address = 0;
-		ksm_scan.rmap_list = &slot->rmap_list;
+		scan->address = 0;
+		scan->rmap_list = &slot->rmap_list;
 	}
 	/*
 	 * Nuke all the rmap_items that are above this current rmap:
 	 * because there were no VM_MERGEABLE vmas with such addresses.
 	 */
-	remove_trailing_rmap_items(slot, ksm_scan.rmap_list);
+	defer_trailing_rmap_items(worker, scan->rmap_list);
 
 	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = list_entry(slot->mm_list.next,
-						struct mm_slot, mm_list);
-	if (ksm_scan.address == 0) {
+	scan->mm_slot = ksm_next_mm_slot(worker, slot);
+	if (scan->address == 0) {
 		/*
 		 * We've completed a full scan of all vmas, holding mmap_sem
 		 * throughout, and found no VM_MERGEABLE: so do the same as
@@ -1345,6 +1559,8 @@ next_mm:
 		free_mm_slot(slot);
 		clear_bit(MMF_VM_MERGEABLE, &mm->flags);
 		up_read(&mm->mmap_sem);
+		/* Its rmap_items must leave the trees before the mm goes */
+		ksm_flush_stale_items(worker);
 		mmdrop(mm);
 	} else {
 		spin_unlock(&ksm_mmlist_lock);
@@ -1352,55 +1568,134 @@ next_mm:
 	}
 
 	/* Repeat until we've completed scanning the whole list */
-	slot = ksm_scan.mm_slot;
+	slot = scan->mm_slot;
 	if (slot != &ksm_mm_head)
 		goto next_mm;
-
-	ksm_scan.seqnr++;
+done:
+	ksm_flush_stale_items(worker);
+	ksm_worker_scan_done(worker);
 	return NULL;
 }
 
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
+ * @worker - the worker scanning.
  * @scan_npages - number of pages we want to scan before we return.
+ *
+ * Returns the number of pages scanned.
  */
-static void ksm_do_scan(unsigned int scan_npages)
+static unsigned int ksm_do_scan(struct ksm_worker *worker,
+				unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	unsigned long long start = task_sched_runtime(current);
+	unsigned int scanned;
 
-	while (scan_npages--) {
+	for (scanned = 0; scanned < scan_npages; scanned++) {
 		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
+		rmap_item = scan_get_next_rmap_item(worker, &page);
+		ksm_flush_stale_items(worker);
 		if (!rmap_item)
-			return;
-		if (!PageKsm(page) || !in_stable_tree(rmap_item))
-			cmp_and_merge_page(page, rmap_item);
+			break;
+		if ((!PageKsm(page) || !in_stable_tree(rmap_item)) &&
+		    !skip_volatile_rmap_item(worker, rmap_item))
+			cmp_and_merge_page(worker, page, rmap_item);
 		put_page(page);
 	}
+
+	worker->cpu_ns += task_sched_runtime(current) - start;
+	return scanned;
 }
 
-static int ksmd_should_run(void)
+/*
+ * Sum the statistics of all workers: not worth any locking.
+ */
+static void ksm_worker_stats(u64 *cpu_ns, unsigned long *pages_merged,
+			     unsigned long *pages_skipped)
+{
+	int i;
+
+	*cpu_ns = 0;
+	*pages_merged = *pages_skipped = 0;
+	for (i = 0; i < KSM_MAX_WORKERS; i++) {
+		*cpu_ns += ksm_workers[i].cpu_ns;
+		*pages_merged += ksm_workers[i].pages_merged;
+		*pages_skipped += ksm_workers[i].pages_skipped;
+	}
+}
+
+/*
+ * With a cpu_budget set, the first worker adjusts pages_to_scan about once
+ * a second, in proportion to the cpu time all the workers used against
+ * the budget.  It only raises it when it scanned full batches: otherwise
+ * there was nothing more to scan, and cpu time is not what limited it.
+ */
+#define KSM_TUNE_INTERVAL	HZ
+#define KSM_TUNE_MIN_PAGES	16
+#define KSM_TUNE_MAX_PAGES	65536
+
+static void ksm_tune_pages_to_scan(bool full_batch)
+{
+	static unsigned long last_jiffies;
+	static u64 last_cpu_ns;
+	unsigned long elapsed = jiffies - last_jiffies;
+	unsigned long pages_merged, pages_skipped;
+	unsigned int budget = ksm_cpu_budget;
+	u64 cpu_ns, used, pages;
+
+	if (!budget || elapsed < KSM_TUNE_INTERVAL)
+		return;
+
+	ksm_worker_stats(&cpu_ns, &pages_merged, &pages_skipped);
+	/* Percent of one cpu used since last time */
+	used = div64_u64((cpu_ns - last_cpu_ns) * 100,
+			 (u64)jiffies_to_usecs(elapsed) * NSEC_PER_USEC);
+	last_jiffies = jiffies;
+	last_cpu_ns = cpu_ns;
+
+	pages = ksm_thread_pages_to_scan;
+	if (used > budget)
+		pages = max(div64_u64(pages * budget, used), pages / 2);
+	else if (full_batch)
+		pages = used ? min(div64_u64(pages * budget, used), pages * 2) :
+			       pages * 2;
+	ksm_thread_pages_to_scan = clamp_t(u64, pages,
+					   KSM_TUNE_MIN_PAGES,
+					   KSM_TUNE_MAX_PAGES);
+}
+
+static int ksmd_should_run(struct ksm_worker *worker)
 {
-	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
+	return (ksm_run & KSM_RUN_MERGE) && worker->id < ksm_nr_workers &&
+		!list_empty(&ksm_mm_head.mm_list);
 }
 
-static int ksm_scan_thread(void *nothing)
+static int ksm_scan_thread(void *arg)
 {
+	struct ksm_worker *worker = arg;
+	unsigned int nr_pages, scanned;
+
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
-		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
-		mutex_unlock(&ksm_thread_mutex);
+		nr_pages = scanned = 0;
+		down_read(&ksm_thread_sem);
+		if (ksmd_should_run(worker)) {
+			nr_pages = ksm_thread_pages_to_scan;
+			scanned = ksm_do_scan(worker, nr_pages);
+		}
+		up_read(&ksm_thread_sem);
+
+		if (!worker->id)
+			ksm_tune_pages_to_scan(nr_pages && scanned == nr_pages);
 
-		if (ksmd_should_run()) {
+		if (ksmd_should_run(worker)) {
 			schedule_timeout_interruptible(
 				msecs_to_jiffies(ksm_thread_sleep_millisecs));
 		} else {
 			wait_event_interruptible(ksm_thread_wait,
-				ksmd_should_run() || kthread_should_stop());
+				ksmd_should_run(worker) || kthread_should_stop());
 		}
 	}
 	return 0;
@@ -1463,12 +1758,14 @@ int __ksm_enter(struct mm_struct *mm)
 
 	spin_lock(&ksm_mmlist_lock);
 	insert_to_mm_slots_hash(mm, mm_slot);
+	mm_slot->worker = ksm_next_worker++ % ksm_nr_workers;
 	/*
 	 * Insert just behind the scanning cursor, to let the area settle
 	 * down a little; when fork is followed by immediate exec, we don't
 	 * want ksmd to waste time setting up and tearing down an rmap_list.
 	 */
-	list_add_tail(&mm_slot->mm_list, &ksm_scan.mm_slot->mm_list);
+	list_add_tail(&mm_slot->mm_list,
+		      &mm_slot_cursor(mm_slot)->mm_slot->mm_list);
 	spin_unlock(&ksm_mmlist_lock);
 
 	set_bit(MMF_VM_MERGEABLE, &mm->flags);
@@ -1496,14 +1793,14 @@ void __ksm_exit(struct mm_struct *mm)
 
 	spin_lock(&ksm_mmlist_lock);
 	mm_slot = get_mm_slot(mm);
-	if (mm_slot && ksm_scan.mm_slot != mm_slot) {
+	if (mm_slot && mm_slot_cursor(mm_slot)->mm_slot != mm_slot) {
 		if (!mm_slot->rmap_list) {
 			hlist_del(&mm_slot->link);
 			list_del(&mm_slot->mm_list);
 			easy_to_free = 1;
 		} else {
 			list_move(&mm_slot->mm_list,
-				  &ksm_scan.mm_slot->mm_list);
+				  &mm_slot_cursor(mm_slot)->mm_slot->mm_list);
 		}
 	}
 	spin_unlock(&ksm_mmlist_lock);
@@ -1745,7 +2042,7 @@ static int ksm_memory_callback(struct notifier_block *self,
 		 * Keep it very simple for now: just lock out ksmd and
 		 * MADV_UNMERGEABLE while any memory is going offline.
 		 */
-		mutex_lock(&ksm_thread_mutex);
+		down_write(&ksm_thread_sem);
 		break;
 
 	case MEM_OFFLINE:
@@ -1760,7 +2057,7 @@ static int ksm_memory_callback(struct notifier_block *self,
 		/* fallthrough */
 
 	case MEM_CANCEL_OFFLINE:
-		mutex_unlock(&ksm_thread_mutex);
+		up_write(&ksm_thread_sem);
 		break;
 	}
 	return NOTIFY_OK;
@@ -1849,7 +2146,7 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 	 * on the list for when ksmd may be set running again).
 	 */
 
-	mutex_lock(&ksm_thread_mutex);
+	down_write(&ksm_thread_sem);
 	if (ksm_run != flags) {
 		ksm_run = flags;
 		if (flags & KSM_RUN_UNMERGE) {
@@ -1862,7 +2159,7 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 			}
 		}
 	}
-	mutex_unlock(&ksm_thread_mutex);
+	up_write(&ksm_thread_sem);
 
 	if (flags & KSM_RUN_MERGE)
 		wake_up_interruptible(&ksm_thread_wait);
@@ -1897,7 +2194,7 @@ static ssize_t pages_volatile_show(struct kobject *kobj,
 {
 	long ksm_pages_volatile;
 
-	ksm_pages_volatile = ksm_rmap_items - ksm_pages_shared
+	ksm_pages_volatile = atomic_long_read(&ksm_rmap_items) - ksm_pages_shared
 				- ksm_pages_sharing - ksm_pages_unshared;
 	/*
 	 * It was not worth any locking to calculate that statistic,
@@ -1912,10 +2209,154 @@ KSM_ATTR_RO(pages_volatile);
 static ssize_t full_scans_show(struct kobject *kobj,
 			       struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", ksm_scan.seqnr);
+	return sprintf(buf, "%lu\n", ksm_seqnr);
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t workers_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_nr_workers_wanted);
+}
+
+static ssize_t workers_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct task_struct *task;
+	unsigned long nr_workers;
+	int i, err;
+
+	err = strict_strtoul(buf, 10, &nr_workers);
+	if (err || !nr_workers || nr_workers > KSM_MAX_WORKERS)
+		return -EINVAL;
+
+	down_write(&ksm_thread_sem);
+	for (i = 0; i < nr_workers; i++) {
+		if (ksm_workers[i].task)
+			continue;
+		task = kthread_run(ksm_scan_thread, &ksm_workers[i],
+				   "ksmd/%d", i);
+		if (IS_ERR(task)) {
+			count = PTR_ERR(task);
+			goto out;
+		}
+		ksm_workers[i].task = task;
+	}
+
+	/*
+	 * The new number of workers takes effect with the next full scan;
+	 * or at once when none of them has started on the current one.
+	 */
+	ksm_nr_workers_wanted = nr_workers;
+	for (i = 0; i < KSM_MAX_WORKERS; i++) {
+		if (ksm_workers[i].scan.mm_slot != &ksm_mm_head)
+			break;
+	}
+	if (i == KSM_MAX_WORKERS && !ksm_workers_done)
+		ksm_start_full_scan();
+out:
+	up_write(&ksm_thread_sem);
+
+	wake_up_interruptible(&ksm_thread_wait);
+
+	return count;
+}
+KSM_ATTR(workers);
+
+static ssize_t smart_scan_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_smart_scan);
+}
+
+static ssize_t smart_scan_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long enable;
+	int err;
+
+	err = strict_strtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	ksm_smart_scan = enable;
+
+	return count;
+}
+KSM_ATTR(smart_scan);
+
+static ssize_t cpu_budget_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_cpu_budget);
+}
+
+static ssize_t cpu_budget_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long percent;
+	int err;
+
+	err = strict_strtoul(buf, 10, &percent);
+	if (err || percent > 100 * KSM_MAX_WORKERS)
+		return -EINVAL;
+
+	ksm_cpu_budget = percent;
+
+	return count;
+}
+KSM_ATTR(cpu_budget);
+
+static ssize_t pages_skipped_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	unsigned long pages_merged, pages_skipped;
+	u64 cpu_ns;
+
+	ksm_worker_stats(&cpu_ns, &pages_merged, &pages_skipped);
+	return sprintf(buf, "%lu\n", pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped);
+
+static ssize_t pages_merged_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	unsigned long pages_merged, pages_skipped;
+	u64 cpu_ns;
+
+	ksm_worker_stats(&cpu_ns, &pages_merged, &pages_skipped);
+	return sprintf(buf, "%lu\n", pages_merged);
+}
+KSM_ATTR_RO(pages_merged);
+
+static ssize_t cpu_msecs_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	unsigned long pages_merged, pages_skipped;
+	u64 cpu_ns;
+
+	ksm_worker_stats(&cpu_ns, &pages_merged, &pages_skipped);
+	return sprintf(buf, "%llu\n",
+		       (unsigned long long)div_u64(cpu_ns, NSEC_PER_MSEC));
+}
+KSM_ATTR_RO(cpu_msecs);
+
+static ssize_t merged_per_cpu_sec_show(struct kobject *kobj,
+				       struct kobj_attribute *attr, char *buf)
+{
+	unsigned long pages_merged, pages_skipped;
+	u64 cpu_ns, rate = 0;
+
+	ksm_worker_stats(&cpu_ns, &pages_merged, &pages_skipped);
+	if (cpu_ns)
+		rate = div64_u64((u64)pages_merged * NSEC_PER_SEC, cpu_ns);
+	return sprintf(buf, "%llu\n", (unsigned long long)rate);
+}
+KSM_ATTR_RO(merged_per_cpu_sec);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1925,6 +2366,13 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&workers_attr.attr,
+	&smart_scan_attr.attr,
+	&cpu_budget_attr.attr,
+	&pages_skipped_attr.attr,
+	&pages_merged_attr.attr,
+	&cpu_msecs_attr.attr,
+	&merged_per_cpu_sec_attr.attr,
 	NULL,
 };
 
@@ -1937,7 +2385,7 @@ static struct attribute_group ksm_attr_group = {
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
-	int err;
+	int i, err;
 
 	err = ksm_slab_init();
 	if (err)
@@ -1947,12 +2395,16 @@ static int __init ksm_init(void)
 	if (err)
 		goto out_free1;
 
-	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
+	for (i = 0; i < KSM_MAX_WORKERS; i++)
+		ksm_workers[i].id = i;
+
+	ksm_thread = kthread_run(ksm_scan_thread, &ksm_workers[0], "ksmd");
 	if (IS_ERR(ksm_thread)) {
 		printk(KERN_ERR "ksm: creating kthread failed\n");
 		err = PTR_ERR(ksm_thread);
 		goto out_free2;
 	}
+	ksm_workers[0].task = ksm_thread;
 
 #ifdef CONFIG_SYSFS
 	err = sysfs_create_group(mm_kobj, &ksm_attr_group);
@@ -1968,7 +2420,7 @@ static int __init ksm_init(void)
 
 #ifdef CONFIG_MEMORY_HOTREMOVE
 	/*
-	 * Choose a high priority since the callback takes ksm_thread_mutex:
+	 * Choose a high priority since the callback takes ksm_thread_sem:
 	 * later callbacks could only be taking locks which nest within that.
 	 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
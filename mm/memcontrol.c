@@ -336,7 +336,7 @@ enum charge_type {
 static void mem_cgroup_get(struct mem_cgroup *mem);
 static void mem_cgroup_put(struct mem_cgroup *mem);
 static struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *mem);
-static void drain_all_stock_async(void);
+static void drain_all_stock(struct mem_cgroup *root_mem, bool sync);
 
 static struct mem_cgroup_per_zone *
 mem_cgroup_zoneinfo(struct mem_cgroup *mem, int nid, int zid)
@@ -349,17 +349,54 @@ struct cgroup_subsys_state *mem_cgroup_css(struct mem_cgroup *mem)
 	return &mem->css;
 }
 
-static struct mem_cgroup_per_zone *
-page_cgroup_zoneinfo(struct page_cgroup *pc)
+/*
+ * A helper function to get mem_cgroup from ID. must be called under
+ * rcu_read_lock(). The caller must check css_is_removed() or some if
+ * it's concern. (dropping refcnt from swap can be called against removed
+ * memcg.)
+ */
+static struct mem_cgroup *mem_cgroup_lookup(unsigned short id)
 {
-	struct mem_cgroup *mem = pc->mem_cgroup;
-	int nid = page_cgroup_nid(pc);
-	int zid = page_cgroup_zid(pc);
+	struct cgroup_subsys_state *css;
+
+	/* ID 0 is unused ID */
+	if (!id)
+		return NULL;
+	css = css_lookup(&mem_cgroup_subsys, id);
+	if (!css)
+		return NULL;
+	return container_of(css, struct mem_cgroup, css);
+}
 
+/*
+ * The owner of a page_cgroup is stored as the css_id of its mem_cgroup.
+ * A used page_cgroup, or one accounted to its mem_cgroup's LRU, keeps
+ * the mem_cgroup and so its id alive: see mem_cgroup_force_empty().
+ */
+static struct mem_cgroup *pc_mem_cgroup(struct page_cgroup *pc)
+{
+	struct mem_cgroup *mem;
+
+	rcu_read_lock();
+	mem = mem_cgroup_lookup(page_cgroup_id(pc));
+	rcu_read_unlock();
+	return mem;
+}
+
+static void pc_set_mem_cgroup(struct page_cgroup *pc, struct mem_cgroup *mem)
+{
+	rcu_read_lock();
+	set_page_cgroup_id(pc, css_id(&mem->css));
+	rcu_read_unlock();
+}
+
+static struct mem_cgroup_per_zone *
+page_cgroup_zoneinfo(struct mem_cgroup *mem, struct page *page)
+{
 	if (!mem)
 		return NULL;
 
-	return mem_cgroup_zoneinfo(mem, nid, zid);
+	return mem_cgroup_zoneinfo(mem, page_to_nid(page), page_zonenum(page));
 }
 
 static struct mem_cgroup_tree_per_zone *
@@ -706,12 +743,31 @@ static inline bool mem_cgroup_is_root(struct mem_cgroup *mem)
  * It is added to LRU before charge.
  * If PCG_USED bit is not set, page_cgroup is not added to this private LRU.
  * When moving account, the page is not on LRU. It's isolated.
+ *
+ * There is a single LRU linkage, page->lru: a page accounted to a memcg
+ * other than the root is linked to that memcg's per-zone list, any other
+ * page to the zone's list.  The functions below do the accounting and
+ * return the list the caller links the page to, under zone->lru_lock.
  */
 
+static struct list_head *page_lru_head(struct zone *zone, struct page *page,
+				       struct page_cgroup *pc, enum lru_list lru)
+{
+	struct mem_cgroup *mem;
+
+	if (!PageCgroupAcctLRU(pc))
+		return &zone->lru[lru].list;
+	mem = pc_mem_cgroup(pc);
+	if (mem_cgroup_is_root(mem))
+		return &zone->lru[lru].list;
+	return &page_cgroup_zoneinfo(mem, page)->lists[lru];
+}
+
 void mem_cgroup_del_lru_list(struct page *page, enum lru_list lru)
 {
 	struct page_cgroup *pc;
 	struct mem_cgroup_per_zone *mz;
+	struct mem_cgroup *mem;
 
 	if (mem_cgroup_disabled())
 		return;
@@ -719,18 +775,14 @@ void mem_cgroup_del_lru_list(struct page *page, enum lru_list lru)
 	/* can happen while we handle swapcache. */
 	if (!TestClearPageCgroupAcctLRU(pc))
 		return;
-	VM_BUG_ON(!pc->mem_cgroup);
+	mem = pc_mem_cgroup(pc);
+	VM_BUG_ON(!mem);
 	/*
 	 * We don't check PCG_USED bit. It's cleared when the "page" is finally
 	 * removed from global LRU.
 	 */
-	mz = page_cgroup_zoneinfo(pc);
+	mz = page_cgroup_zoneinfo(mem, page);
 	MEM_CGROUP_ZSTAT(mz, lru) -= 1;
-	if (mem_cgroup_is_root(pc->mem_cgroup))
-		return;
-	VM_BUG_ON(list_empty(&pc->lru));
-	list_del_init(&pc->lru);
-	return;
 }
 
 void mem_cgroup_del_lru(struct page *page)
@@ -738,34 +790,25 @@ void mem_cgroup_del_lru(struct page *page)
 	mem_cgroup_del_lru_list(page, page_lru(page));
 }
 
-void mem_cgroup_rotate_lru_list(struct page *page, enum lru_list lru)
+/*
+ * The list a page on the LRU is linked to, for rotating it.
+ */
+struct list_head *mem_cgroup_lru_list(struct zone *zone, struct page *page,
+				      enum lru_list lru)
 {
-	struct mem_cgroup_per_zone *mz;
-	struct page_cgroup *pc;
-
 	if (mem_cgroup_disabled())
-		return;
-
-	pc = lookup_page_cgroup(page);
-	/*
-	 * Used bit is set without atomic ops but after smp_wmb().
-	 * For making pc->mem_cgroup visible, insert smp_rmb() here.
-	 */
-	smp_rmb();
-	/* unused or root page is not rotated. */
-	if (!PageCgroupUsed(pc) || mem_cgroup_is_root(pc->mem_cgroup))
-		return;
-	mz = page_cgroup_zoneinfo(pc);
-	list_move(&pc->lru, &mz->lists[lru]);
+		return &zone->lru[lru].list;
+	return page_lru_head(zone, page, lookup_page_cgroup(page), lru);
 }
 
-void mem_cgroup_add_lru_list(struct page *page, enum lru_list lru)
+struct list_head *mem_cgroup_add_lru_list(struct zone *zone, struct page *page,
+					  enum lru_list lru)
 {
 	struct page_cgroup *pc;
 	struct mem_cgroup_per_zone *mz;
 
 	if (mem_cgroup_disabled())
-		return;
+		return &zone->lru[lru].list;
 	pc = lookup_page_cgroup(page);
 	VM_BUG_ON(PageCgroupAcctLRU(pc));
 	/*
@@ -774,14 +817,12 @@ void mem_cgroup_add_lru_list(struct page *page, enum lru_list lru)
 	 */
 	smp_rmb();
 	if (!PageCgroupUsed(pc))
-		return;
+		return &zone->lru[lru].list;
 
-	mz = page_cgroup_zoneinfo(pc);
+	mz = page_cgroup_zoneinfo(pc_mem_cgroup(pc), page);
 	MEM_CGROUP_ZSTAT(mz, lru) += 1;
 	SetPageCgroupAcctLRU(pc);
-	if (mem_cgroup_is_root(pc->mem_cgroup))
-		return;
-	list_add(&pc->lru, &mz->lists[lru]);
+	return page_lru_head(zone, page, pc, lru);
 }
 
 /*
@@ -796,14 +837,19 @@ static void mem_cgroup_lru_del_before_commit_swapcache(struct page *page)
 	unsigned long flags;
 	struct zone *zone = page_zone(page);
 	struct page_cgroup *pc = lookup_page_cgroup(page);
+	enum lru_list lru;
 
 	spin_lock_irqsave(&zone->lru_lock, flags);
 	/*
 	 * Forget old LRU when this page_cgroup is *not* used. This Used bit
-	 * is guarded by lock_page() because the page is SwapCache.
+	 * is guarded by lock_page() because the page is SwapCache.  The page
+	 * waits on the zone's list until it is charged again.
 	 */
-	if (!PageCgroupUsed(pc))
-		mem_cgroup_del_lru_list(page, page_lru(page));
+	if (!PageCgroupUsed(pc) && PageCgroupAcctLRU(pc)) {
+		lru = page_lru(page);
+		mem_cgroup_del_lru_list(page, lru);
+		list_move(&page->lru, &zone->lru[lru].list);
+	}
 	spin_unlock_irqrestore(&zone->lru_lock, flags);
 }
 
@@ -816,18 +862,68 @@ static void mem_cgroup_lru_add_after_commit_swapcache(struct page *page)
 	spin_lock_irqsave(&zone->lru_lock, flags);
 	/* link when the page is linked to LRU but page_cgroup isn't */
 	if (PageLRU(page) && !PageCgroupAcctLRU(pc))
-		mem_cgroup_add_lru_list(page, page_lru(page));
+		list_move(&page->lru,
+			  mem_cgroup_add_lru_list(zone, page, page_lru(page)));
 	spin_unlock_irqrestore(&zone->lru_lock, flags);
 }
 
 
-void mem_cgroup_move_lists(struct page *page,
-			   enum lru_list from, enum lru_list to)
+struct list_head *mem_cgroup_move_lists(struct zone *zone, struct page *page,
+					enum lru_list from, enum lru_list to)
 {
 	if (mem_cgroup_disabled())
-		return;
+		return &zone->lru[to].list;
 	mem_cgroup_del_lru_list(page, from);
-	mem_cgroup_add_lru_list(page, to);
+	return mem_cgroup_add_lru_list(zone, page, to);
+}
+
+/*
+ * The pages of a zone's LRU list are spread over the zone's own list and
+ * the per-zone lists of all memcgs but the root.  Iterate over the latter:
+ * start with *@iter NULL, each call returns the next memcg's list and its
+ * size in @nr_pages, and NULL at the end.  A reference on the memcg is
+ * held in *@iter until the next call, or mem_cgroup_zone_lru_break() to
+ * stop before the end.
+ */
+struct list_head *mem_cgroup_zone_lru_next(struct zone *zone,
+		enum lru_list lru, struct mem_cgroup **iter,
+		unsigned long *nr_pages)
+{
+	struct mem_cgroup *prev = *iter, *mem = NULL;
+	struct cgroup_subsys_state *css;
+	struct mem_cgroup_per_zone *mz;
+	int id, found;
+
+	if (mem_cgroup_disabled())
+		return NULL;
+
+	rcu_read_lock();
+	id = prev ? css_id(&prev->css) + 1 : 1;
+	while ((css = css_get_next(&mem_cgroup_subsys, id,
+				   &root_mem_cgroup->css, &found))) {
+		id = found + 1;
+		mem = container_of(css, struct mem_cgroup, css);
+		if (!mem_cgroup_is_root(mem) && css_tryget(css))
+			break;
+		mem = NULL;
+	}
+	rcu_read_unlock();
+
+	if (prev)
+		css_put(&prev->css);
+	*iter = mem;
+	if (!mem)
+		return NULL;
+
+	mz = mem_cgroup_zoneinfo(mem, zone_to_nid(zone), zone_idx(zone));
+	*nr_pages = MEM_CGROUP_ZSTAT(mz, lru);
+	return &mz->lists[lru];
+}
+
+void mem_cgroup_zone_lru_break(struct mem_cgroup *iter)
+{
+	if (iter)
+		css_put(&iter->css);
 }
 
 int task_in_mem_cgroup(struct task_struct *task, const struct mem_cgroup *mem)
@@ -977,7 +1073,7 @@ mem_cgroup_get_reclaim_stat_from_page(struct page *page)
 	if (!PageCgroupUsed(pc))
 		return NULL;
 
-	mz = page_cgroup_zoneinfo(pc);
+	mz = page_cgroup_zoneinfo(pc_mem_cgroup(pc), page);
 	if (!mz)
 		return NULL;
 
@@ -992,11 +1088,10 @@ unsigned long mem_cgroup_isolate_pages(unsigned long nr_to_scan,
 					int active, int file)
 {
 	unsigned long nr_taken = 0;
-	struct page *page;
+	struct page *page, *tmp;
 	unsigned long scan;
-	LIST_HEAD(pc_list);
 	struct list_head *src;
-	struct page_cgroup *pc, *tmp;
+	struct page_cgroup *pc;
 	int nid = z->zone_pgdat->node_id;
 	int zid = zone_idx(z);
 	struct mem_cgroup_per_zone *mz;
@@ -1008,11 +1103,11 @@ unsigned long mem_cgroup_isolate_pages(unsigned long nr_to_scan,
 	src = &mz->lists[lru];
 
 	scan = 0;
-	list_for_each_entry_safe_reverse(pc, tmp, src, lru) {
+	list_for_each_entry_safe_reverse(page, tmp, src, lru) {
 		if (scan >= nr_to_scan)
 			break;
 
-		page = pc->page;
+		pc = lookup_page_cgroup(page);
 		if (unlikely(!PageCgroupUsed(pc)))
 			continue;
 		if (unlikely(!PageLRU(page)))
@@ -1027,8 +1122,8 @@ unsigned long mem_cgroup_isolate_pages(unsigned long nr_to_scan,
 			nr_taken++;
 			break;
 		case -EBUSY:
-			/* we don't affect global LRU but rotate in our LRU */
-			mem_cgroup_rotate_lru_list(page, page_lru(page));
+			/* rotate in our LRU, which is the page's only LRU */
+			list_move(&page->lru, src);
 			break;
 		default:
 			break;
@@ -1228,7 +1323,7 @@ static int mem_cgroup_hierarchical_reclaim(struct mem_cgroup *root_mem,
 		if (victim == root_mem) {
 			loop++;
 			if (loop >= 1)
-				drain_all_stock_async();
+				drain_all_stock(root_mem, false);
 			if (loop >= 2) {
 				/*
 				 * If we have not been able to reclaim
@@ -1434,7 +1529,7 @@ void mem_cgroup_update_file_mapped(struct page *page, int val)
 		return;
 
 	lock_page_cgroup(pc);
-	mem = pc->mem_cgroup;
+	mem = pc_mem_cgroup(pc);
 	if (!mem || !PageCgroupUsed(pc))
 		goto done;
 
@@ -1456,15 +1551,20 @@ done:
 /*
  * size of first charge trial. "32" comes from vmscan.c's magic value.
  * TODO: maybe necessary to use big numbers in big irons.
+ *
+ * Each cpu keeps what is left of such a batch in a local stock, so that
+ * most charges and uncharges never touch the shared res_counters.  The
+ * stock never grows beyond one batch: what does not fit is returned.
  */
 #define CHARGE_SIZE	(32 * PAGE_SIZE)
 struct memcg_stock_pcp {
 	struct mem_cgroup *cached; /* this never be root cgroup */
 	int charge;
 	struct work_struct work;
+	unsigned long flags;
+#define FLUSHING_CACHED_CHARGE	(0)
 };
 static DEFINE_PER_CPU(struct memcg_stock_pcp, memcg_stock);
-static atomic_t memcg_drain_count;
 
 /*
  * Try to consume stocked charge on this cpu. If success, PAGE_SIZE is consumed
@@ -1510,6 +1610,7 @@ static void drain_local_stock(struct work_struct *dummy)
 {
 	struct memcg_stock_pcp *stock = &__get_cpu_var(memcg_stock);
 	drain_stock(stock);
+	clear_bit(FLUSHING_CACHED_CHARGE, &stock->flags);
 }
 
 /*
@@ -1529,41 +1630,84 @@ static void refill_stock(struct mem_cgroup *mem, int val)
 }
 
 /*
- * Tries to drain stocked charges in other cpus. This function is asynchronous
- * and just put a work per cpu for draining localy on each cpu. Caller can
- * expects some charges will be back to res_counter later but cannot wait for
- * it.
+ * Give an uncharge of PAGE_SIZE back to the local stock instead of the
+ * res_counter, if this cpu is stocking charges of @mem anyway and the stock
+ * has room for it.  Returns false if the caller must uncharge by itself.
+ * Charges are only ever stocked from process context, so uncharges from
+ * interrupts are not allowed to touch the stock.
  */
-static void drain_all_stock_async(void)
+static bool uncharge_stock(struct mem_cgroup *mem)
 {
-	int cpu;
-	/* This function is for scheduling "drain" in asynchronous way.
-	 * The result of "drain" is not directly handled by callers. Then,
-	 * if someone is calling drain, we don't have to call drain more.
-	 * Anyway, WORK_STRUCT_PENDING check in queue_work_on() will catch if
-	 * there is a race. We just do loose check here.
-	 */
-	if (atomic_read(&memcg_drain_count))
-		return;
-	/* Notify other cpus that system-wide "drain" is running */
-	atomic_inc(&memcg_drain_count);
+	struct memcg_stock_pcp *stock;
+	bool ret = false;
+
+	if (in_interrupt())
+		return false;
+
+	stock = &get_cpu_var(memcg_stock);
+	if (mem == stock->cached && stock->charge < CHARGE_SIZE) {
+		stock->charge += PAGE_SIZE;
+		ret = true;
+	}
+	put_cpu_var(memcg_stock);
+	return ret;
+}
+
+/*
+ * Drain the stocks holding charges of @root_mem or of any cgroup below it in
+ * the hierarchy.  This cpu's stock is drained directly, the others by a work
+ * item on their cpu; stocks caching unrelated cgroups are left alone, so
+ * that limit pressure in one cgroup does not disturb the others.  With @sync,
+ * wait for the remote drains to finish (not from reclaim context: the work
+ * items run on keventd).
+ */
+static void drain_all_stock(struct mem_cgroup *root_mem, bool sync)
+{
+	int cpu, curcpu;
+
 	get_online_cpus();
+	curcpu = get_cpu();
 	for_each_online_cpu(cpu) {
 		struct memcg_stock_pcp *stock = &per_cpu(memcg_stock, cpu);
-		schedule_work_on(cpu, &stock->work);
+		struct mem_cgroup *mem;
+
+		/*
+		 * Racy: the stock may change under us, but a cgroup is only
+		 * freed after it drained all stocks itself (force_empty).
+		 */
+		mem = stock->cached;
+		if (!mem || !stock->charge)
+			continue;
+		if (mem != root_mem) {
+			bool below;
+
+			if (!root_mem->use_hierarchy)
+				continue;
+			rcu_read_lock();
+			below = css_is_ancestor(&mem->css, &root_mem->css);
+			rcu_read_unlock();
+			if (!below)
+				continue;
+		}
+		/* a drain is already pending there */
+		if (test_and_set_bit(FLUSHING_CACHED_CHARGE, &stock->flags))
+			continue;
+		if (cpu == curcpu)
+			drain_local_stock(&stock->work);
+		else
+			schedule_work_on(cpu, &stock->work);
 	}
- 	put_online_cpus();
-	atomic_dec(&memcg_drain_count);
-	/* We don't wait for flush_work */
-}
+	put_cpu();
 
-/* This is a synchronous drain interface. */
-static void drain_all_stock_sync(void)
-{
-	/* called when force_empty is called */
-	atomic_inc(&memcg_drain_count);
-	schedule_on_each_cpu(drain_local_stock);
-	atomic_dec(&memcg_drain_count);
+	if (sync) {
+		for_each_online_cpu(cpu) {
+			struct memcg_stock_pcp *stock = &per_cpu(memcg_stock, cpu);
+
+			if (test_bit(FLUSHING_CACHED_CHARGE, &stock->flags))
+				flush_work(&stock->work);
+		}
+	}
+	put_online_cpus();
 }
 
 static int __cpuinit memcg_stock_cpu_callback(struct notifier_block *nb,
@@ -1573,10 +1717,11 @@ static int __cpuinit memcg_stock_cpu_callback(struct notifier_block *nb,
 	int cpu = (unsigned long)hcpu;
 	struct memcg_stock_pcp *stock;
 
-	if (action != CPU_DEAD)
+	if (action != CPU_DEAD && action != CPU_DEAD_FROZEN)
 		return NOTIFY_OK;
 	stock = &per_cpu(memcg_stock, cpu);
 	drain_stock(stock);
+	clear_bit(FLUSHING_CACHED_CHARGE, &stock->flags);
 	return NOTIFY_OK;
 }
 
@@ -1591,6 +1736,7 @@ static int __mem_cgroup_try_charge(struct mm_struct *mm,
 	int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
 	struct res_counter *fail_res;
 	int csize = CHARGE_SIZE;
+	bool drained = false;
 
 	/*
 	 * Unlike gloval-vm's OOM-kill, we're not in memory shortage
@@ -1653,6 +1799,18 @@ static int __mem_cgroup_try_charge(struct mm_struct *mm,
 		if (!(gfp_mask & __GFP_WAIT))
 			goto nomem;
 
+		/*
+		 * Charges sitting in the per-cpu stocks of the hierarchy
+		 * count against the limit: give them back before reclaiming.
+		 * Our own stock is returned right away, the others shortly.
+		 * Not for atomic charges: drain_all_stock() may sleep.
+		 */
+		if (!drained) {
+			drain_all_stock(mem_over_limit, false);
+			drained = true;
+			continue;
+		}
+
 		ret = mem_cgroup_hierarchical_reclaim(mem_over_limit, NULL,
 						gfp_mask, flags);
 		if (ret)
@@ -1757,24 +1915,6 @@ static void mem_cgroup_cancel_charge(struct mem_cgroup *mem)
 	__mem_cgroup_cancel_charge(mem, 1);
 }
 
-/*
- * A helper function to get mem_cgroup from ID. must be called under
- * rcu_read_lock(). The caller must check css_is_removed() or some if
- * it's concern. (dropping refcnt from swap can be called against removed
- * memcg.)
- */
-static struct mem_cgroup *mem_cgroup_lookup(unsigned short id)
-{
-	struct cgroup_subsys_state *css;
-
-	/* ID 0 is unused ID */
-	if (!id)
-		return NULL;
-	css = css_lookup(&mem_cgroup_subsys, id);
-	if (!css)
-		return NULL;
-	return container_of(css, struct mem_cgroup, css);
-}
 
 struct mem_cgroup *try_get_mem_cgroup_from_page(struct page *page)
 {
@@ -1788,7 +1928,7 @@ struct mem_cgroup *try_get_mem_cgroup_from_page(struct page *page)
 	pc = lookup_page_cgroup(page);
 	lock_page_cgroup(pc);
 	if (PageCgroupUsed(pc)) {
-		mem = pc->mem_cgroup;
+		mem = pc_mem_cgroup(pc);
 		if (mem && !css_tryget(&mem->css))
 			mem = NULL;
 	} else if (PageSwapCache(page)) {
@@ -1824,7 +1964,7 @@ static void __mem_cgroup_commit_charge(struct mem_cgroup *mem,
 		return;
 	}
 
-	pc->mem_cgroup = mem;
+	pc_set_mem_cgroup(pc, mem);
 	/*
 	 * We access a page_cgroup asynchronously without lock_page_cgroup().
 	 * Especially when a page_cgroup is taken from a page, pc->mem_cgroup
@@ -1855,7 +1995,7 @@ static void __mem_cgroup_commit_charge(struct mem_cgroup *mem,
 	 * Insert ancestor (and ancestor's ancestors), to softlimit RB-tree.
 	 * if they exceeds softlimit.
 	 */
-	memcg_check_events(mem, pc->page);
+	memcg_check_events(mem, lookup_cgroup_page(pc));
 }
 
 /**
@@ -1879,10 +2019,10 @@ static void __mem_cgroup_move_account(struct page_cgroup *pc,
 	struct mem_cgroup *from, struct mem_cgroup *to, bool uncharge)
 {
 	VM_BUG_ON(from == to);
-	VM_BUG_ON(PageLRU(pc->page));
+	VM_BUG_ON(PageLRU(lookup_cgroup_page(pc)));
 	VM_BUG_ON(!PageCgroupLocked(pc));
 	VM_BUG_ON(!PageCgroupUsed(pc));
-	VM_BUG_ON(pc->mem_cgroup != from);
+	VM_BUG_ON(pc_mem_cgroup(pc) != from);
 
 	if (PageCgroupFileMapped(pc)) {
 		/* Update mapped_file data for mem_cgroup */
@@ -1897,7 +2037,7 @@ static void __mem_cgroup_move_account(struct page_cgroup *pc,
 		mem_cgroup_cancel_charge(from);
 
 	/* caller should have done css_get */
-	pc->mem_cgroup = to;
+	pc_set_mem_cgroup(pc, to);
 	mem_cgroup_charge_statistics(to, pc, true);
 	/*
 	 * We charges against "to" which may not have any tasks. Then, "to"
@@ -1915,9 +2055,11 @@ static void __mem_cgroup_move_account(struct page_cgroup *pc,
 static int mem_cgroup_move_account(struct page_cgroup *pc,
 		struct mem_cgroup *from, struct mem_cgroup *to, bool uncharge)
 {
+	struct page *page;
 	int ret = -EINVAL;
+
 	lock_page_cgroup(pc);
-	if (PageCgroupUsed(pc) && pc->mem_cgroup == from) {
+	if (PageCgroupUsed(pc) && pc_mem_cgroup(pc) == from) {
 		__mem_cgroup_move_account(pc, from, to, uncharge);
 		ret = 0;
 	}
@@ -1925,8 +2067,9 @@ static int mem_cgroup_move_account(struct page_cgroup *pc,
 	/*
 	 * check events
 	 */
-	memcg_check_events(to, pc->page);
-	memcg_check_events(from, pc->page);
+	page = lookup_cgroup_page(pc);
+	memcg_check_events(to, page);
+	memcg_check_events(from, page);
 	return ret;
 }
 
@@ -1938,7 +2081,7 @@ static int mem_cgroup_move_parent(struct page_cgroup *pc,
 				  struct mem_cgroup *child,
 				  gfp_t gfp_mask)
 {
-	struct page *page = pc->page;
+	struct page *page = lookup_cgroup_page(pc);
 	struct cgroup *cg = child->css.cgroup;
 	struct cgroup *pcg = cg->parent;
 	struct mem_cgroup *parent;
@@ -2227,6 +2370,14 @@ __do_uncharge(struct mem_cgroup *mem, const enum charge_type ctype)
 		batch->memsw_bytes += PAGE_SIZE;
 	return;
 direct_uncharge:
+	/*
+	 * The stock holds memory and memory+swap charges alike; under OOM
+	 * the charge is needed back in the res_counter to wake up waiters.
+	 */
+	if (uncharge_memsw == do_swap_account &&
+	    !test_thread_flag(TIF_MEMDIE) && !atomic_read(&mem->oom_lock) &&
+	    uncharge_stock(mem))
+		return;
 	res_counter_uncharge(&mem->res, PAGE_SIZE);
 	if (uncharge_memsw)
 		res_counter_uncharge(&mem->memsw, PAGE_SIZE);
@@ -2260,7 +2411,7 @@ __mem_cgroup_uncharge_common(struct page *page, enum charge_type ctype)
 
 	lock_page_cgroup(pc);
 
-	mem = pc->mem_cgroup;
+	mem = pc_mem_cgroup(pc);
 
 	if (!PageCgroupUsed(pc))
 		goto unlock_out;
@@ -2291,13 +2442,13 @@ __mem_cgroup_uncharge_common(struct page *page, enum charge_type ctype)
 
 	ClearPageCgroupUsed(pc);
 	/*
-	 * pc->mem_cgroup is not cleared here. It will be accessed when it's
+	 * The owner id is not cleared here. It will be accessed when it's
 	 * freed from LRU. This is safe because uncharged page is expected not
 	 * to be reused (freed soon). Exception is SwapCache, it's handled by
 	 * special functions.
 	 */
 
-	mz = page_cgroup_zoneinfo(pc);
+	mz = page_cgroup_zoneinfo(mem, page);
 	unlock_page_cgroup(pc);
 
 	memcg_check_events(mem, page);
@@ -2506,7 +2657,7 @@ int mem_cgroup_prepare_migration(struct page *page,
 	pc = lookup_page_cgroup(page);
 	lock_page_cgroup(pc);
 	if (PageCgroupUsed(pc)) {
-		mem = pc->mem_cgroup;
+		mem = pc_mem_cgroup(pc);
 		css_get(&mem->css);
 		/*
 		 * At migrating an anonymous page, its mapcount goes down
@@ -2888,7 +3039,7 @@ static int mem_cgroup_force_empty_list(struct mem_cgroup *mem,
 {
 	struct zone *zone;
 	struct mem_cgroup_per_zone *mz;
-	struct page_cgroup *pc, *busy;
+	struct page *page, *busy;
 	unsigned long flags, loop;
 	struct list_head *list;
 	int ret = 0;
@@ -2908,22 +3059,23 @@ static int mem_cgroup_force_empty_list(struct mem_cgroup *mem,
 			spin_unlock_irqrestore(&zone->lru_lock, flags);
 			break;
 		}
-		pc = list_entry(list->prev, struct page_cgroup, lru);
-		if (busy == pc) {
-			list_move(&pc->lru, list);
+		page = list_entry(list->prev, struct page, lru);
+		if (busy == page) {
+			list_move(&page->lru, list);
 			busy = NULL;
 			spin_unlock_irqrestore(&zone->lru_lock, flags);
 			continue;
 		}
 		spin_unlock_irqrestore(&zone->lru_lock, flags);
 
-		ret = mem_cgroup_move_parent(pc, mem, GFP_KERNEL);
+		ret = mem_cgroup_move_parent(lookup_page_cgroup(page), mem,
+					     GFP_KERNEL);
 		if (ret == -ENOMEM)
 			break;
 
 		if (ret == -EBUSY || ret == -EINVAL) {
-			/* found lock contention or "pc" is obsolete. */
-			busy = pc;
+			/* found lock contention or "page" is obsolete. */
+			busy = page;
 			cond_resched();
 		} else
 			busy = NULL;
@@ -2961,7 +3113,7 @@ move_account:
 			goto out;
 		/* This is for making all *used* pages to be on LRU. */
 		lru_add_drain_all();
-		drain_all_stock_sync();
+		drain_all_stock(mem, true);
 		ret = 0;
 		for_each_node_state(node, N_HIGH_MEMORY) {
 			for (zid = 0; !ret && zid < MAX_NR_ZONES; zid++) {
@@ -4349,7 +4501,7 @@ static int is_target_pte_for_mc(struct vm_area_struct *vma,
 		 * mem_cgroup_move_account() checks the pc is valid or not under
 		 * the lock.
 		 */
-		if (PageCgroupUsed(pc) && pc->mem_cgroup == mc.from) {
+		if (PageCgroupUsed(pc) && pc_mem_cgroup(pc) == mc.from) {
 			ret = MC_TARGET_PAGE;
 			if (target)
 				target->page = page;
@@ -75,6 +75,22 @@ EXPORT_SYMBOL(node_states);
 unsigned long totalram_pages __read_mostly;
 unsigned long totalreserve_pages __read_mostly;
 int percpu_pagelist_fraction;
+
+/*
+ * Highest order cached on the per-cpu lists; "pcp_high_order=0" on the
+ * command line restores the order-0 only behaviour.
+ */
+static int pcp_max_high_order __read_mostly = PCP_MAX_HIGH_ORDER;
+
+static int __init setup_pcp_high_order(char *str)
+{
+	int order;
+
+	if (get_option(&str, &order))
+		pcp_max_high_order = clamp(order, 0, PCP_MAX_HIGH_ORDER);
+	return 0;
+}
+early_param("pcp_high_order", setup_pcp_high_order);
 gfp_t gfp_allowed_mask __read_mostly = GFP_BOOT_MASK;
 
 #ifdef CONFIG_PM_SLEEP
@@ -588,6 +604,48 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Frees at least count base pages from the high-order PCP lists, taking
+ * from each order and migratetype in turn.
+ */
+static void free_pcppages_high_order_bulk(struct zone *zone, int count,
+					struct per_cpu_pages *pcp)
+{
+	const int nr_lists = PCP_MAX_HIGH_ORDER * MIGRATE_PCPTYPES;
+	int idx = 0, nr_empty = 0, freed = 0;
+
+	if (count <= 0)
+		return;
+
+	spin_lock(&zone->lock);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	while (freed < count && nr_empty < nr_lists) {
+		int order = idx / MIGRATE_PCPTYPES + 1;
+		struct list_head *list;
+		struct page *page;
+
+		list = &pcp->high_order_lists[order - 1][idx % MIGRATE_PCPTYPES];
+		if (++idx == nr_lists)
+			idx = 0;
+		if (list_empty(list)) {
+			nr_empty++;
+			continue;
+		}
+		nr_empty = 0;
+
+		page = list_entry(list->prev, struct page, lru);
+		list_del(&page->lru);
+		__free_one_page(page, zone, order, page_private(page));
+		trace_mm_page_pcpu_drain(page, order, page_private(page));
+		freed += 1 << order;
+	}
+	__mod_zone_page_state(zone, NR_FREE_PAGES, freed);
+	pcp->high_order_count -= freed;
+	spin_unlock(&zone->lock);
+}
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -600,6 +658,39 @@ static void free_one_page(struct zone *zone, struct page *page, int order,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Put a small high-order page on this CPU's pcp lists.  Called with
+ * interrupts disabled.
+ */
+static void free_high_order_pcp_page(struct page *page, unsigned int order)
+{
+	struct zone *zone = page_zone(page);
+	struct per_cpu_pages *pcp;
+	int migratetype;
+
+	/* A cached page must not look compound to the next allocation */
+	if (unlikely(PageCompound(page)))
+		if (unlikely(destroy_compound_page(page, order)))
+			return;
+
+	/* As in free_hot_cold_page(), see there */
+	migratetype = get_pageblock_migratetype(page);
+	if (migratetype >= MIGRATE_PCPTYPES) {
+		if (unlikely(migratetype == MIGRATE_ISOLATE)) {
+			free_one_page(zone, page, order, migratetype);
+			return;
+		}
+		migratetype = MIGRATE_MOVABLE;
+	}
+	set_page_private(page, migratetype);
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list_add(&page->lru, &pcp->high_order_lists[order - 1][migratetype]);
+	pcp->high_order_count += 1 << order;
+	if (pcp->high_order_count >= pcp->high_order_high)
+		free_pcppages_high_order_bulk(zone, pcp->batch, pcp);
+}
+
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
@@ -627,7 +718,10 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
+	if (order <= pcp_max_high_order)
+		free_high_order_pcp_page(page, order);
+	else
+		free_one_page(page_zone(page), page, order,
 					get_pageblock_migratetype(page));
 	local_irq_restore(flags);
 }
@@ -1014,6 +1108,8 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 		to_drain = pcp->count;
 	free_pcppages_bulk(zone, to_drain, pcp);
 	pcp->count -= to_drain;
+	if (pcp->high_order_count)
+		free_pcppages_high_order_bulk(zone, pcp->batch, pcp);
 	local_irq_restore(flags);
 }
 #endif
@@ -1040,10 +1136,34 @@ static void drain_pages(unsigned int cpu)
 		pcp = &pset->pcp;
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		pcp->count = 0;
+		free_pcppages_high_order_bulk(zone, pcp->high_order_count, pcp);
 		local_irq_restore(flags);
 	}
 }
 
+/*
+ * The pages on the high-order pcp lists are neither in NR_FREE_PAGES nor
+ * in the free_area counts zone_watermark_ok() goes by.  Give this CPU's
+ * back to the buddy lists before failing a high-order allocation on the
+ * watermarks; the other CPUs' are drained after direct reclaim.
+ * Returns 1 if there were any.
+ */
+static int drain_local_high_order_pages(struct zone *zone)
+{
+	struct per_cpu_pages *pcp;
+	unsigned long flags;
+	int drained = 0;
+
+	local_irq_save(flags);
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	if (pcp->high_order_count) {
+		free_pcppages_high_order_bulk(zone, pcp->high_order_count, pcp);
+		drained = 1;
+	}
+	local_irq_restore(flags);
+	return drained;
+}
+
 /*
  * Spill all of this CPU's per-cpu pages back into the buddy allocator.
  */
@@ -1225,6 +1345,29 @@ again:
 
 		list_del(&page->lru);
 		pcp->count--;
+	} else if (order <= pcp_max_high_order) {
+		struct per_cpu_pages *pcp;
+		struct list_head *list;
+
+		local_irq_save(flags);
+		pcp = &this_cpu_ptr(zone->pageset)->pcp;
+		list = &pcp->high_order_lists[order - 1][migratetype];
+		if (list_empty(list)) {
+			int refill = max(1, pcp->batch >> order);
+
+			pcp->high_order_count += rmqueue_bulk(zone, order,
+					refill, list, migratetype, cold) << order;
+			if (unlikely(list_empty(list)))
+				goto failed;
+		}
+
+		if (cold)
+			page = list_entry(list->prev, struct page, lru);
+		else
+			page = list_entry(list->next, struct page, lru);
+
+		list_del(&page->lru);
+		pcp->high_order_count -= 1 << order;
 	} else {
 		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
 			/*
@@ -1563,6 +1706,12 @@ zonelist_scan:
 				    classzone_idx, alloc_flags))
 				goto try_this_zone;
 
+			if (order && order <= pcp_max_high_order &&
+			    drain_local_high_order_pages(zone) &&
+			    zone_watermark_ok(zone, order, mark,
+				    classzone_idx, alloc_flags))
+				goto try_this_zone;
+
 			if (zone_reclaim_mode == 0)
 				goto this_zone_full;
 
@@ -2197,9 +2346,10 @@ void show_free_areas(void)
 
 			pageset = per_cpu_ptr(zone->pageset, cpu);
 
-			printk("CPU %4d: hi:%5d, btch:%4d usd:%4d\n",
+			printk("CPU %4d: hi:%5d, btch:%4d usd:%4d ho:%4d\n",
 			       cpu, pageset->pcp.high,
-			       pageset->pcp.batch, pageset->pcp.count);
+			       pageset->pcp.batch, pageset->pcp.count,
+			       pageset->pcp.high_order_count);
 		}
 	}
 
@@ -3132,7 +3282,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
-	int migratetype;
+	int migratetype, order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3142,6 +3292,13 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+
+	pcp->high_order_count = 0;
+	pcp->high_order_high = pcp->high / 2;
+	for (order = 0; order < PCP_MAX_HIGH_ORDER; order++)
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+		     migratetype++)
+			INIT_LIST_HEAD(&pcp->high_order_lists[order][migratetype]);
 }
 
 /*
@@ -3159,6 +3316,7 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+	pcp->high_order_high = high / 2;
 }
 
 /*
@@ -3246,6 +3404,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		free_pcppages_high_order_bulk(zone, pcp->high_order_count, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -4519,6 +4678,7 @@ static int page_alloc_cpu_notify(struct notifier_block *self,
 	int cpu = (unsigned long)hcpu;
 
 	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN) {
+		lru_add_drain_cpu(cpu);
 		drain_pages(cpu);
 
 		/*
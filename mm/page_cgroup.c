@@ -11,15 +11,41 @@
 #include <linux/swapops.h>
 
 static void __meminit
-__init_page_cgroup(struct page_cgroup *pc, unsigned long pfn)
+__init_page_cgroup(struct page_cgroup *pc, unsigned long array_id)
 {
 	pc->flags = 0;
-	pc->mem_cgroup = NULL;
-	pc->page = pfn_to_page(pfn);
-	INIT_LIST_HEAD(&pc->lru);
+	set_page_cgroup_array_id(pc, array_id);
+	set_page_cgroup_id(pc, 0);
 }
 static unsigned long total_usage;
 
+/*
+ * What the page_cgroups would have cost with the former layout: flags,
+ * mem_cgroup and page pointers and an LRU list_head.
+ */
+struct page_cgroup_old {
+	unsigned long flags;
+	void *mem_cgroup;
+	struct page *page;
+	struct list_head lru;
+};
+
+static void __init page_cgroup_report_usage(void)
+{
+	unsigned long old_usage;
+
+	BUILD_BUG_ON(NR_PCG_FLAGS > PCG_ID_SHIFT);
+	BUILD_BUG_ON(PCG_ARRAYID_SHIFT + PCG_ARRAYID_WIDTH > BITS_PER_LONG);
+
+	old_usage = total_usage / sizeof(struct page_cgroup) *
+		sizeof(struct page_cgroup_old);
+	printk(KERN_INFO "allocated %ld bytes of page_cgroup\n", total_usage);
+	printk(KERN_INFO "page_cgroup: %zu bytes per page, %lu bytes saved "
+	       "against %zu bytes per page with page and LRU pointers\n",
+	       sizeof(struct page_cgroup), old_usage - total_usage,
+	       sizeof(struct page_cgroup_old));
+}
+
 #if !defined(CONFIG_SPARSEMEM)
 
 
@@ -42,13 +68,20 @@ struct page_cgroup *lookup_page_cgroup(struct page *page)
 	return base + offset;
 }
 
+struct page *lookup_cgroup_page(struct page_cgroup *pc)
+{
+	struct pglist_data *pgdat = NODE_DATA(page_cgroup_array_id(pc));
+
+	return pfn_to_page(pc - pgdat->node_page_cgroup +
+			   pgdat->node_start_pfn);
+}
+
 static int __init alloc_node_page_cgroup(int nid)
 {
 	struct page_cgroup *base, *pc;
 	unsigned long table_size;
-	unsigned long start_pfn, nr_pages, index;
+	unsigned long nr_pages, index;
 
-	start_pfn = NODE_DATA(nid)->node_start_pfn;
 	nr_pages = NODE_DATA(nid)->node_spanned_pages;
 
 	if (!nr_pages)
@@ -62,7 +95,7 @@ static int __init alloc_node_page_cgroup(int nid)
 		return -ENOMEM;
 	for (index = 0; index < nr_pages; index++) {
 		pc = base + index;
-		__init_page_cgroup(pc, start_pfn + index);
+		__init_page_cgroup(pc, nid);
 	}
 	NODE_DATA(nid)->node_page_cgroup = base;
 	total_usage += table_size;
@@ -82,7 +115,7 @@ void __init page_cgroup_init_flatmem(void)
 		if (fail)
 			goto fail;
 	}
-	printk(KERN_INFO "allocated %ld bytes of page_cgroup\n", total_usage);
+	page_cgroup_report_usage();
 	printk(KERN_INFO "please try 'cgroup_disable=memory' option if you"
 	" don't want memory cgroups\n");
 	return;
@@ -104,6 +137,14 @@ struct page_cgroup *lookup_page_cgroup(struct page *page)
 	return section->page_cgroup + pfn;
 }
 
+struct page *lookup_cgroup_page(struct page_cgroup *pc)
+{
+	struct mem_section *section;
+
+	section = __nr_to_section(page_cgroup_array_id(pc));
+	return pfn_to_page(pc - section->page_cgroup);
+}
+
 /* __alloc_bootmem...() is protected by !slab_available() */
 static int __init_refok init_section_page_cgroup(unsigned long pfn)
 {
@@ -128,15 +169,10 @@ static int __init_refok init_section_page_cgroup(unsigned long pfn)
 		}
 	} else {
 		/*
- 		 * We don't have to allocate page_cgroup again, but
-		 * address of memmap may be changed. So, we have to initialize
-		 * again.
+		 * We don't have to allocate page_cgroup again, and as it
+		 * doesn't point to the memmap, there is nothing to update.
 		 */
-		base = section->page_cgroup + pfn;
-		table_size = 0;
-		/* check address of memmap is changed or not. */
-		if (base->page == pfn_to_page(pfn))
-			return 0;
+		return 0;
 	}
 
 	if (!base) {
@@ -146,7 +182,7 @@ static int __init_refok init_section_page_cgroup(unsigned long pfn)
 
 	for (index = 0; index < PAGES_PER_SECTION; index++) {
 		pc = base + index;
-		__init_page_cgroup(pc, pfn + index);
+		__init_page_cgroup(pc, pfn_to_section_nr(pfn));
 	}
 
 	section->page_cgroup = base - pfn;
@@ -265,7 +301,7 @@ void __init page_cgroup_init(void)
 	} else {
 		hotplug_memory_notifier(page_cgroup_callback, 0);
 	}
-	printk(KERN_INFO "allocated %ld bytes of page_cgroup\n", total_usage);
+	page_cgroup_report_usage();
 	printk(KERN_INFO "please try 'cgroup_disable=memory' option if you don't"
 	" want memory cgroups\n");
 }
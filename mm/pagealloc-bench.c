@@ -0,0 +1,124 @@
+/*
+ * mm/pagealloc-bench.c
+ *
+ * Page allocator microbenchmark.  On load, one thread per online CPU
+ * allocates and frees bursts of pages of each order from 0 up to
+ * max_order concurrently, and the average cost of an alloc/free pair
+ * is reported for each order.  This mimics fork-heavy (order-1 stacks)
+ * and slab refill (order-2/3) patterns hitting zone->lock.
+ *
+ * Boot with "pcp_high_order=0" to measure without the high-order
+ * per-cpu lists.  Each load runs the benchmark once and then fails.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/cpu.h>
+#include <linux/bench.h>
+#include <linux/timex.h>
+#include <linux/math64.h>
+
+#define BENCH_BURST	16
+
+static int nr_loops = 100000;
+module_param(nr_loops, int, 0444);
+MODULE_PARM_DESC(nr_loops, "Pages allocated and freed per CPU and order");
+
+static int max_order = PCP_MAX_HIGH_ORDER;
+module_param(max_order, int, 0444);
+MODULE_PARM_DESC(max_order, "Highest order to benchmark");
+
+struct bench_cpu {
+	unsigned int order;
+	cycles_t cycles;
+	unsigned long failed;
+};
+
+static void pagealloc_bench_cpu(int cpu, void *data)
+{
+	struct bench_cpu *bc = (struct bench_cpu *)data + cpu;
+	struct page *pages[BENCH_BURST];
+	cycles_t start;
+	int i, j;
+
+	start = get_cycles();
+	for (i = 0; i < nr_loops; i += BENCH_BURST) {
+		for (j = 0; j < BENCH_BURST; j++)
+			pages[j] = alloc_pages(GFP_KERNEL, bc->order);
+		for (j = 0; j < BENCH_BURST; j++) {
+			if (pages[j])
+				__free_pages(pages[j], bc->order);
+			else
+				bc->failed++;
+		}
+		cond_resched();
+	}
+	bc->cycles = get_cycles() - start;
+}
+
+static int pagealloc_bench_order(struct bench_cpu *bcs, unsigned int order)
+{
+	unsigned long long total = 0;
+	unsigned long failed = 0;
+	cpumask_var_t ran;
+	int cpu, nr_cpus;
+
+	if (!alloc_cpumask_var(&ran, GFP_KERNEL))
+		return -ENOMEM;
+
+	for_each_online_cpu(cpu) {
+		bcs[cpu].order = order;
+		bcs[cpu].cycles = 0;
+		bcs[cpu].failed = 0;
+	}
+
+	nr_cpus = bench_on_each_cpu("pagealloc_bench", pagealloc_bench_cpu,
+				    bcs, ran);
+	for_each_cpu(cpu, ran) {
+		total += bcs[cpu].cycles;
+		failed += bcs[cpu].failed;
+	}
+	free_cpumask_var(ran);
+
+	if (nr_cpus <= 0)
+		return nr_cpus ? nr_cpus : -ENOMEM;
+	total = div_u64(total, nr_cpus);
+	printk(KERN_INFO "pagealloc-bench: order %u: %llu cycles per "
+	       "alloc+free on %d cpus, %lu failed\n", order,
+	       div_u64(total, max(nr_loops, 1)), nr_cpus, failed);
+	return 0;
+}
+
+static int __init pagealloc_bench_init(void)
+{
+	struct bench_cpu *bcs;
+	int order, ret = 0;
+
+	bcs = kcalloc(nr_cpu_ids, sizeof(*bcs), GFP_KERNEL);
+	if (!bcs)
+		return -ENOMEM;
+
+	get_online_cpus();
+	for (order = 0; order <= max_order && order < MAX_ORDER; order++) {
+		ret = pagealloc_bench_order(bcs, order);
+		if (ret)
+			break;
+	}
+	put_online_cpus();
+
+	kfree(bcs);
+
+	/* All the orders are in the log by now, nothing to keep loaded */
+	return ret ? ret : -EAGAIN;
+}
+module_init(pagealloc_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Page allocator microbenchmark");
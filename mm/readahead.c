@@ -18,6 +18,15 @@
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/readahead.h>
+
+/*
+ * Number of sequential streams tracked per file, see "Interleaved
+ * streams" below.  1 disables the tracking.
+ */
+int sysctl_readahead_streams = RA_MAX_STREAMS;
+
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
  * memset *ra to zero.
@@ -328,7 +337,168 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  *
  * The code ramps up the readahead size aggressively at first, but slow down as
  * it approaches max_readhead.
+ *
+ * Interleaved streams.
+ *
+ * When several readers walk different regions of one file through the
+ * same struct file, each new stream used to overwrite the readahead state
+ * of the previous one, and the others had to rediscover themselves via
+ * PG_readahead or the page cache history.  Instead, the stream being
+ * replaced is parked in ra->streams[], up to vm.readahead_streams streams
+ * in total.  An access which continues a parked stream swaps it back in,
+ * and it carries on ramping up from where it was.  Parked streams are
+ * kept most recently used first; the oldest is dropped.
+ *
+ * Strided reads.
+ *
+ * Small reads at a constant forward distance from each other are random
+ * reads to the logic above.  Misses which do not belong to any stream
+ * record their distance in ra->stride; once the same distance has been
+ * seen RA_STRIDE_CONFIRM times in a row, the next chunks of the pattern
+ * are read ahead, up to ra_pages in total.  The first page of the middle
+ * chunk is marked PG_readahead, and reaching it pushes the strided window
+ * forward just like a sequential one.
+ */
+
+#define RA_STRIDE_CONFIRM	2	/* distances in a row before reading ahead */
+#define RA_STRIDE_DEPTH		8	/* max chunks per strided window */
+
+static int ra_nr_parked(void)
+{
+	return min(sysctl_readahead_streams, RA_MAX_STREAMS) - 1;
+}
+
+/*
+ * Make room for a new current stream, remembering the current one.
+ */
+static void ra_park_stream(struct file_ra_state *ra)
+{
+	int nr = ra_nr_parked();
+
+	if (nr <= 0 || !ra->size)
+		return;
+
+	memmove(&ra->streams[1], &ra->streams[0],
+		(nr - 1) * sizeof(struct ra_stream));
+	ra->streams[0].start = ra->start;
+	ra->streams[0].size = ra->size;
+	ra->streams[0].async_size = ra->async_size;
+}
+
+/*
+ * If @offset is where a parked stream expects its next access, make that
+ * stream the current one and park the current one in its place.
+ */
+static int ra_resume_stream(struct file_ra_state *ra, pgoff_t offset)
+{
+	int nr = ra_nr_parked();
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		struct ra_stream s = ra->streams[i];
+
+		if (!s.size)
+			continue;
+		if (offset != s.start + s.size - s.async_size &&
+		    offset != s.start + s.size)
+			continue;
+
+		memmove(&ra->streams[1], &ra->streams[0],
+			i * sizeof(struct ra_stream));
+		ra->streams[0].start = ra->start;
+		ra->streams[0].size = ra->size;
+		ra->streams[0].async_size = ra->async_size;
+
+		ra->start = s.start;
+		ra->size = s.size;
+		ra->async_size = s.async_size;
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Account a miss outside any stream, and tell whether it confirms a
+ * strided pattern.
+ */
+static int ra_stride_miss(struct file_ra_state *ra, pgoff_t offset,
+			  unsigned long req_size)
+{
+	long delta = offset - ra->stride_prev;
+
+	if (ra->stride_hits >= RA_STRIDE_CONFIRM && ra->stride > 0 &&
+	    delta > 0 && delta % ra->stride == 0) {
+		/* Pattern went on past a window we failed to push forward */
+	} else if (delta == ra->stride && delta > (long)req_size) {
+		ra->stride_hits++;
+	} else {
+		ra->stride = delta;
+		ra->stride_hits = 0;
+	}
+
+	ra->stride_prev = offset;
+	ra->stride_len = req_size;
+
+	return ra->stride_hits >= RA_STRIDE_CONFIRM;
+}
+
+/*
+ * Chunks per strided window.  Depends on nothing but the pattern and
+ * ra_pages, so that the window following a marker can be located again.
  */
+static unsigned long ra_stride_depth(struct file_ra_state *ra)
+{
+	return clamp_t(unsigned long, ra->ra_pages / ra->stride_len,
+		       1, RA_STRIDE_DEPTH);
+}
+
+/*
+ * Read stride_len pages at each of the next chunks of a strided pattern,
+ * starting with the one at @offset.
+ */
+static unsigned long stride_readahead(struct address_space *mapping,
+				      struct file_ra_state *ra,
+				      struct file *filp, pgoff_t offset,
+				      unsigned long max)
+{
+	unsigned long len = min_t(unsigned long, ra->stride_len, max);
+	unsigned long depth, mark, i;
+	unsigned long actual = 0;
+
+	if (!len)
+		return 0;
+
+	depth = ra_stride_depth(ra);
+	mark = depth / 2;
+
+	for (i = 0; i < depth; i++) {
+		pgoff_t chunk = offset + i * ra->stride;
+
+		if (chunk < offset)		/* wrapped */
+			break;
+		actual += __do_page_cache_readahead(mapping, filp, chunk, len,
+						    mark && i == mark ? len : 0);
+	}
+
+	ra->stride_next = mark ? offset + mark * ra->stride : 0;
+	ra->stride_prev = offset;
+
+	return actual;
+}
+
+static unsigned long ra_submit_trace(struct file_ra_state *ra,
+				     struct address_space *mapping,
+				     struct file *filp, pgoff_t offset,
+				     unsigned long req_size, bool async,
+				     int pattern)
+{
+	unsigned long actual = ra_submit(ra, mapping, filp);
+
+	trace_mm_readahead(mapping, offset, req_size, async, pattern,
+			   ra->start, ra->size, ra->async_size, actual);
+	return actual;
+}
 
 /*
  * Count contiguously cached pages from @offset-1 to @offset-@max,
@@ -376,6 +546,7 @@ static int try_context_readahead(struct address_space *mapping,
 	if (size >= offset)
 		size *= 2;
 
+	ra_park_stream(ra);
 	ra->start = offset;
 	ra->size = get_init_ra_size(size + req_size, max);
 	ra->async_size = ra->size;
@@ -393,12 +564,17 @@ ondemand_readahead(struct address_space *mapping,
 		   unsigned long req_size)
 {
 	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long actual;
+	int pattern;
 
 	/*
 	 * start of file
 	 */
-	if (!offset)
+	if (!offset) {
+		pattern = RA_PATTERN_INITIAL;
+		ra_park_stream(ra);
 		goto initial_readahead;
+	}
 
 	/*
 	 * It's the expected callback offset, assume sequential access.
@@ -406,10 +582,33 @@ ondemand_readahead(struct address_space *mapping,
 	 */
 	if ((offset == (ra->start + ra->size - ra->async_size) ||
 	     offset == (ra->start + ra->size))) {
-		ra->start += ra->size;
-		ra->size = get_next_ra_size(ra, max);
-		ra->async_size = ra->size;
-		goto readit;
+		pattern = RA_PATTERN_SEQUENTIAL;
+		goto push_forward;
+	}
+
+	/*
+	 * The expected callback offset of a parked stream: switch to it.
+	 */
+	if (ra_resume_stream(ra, offset)) {
+		pattern = RA_PATTERN_STREAM;
+		goto push_forward;
+	}
+
+	/*
+	 * Reached the marker of a strided window: read the next chunks.
+	 */
+	if (hit_readahead_marker && ra->stride_next &&
+	    offset == ra->stride_next &&
+	    ra->stride_hits >= RA_STRIDE_CONFIRM) {
+		pgoff_t next;
+
+		next = ra->stride_prev + ra_stride_depth(ra) * ra->stride;
+
+		actual = stride_readahead(mapping, ra, filp, next, max);
+		trace_mm_readahead(mapping, offset, req_size, true,
+				   RA_PATTERN_STRIDE, next, ra->stride_len, 0,
+				   actual);
+		return actual;
 	}
 
 	/*
@@ -428,38 +627,67 @@ ondemand_readahead(struct address_space *mapping,
 		if (!start || start - offset > max)
 			return 0;
 
+		ra_park_stream(ra);
 		ra->start = start;
 		ra->size = start - offset;	/* old async_size */
 		ra->size += req_size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
+		pattern = RA_PATTERN_MARKER;
 		goto readit;
 	}
 
 	/*
 	 * oversize read
 	 */
-	if (req_size > max)
+	if (req_size > max) {
+		pattern = RA_PATTERN_OVERSIZE;
+		ra_park_stream(ra);
 		goto initial_readahead;
+	}
 
 	/*
 	 * sequential cache miss
 	 */
-	if (offset - (ra->prev_pos >> PAGE_CACHE_SHIFT) <= 1UL)
+	if (offset - (ra->prev_pos >> PAGE_CACHE_SHIFT) <= 1UL) {
+		pattern = RA_PATTERN_INITIAL;
 		goto initial_readahead;
+	}
 
 	/*
 	 * Query the page cache and look for the traces(cached history pages)
 	 * that a sequential stream would leave behind.
 	 */
-	if (try_context_readahead(mapping, ra, offset, req_size, max))
+	if (try_context_readahead(mapping, ra, offset, req_size, max)) {
+		pattern = RA_PATTERN_CONTEXT;
 		goto readit;
+	}
+
+	/*
+	 * Misses at a constant distance: read the next chunks of the pattern.
+	 */
+	if (ra_stride_miss(ra, offset, req_size)) {
+		actual = stride_readahead(mapping, ra, filp, offset, max);
+		trace_mm_readahead(mapping, offset, req_size, false,
+				   RA_PATTERN_STRIDE, offset, ra->stride_len, 0,
+				   actual);
+		return actual;
+	}
 
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
 	 */
-	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
+	actual = __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
+	trace_mm_readahead(mapping, offset, req_size, false, RA_PATTERN_RANDOM,
+			   offset, req_size, 0, actual);
+	return actual;
+
+push_forward:
+	ra->start += ra->size;
+	ra->size = get_next_ra_size(ra, max);
+	ra->async_size = ra->size;
+	goto readit;
 
 initial_readahead:
 	ra->start = offset;
@@ -477,7 +705,8 @@ readit:
 		ra->size += ra->async_size;
 	}
 
-	return ra_submit(ra, mapping, filp);
+	return ra_submit_trace(ra, mapping, filp, offset, req_size,
+			       hit_readahead_marker, pattern);
 }
 
 /**
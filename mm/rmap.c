@@ -966,6 +966,20 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 			}
 			dec_mm_counter(mm, MM_ANONPAGES);
 			inc_mm_counter(mm, MM_SWAPENTS);
+		} else if (!PageSwapBacked(page) &&
+			   TTU_ACTION(flags) == TTU_UNMAP) {
+			/*
+			 * Freed with MADV_FREE: drop the page, the next fault
+			 * maps a zeroed one.  Unless it was written to since,
+			 * and its contents matter again.
+			 */
+			if (PageDirty(page)) {
+				set_pte_at(mm, address, pte, pteval);
+				ret = SWAP_FAIL;
+				goto out_unmap;
+			}
+			dec_mm_counter(mm, MM_ANONPAGES);
+			goto discard;
 		} else if (PAGE_MIGRATION) {
 			/*
 			 * Store the pfn of the page in a special migration
@@ -984,7 +998,7 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 		set_pte_at(mm, address, pte, swp_entry_to_pte(entry));
 	} else
 		dec_mm_counter(mm, MM_FILEPAGES);
-
+discard:
 	page_remove_rmap(page);
 	page_cache_release(page);
 
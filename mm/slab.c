@@ -3755,6 +3755,90 @@ void kmem_cache_free(struct kmem_cache *cachep, void *objp)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/**
+ * kmem_cache_free_bulk - Deallocate an array of objects
+ * @cachep: The cache the allocations were from.
+ * @size: Number of objects in @p.
+ * @p: The previously allocated objects.
+ *
+ * Like kmem_cache_free() on each object, but interrupts are disabled
+ * only once for the whole array.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *cachep, size_t size, void **p)
+{
+	unsigned long flags;
+	size_t i;
+
+	local_irq_save(flags);
+	for (i = 0; i < size; i++) {
+		void *objp = p[i];
+
+		debug_check_no_locks_freed(objp, obj_size(cachep));
+		if (!(cachep->flags & SLAB_DEBUG_OBJECTS))
+			debug_check_no_obj_freed(objp, obj_size(cachep));
+		__cache_free(cachep, objp);
+		trace_kmem_cache_free(_RET_IP_, objp);
+	}
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+/**
+ * kmem_cache_alloc_bulk - Allocate an array of objects
+ * @cachep: The cache to allocate from.
+ * @flags: See kmalloc().
+ * @size: Number of objects to allocate.
+ * @p: Array receiving the objects.
+ *
+ * Like kmem_cache_alloc() for each object, but interrupts are disabled
+ * only once and the objects come straight off the per-cpu array while
+ * it lasts.  Either all @size objects are allocated and @size is
+ * returned, or none are and 0 is returned.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *cachep, gfp_t flags, size_t size,
+			  void **p)
+{
+	unsigned long save_flags;
+	size_t i, nr;
+
+	flags &= gfp_allowed_mask;
+
+	lockdep_trace_alloc(flags);
+
+	if (slab_should_failslab(cachep, flags))
+		return 0;
+
+	cache_alloc_debugcheck_before(cachep, flags);
+	local_irq_save(save_flags);
+	for (nr = 0; nr < size; nr++) {
+		p[nr] = __do_cache_alloc(cachep, flags);
+		if (unlikely(!p[nr]))
+			break;
+	}
+	local_irq_restore(save_flags);
+
+	for (i = 0; i < nr; i++) {
+		void *objp = cache_alloc_debugcheck_after(cachep, flags, p[i],
+						__builtin_return_address(0));
+
+		kmemleak_alloc_recursive(objp, obj_size(cachep), 1,
+					 cachep->flags, flags);
+		kmemcheck_slab_alloc(cachep, flags, objp, obj_size(cachep));
+		if (unlikely(flags & __GFP_ZERO))
+			memset(objp, 0, obj_size(cachep));
+		trace_kmem_cache_alloc(_RET_IP_, objp, obj_size(cachep),
+				       cachep->buffer_size, flags);
+		p[i] = objp;
+	}
+
+	if (unlikely(nr < size)) {
+		kmem_cache_free_bulk(cachep, nr, p);
+		return 0;
+	}
+	return size;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /**
  * kfree - free previously allocated memory
  * @objp: pointer returned by kmalloc.
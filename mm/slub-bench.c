@@ -0,0 +1,263 @@
+/*
+ * mm/slub-bench.c
+ *
+ * Cross-CPU slab allocator microbenchmark.  On load, a private cache is
+ * created and the online CPUs are paired up: the producer on one CPU
+ * allocates batches of objects and hands them to the consumer on the
+ * next CPU, which frees them.  Every free is therefore a remote free to
+ * a slab that is not the consumer's cpu slab, which is the pattern that
+ * used to hit the node list_lock on each slab going partial.  The
+ * average cost of an allocation and of a free is reported.
+ *
+ * Write 0 to /sys/kernel/slab/<cache>/cpu_partial of an existing cache
+ * to compare against the behaviour without per-cpu partial lists; the
+ * benchmark cache itself can be tuned with the cpu_partial parameter.
+ * At least two online CPUs are needed.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/cpu.h>
+#include <linux/bench.h>
+#include <linux/timex.h>
+#include <linux/math64.h>
+
+#define BENCH_BATCH	64
+
+static int nr_objects = 1000000;
+module_param(nr_objects, int, 0444);
+MODULE_PARM_DESC(nr_objects, "Objects passed from each producer to its consumer");
+
+static int object_size = 256;
+module_param(object_size, int, 0444);
+MODULE_PARM_DESC(object_size, "Size of the benchmarked objects");
+
+static int cpu_partial = -1;
+module_param(cpu_partial, int, 0444);
+MODULE_PARM_DESC(cpu_partial, "Override the cache's cpu_partial (-1: default)");
+
+/*
+ * A single batch slot per pair: the producer fills it while it is empty,
+ * the consumer empties it while it is full.
+ */
+struct bench_pair {
+	spinlock_t lock;
+	wait_queue_head_t wait;
+	void *objs[BENCH_BATCH];
+	int nr;			/* objects in objs[], 0 when empty */
+	int finished;		/* producer is done */
+
+	struct task_struct *consumer;	/* bound to the next cpu */
+	struct completion consumer_done;
+	cycles_t alloc_cycles, free_cycles;
+	unsigned long failed;
+};
+
+static struct kmem_cache *bench_cache;
+
+static int slot_empty(struct bench_pair *bp)
+{
+	int ret;
+
+	spin_lock(&bp->lock);
+	ret = !bp->nr;
+	spin_unlock(&bp->lock);
+	return ret;
+}
+
+static int slot_full_or_finished(struct bench_pair *bp)
+{
+	int ret;
+
+	spin_lock(&bp->lock);
+	ret = bp->nr || bp->finished;
+	spin_unlock(&bp->lock);
+	return ret;
+}
+
+/* Let the consumer go once it has freed all there was */
+static void slub_bench_finish(struct bench_pair *bp)
+{
+	wait_event(bp->wait, slot_empty(bp));
+	spin_lock(&bp->lock);
+	bp->finished = 1;
+	spin_unlock(&bp->lock);
+	wake_up(&bp->wait);
+}
+
+static void slub_bench_producer(int cpu, void *data)
+{
+	struct bench_pair *bp = (struct bench_pair *)data + cpu;
+	void *objs[BENCH_BATCH];
+	cycles_t start;
+	int i, j, nr;
+
+	if (!bp->consumer)
+		return;
+
+	for (i = 0; i < nr_objects; i += BENCH_BATCH) {
+		start = get_cycles();
+		for (j = nr = 0; j < BENCH_BATCH; j++) {
+			objs[nr] = kmem_cache_alloc(bench_cache, GFP_KERNEL);
+			if (objs[nr])
+				nr++;
+			else
+				bp->failed++;
+		}
+		bp->alloc_cycles += get_cycles() - start;
+
+		wait_event(bp->wait, slot_empty(bp));
+		spin_lock(&bp->lock);
+		memcpy(bp->objs, objs, nr * sizeof(void *));
+		bp->nr = nr;
+		spin_unlock(&bp->lock);
+		wake_up(&bp->wait);
+	}
+
+	slub_bench_finish(bp);
+}
+
+static int slub_bench_consumer(void *arg)
+{
+	struct bench_pair *bp = arg;
+	void *objs[BENCH_BATCH];
+	cycles_t start;
+	int j, nr;
+
+	for (;;) {
+		wait_event(bp->wait, slot_full_or_finished(bp));
+		spin_lock(&bp->lock);
+		nr = bp->nr;
+		if (!nr && bp->finished) {
+			spin_unlock(&bp->lock);
+			break;
+		}
+		memcpy(objs, bp->objs, nr * sizeof(void *));
+		bp->nr = 0;
+		spin_unlock(&bp->lock);
+		wake_up(&bp->wait);
+
+		start = get_cycles();
+		for (j = 0; j < nr; j++)
+			kmem_cache_free(bench_cache, objs[j]);
+		bp->free_cycles += get_cycles() - start;
+	}
+
+	complete(&bp->consumer_done);
+	return 0;
+}
+
+static int slub_bench_run(struct bench_pair *bps)
+{
+	unsigned long long alloc = 0, free = 0;
+	unsigned long failed = 0;
+	cpumask_var_t ran;
+	int cpu, next, nr_pairs = 0, ret;
+
+	if (!alloc_cpumask_var(&ran, GFP_KERNEL))
+		return -ENOMEM;
+
+	/* The consumers wait for their first batch, no need to gate them */
+	for_each_online_cpu(cpu) {
+		struct bench_pair *bp = &bps[cpu];
+
+		next = cpumask_next(cpu, cpu_online_mask);
+		if (next >= nr_cpu_ids)
+			next = cpumask_first(cpu_online_mask);
+		if (next == cpu)
+			break;
+
+		spin_lock_init(&bp->lock);
+		init_waitqueue_head(&bp->wait);
+		init_completion(&bp->consumer_done);
+
+		bp->consumer = kthread_create(slub_bench_consumer, bp,
+					      "slub_bench_c/%d", next);
+		if (IS_ERR(bp->consumer)) {
+			bp->consumer = NULL;
+			continue;
+		}
+		kthread_bind(bp->consumer, next);
+		wake_up_process(bp->consumer);
+	}
+
+	ret = bench_on_each_cpu("slub_bench_p", slub_bench_producer, bps, ran);
+
+	for_each_online_cpu(cpu) {
+		struct bench_pair *bp = &bps[cpu];
+
+		if (!bp->consumer)
+			continue;
+		if (!cpumask_test_cpu(cpu, ran)) {
+			/* No producer ran for it */
+			slub_bench_finish(bp);
+			wait_for_completion(&bp->consumer_done);
+			continue;
+		}
+		wait_for_completion(&bp->consumer_done);
+		alloc += bp->alloc_cycles;
+		free += bp->free_cycles;
+		failed += bp->failed;
+		nr_pairs++;
+	}
+	free_cpumask_var(ran);
+
+	if (ret < 0)
+		return ret;
+	if (!nr_pairs) {
+		printk(KERN_INFO "slub-bench: needs at least two online cpus\n");
+		return -ENODEV;
+	}
+	alloc = div_u64(alloc, nr_pairs);
+	free = div_u64(free, nr_pairs);
+	printk(KERN_INFO "slub-bench: %d byte objects, cpu_partial %d: "
+	       "%llu cycles per alloc, %llu cycles per remote free "
+	       "on %d cpu pairs, %lu failed\n", object_size,
+	       bench_cache->cpu_partial, div_u64(alloc, max(nr_objects, 1)),
+	       div_u64(free, max(nr_objects, 1)), nr_pairs, failed);
+	return 0;
+}
+
+static int __init slub_bench_init(void)
+{
+	struct bench_pair *bps;
+	int ret;
+
+	if (object_size < sizeof(void *) || object_size > PAGE_SIZE)
+		return -EINVAL;
+
+	bench_cache = kmem_cache_create("slub_bench", object_size, 0, 0, NULL);
+	if (!bench_cache)
+		return -ENOMEM;
+	if (cpu_partial >= 0)
+		bench_cache->cpu_partial = cpu_partial;
+
+	bps = kcalloc(nr_cpu_ids, sizeof(*bps), GFP_KERNEL);
+	if (!bps) {
+		kmem_cache_destroy(bench_cache);
+		return -ENOMEM;
+	}
+
+	get_online_cpus();
+	ret = slub_bench_run(bps);
+	put_online_cpus();
+
+	kfree(bps);
+	kmem_cache_destroy(bench_cache);
+
+	/* The cache is gone, a run again needs a new load */
+	return ret ? ret : -EAGAIN;
+}
+module_init(slub_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Cross-CPU slab allocator microbenchmark");
@@ -1480,6 +1480,104 @@ static void deactivate_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	unfreeze_slab(s, page, tail);
 }
 
+/*
+ * Move the slabs on the cpu partial list back to the node partial lists,
+ * taking each node's list_lock once for a run of slabs from that node.
+ *
+ * The slab lock nests outside the list_lock, so it can only be trylocked
+ * here: when that fails, drop the list_lock and take them in order.
+ */
+static void unfreeze_partials(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct kmem_cache_node *n = NULL;
+	struct page *page, *t;
+	LIST_HEAD(discard);
+
+	if (list_empty(&c->partial))
+		return;
+
+	stat(s, CPU_PARTIAL_DRAIN);
+	list_for_each_entry_safe(page, t, &c->partial, lru) {
+		struct kmem_cache_node *n2 = get_node(s, page_to_nid(page));
+
+		if (n != n2) {
+			if (n)
+				spin_unlock(&n->list_lock);
+			n = n2;
+			spin_lock(&n->list_lock);
+		}
+		if (!slab_trylock(page)) {
+			spin_unlock(&n->list_lock);
+			slab_lock(page);
+			spin_lock(&n->list_lock);
+		}
+
+		list_del(&page->lru);
+		__ClearPageSlubFrozen(page);
+		if (!page->inuse && n->nr_partial >= s->min_partial) {
+			list_add(&page->lru, &discard);
+		} else {
+			/* Never full: it got here by an object being freed */
+			n->nr_partial++;
+			list_add_tail(&page->lru, &n->partial);
+		}
+		slab_unlock(page);
+	}
+	if (n)
+		spin_unlock(&n->list_lock);
+	c->nr_partial = 0;
+
+	list_for_each_entry_safe(page, t, &discard, lru) {
+		stat(s, FREE_SLAB);
+		discard_slab(s, page);
+	}
+}
+
+/*
+ * A slab which was full has had an object freed: instead of moving it to
+ * the node partial list under the list_lock, freeze it onto this cpu's
+ * partial list, where later frees to it need no list processing at all,
+ * and from where this cpu will allocate from it when its slab runs out.
+ * When the list grows beyond cpu_partial, it all moves to the node lists.
+ *
+ * Called with interrupts disabled and the slab lock held, which is dropped.
+ */
+static void put_cpu_partial(struct kmem_cache *s, struct page *page)
+{
+	struct kmem_cache_cpu *c = __this_cpu_ptr(s->cpu_slab);
+
+	__SetPageSlubFrozen(page);
+	list_add(&page->lru, &c->partial);
+	slab_unlock(page);
+	stat(s, CPU_PARTIAL_FREE);
+
+	if (++c->nr_partial > s->cpu_partial)
+		unfreeze_partials(s, c);
+}
+
+/*
+ * Take a slab from the cpu partial list as the new cpu slab, returned
+ * locked; or NULL if there is none on the requested node.
+ */
+static struct page *get_cpu_partial(struct kmem_cache *s,
+				    struct kmem_cache_cpu *c, int node)
+{
+	struct page *page;
+
+	if (list_empty(&c->partial))
+		return NULL;
+
+	page = list_first_entry(&c->partial, struct page, lru);
+	if (node != -1 && page_to_nid(page) != node)
+		return NULL;
+
+	list_del(&page->lru);
+	c->nr_partial--;
+	slab_lock(page);
+	stat(s, CPU_PARTIAL_ALLOC);
+	return page;
+}
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	stat(s, CPUSLAB_FLUSH);
@@ -1498,6 +1596,8 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 
 	if (likely(c && c->page))
 		flush_slab(s, c);
+	if (likely(c))
+		unfreeze_partials(s, c);
 }
 
 static void flush_cpu_slab(void *d)
@@ -1644,6 +1744,12 @@ another_slab:
 	deactivate_slab(s, c);
 
 new_slab:
+	new = get_cpu_partial(s, c, node);
+	if (new) {
+		c->page = new;
+		goto load_freelist;
+	}
+
 	new = get_partial(s, gfpflags, node);
 	if (new) {
 		c->page = new;
@@ -1806,9 +1912,13 @@ checks_ok:
 
 	/*
 	 * Objects left in the slab. If it was not on the partial list before
-	 * then add it.
+	 * then add it: to this cpu's own partial list if the cache has one.
 	 */
 	if (unlikely(!prior)) {
+		if (s->cpu_partial && !(SLABDEBUG && PageSlubDebug(page))) {
+			put_cpu_partial(s, page);
+			return;
+		}
 		add_partial(get_node(s, page_to_nid(page)), page, 1);
 		stat(s, FREE_ADD_PARTIAL);
 	}
@@ -1883,6 +1993,98 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/*
+ * Free an array of objects with interrupts disabled and the cpu slab
+ * looked up only once.  Objects of the current cpu slab go straight
+ * onto the lockless freelist, the others take the __slab_free path.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	size_t i;
+
+	local_irq_save(flags);
+	c = __this_cpu_ptr(s->cpu_slab);
+	for (i = 0; i < size; i++) {
+		void **object = p[i];
+		struct page *page = virt_to_head_page(object);
+
+		kmemleak_free_recursive(object, s->flags);
+		kmemcheck_slab_free(s, object, s->objsize);
+		debug_check_no_locks_freed(object, s->objsize);
+		if (!(s->flags & SLAB_DEBUG_OBJECTS))
+			debug_check_no_obj_freed(object, s->objsize);
+		if (likely(page == c->page && c->node >= 0)) {
+			set_freepointer(s, object, c->freelist);
+			c->freelist = object;
+			stat(s, FREE_FASTPATH);
+		} else
+			__slab_free(s, page, object, _RET_IP_);
+		trace_kmem_cache_free(_RET_IP_, object);
+	}
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+/*
+ * Allocate an array of objects, all or nothing: returns @size on success
+ * and 0 if not every object could be allocated.  Interrupts are disabled
+ * once for the whole array and the lockless freelist is drained in a
+ * single pass; __slab_alloc is only entered when it runs dry.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t gfpflags, size_t size,
+			  void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	size_t i, nr;
+
+	gfpflags &= gfp_allowed_mask;
+
+	lockdep_trace_alloc(gfpflags);
+	might_sleep_if(gfpflags & __GFP_WAIT);
+
+	if (should_failslab(s->objsize, gfpflags, s->flags))
+		return 0;
+
+	local_irq_save(flags);
+	c = __this_cpu_ptr(s->cpu_slab);
+	for (nr = 0; nr < size; nr++) {
+		void **object = c->freelist;
+
+		if (unlikely(!object)) {
+			object = __slab_alloc(s, gfpflags, -1, _RET_IP_, c);
+			if (unlikely(!object))
+				break;
+			/* We may have been migrated while the slab was allocated */
+			c = __this_cpu_ptr(s->cpu_slab);
+		} else {
+			c->freelist = get_freepointer(s, object);
+			stat(s, ALLOC_FASTPATH);
+		}
+		p[nr] = object;
+	}
+	local_irq_restore(flags);
+
+	for (i = 0; i < nr; i++) {
+		if (unlikely(gfpflags & __GFP_ZERO))
+			memset(p[i], 0, s->objsize);
+		kmemcheck_slab_alloc(s, gfpflags, p[i], s->objsize);
+		kmemleak_alloc_recursive(p[i], s->objsize, 1, s->flags,
+					 gfpflags);
+		trace_kmem_cache_alloc(_RET_IP_, p[i], s->objsize, s->size,
+				       gfpflags);
+	}
+
+	if (unlikely(nr < size)) {
+		kmem_cache_free_bulk(s, nr, p);
+		return 0;
+	}
+	return size;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /* Figure out on which slab page the object resides */
 static struct page *get_object_page(const void *x)
 {
@@ -2070,6 +2272,8 @@ static DEFINE_PER_CPU(struct kmem_cache_cpu, kmalloc_percpu[KMALLOC_CACHES]);
 
 static inline int alloc_kmem_cache_cpus(struct kmem_cache *s, gfp_t flags)
 {
+	int cpu;
+
 	if (s < kmalloc_caches + KMALLOC_CACHES && s >= kmalloc_caches)
 		/*
 		 * Boot time creation of the kmalloc array. Use static per cpu data
@@ -2082,6 +2286,9 @@ static inline int alloc_kmem_cache_cpus(struct kmem_cache *s, gfp_t flags)
 	if (!s->cpu_slab)
 		return 0;
 
+	for_each_possible_cpu(cpu)
+		INIT_LIST_HEAD(&per_cpu_ptr(s->cpu_slab, cpu)->partial);
+
 	return 1;
 }
 
@@ -2203,6 +2410,27 @@ static void set_min_partial(struct kmem_cache *s, unsigned long min)
 	s->min_partial = min;
 }
 
+/*
+ * The cpu partial lists absorb slabs going from full to partial where they
+ * are freed, typically producer/consumer patterns freeing objects on
+ * another cpu than allocated them.  Keep fewer of the larger slabs per cpu.
+ * Debug caches need every slab on the node lists, to be validated.
+ */
+static void set_cpu_partial(struct kmem_cache *s)
+{
+	if (s->flags & (SLAB_DEBUG_FREE | SLAB_RED_ZONE | SLAB_POISON |
+			SLAB_STORE_USER | SLAB_TRACE))
+		s->cpu_partial = 0;
+	else if (s->size >= PAGE_SIZE)
+		s->cpu_partial = 2;
+	else if (s->size >= 1024)
+		s->cpu_partial = 6;
+	else if (s->size >= 256)
+		s->cpu_partial = 13;
+	else
+		s->cpu_partial = 30;
+}
+
 /*
  * calculate_sizes() determines the order and the distribution of data within
  * a slab object.
@@ -2359,6 +2587,7 @@ static int kmem_cache_open(struct kmem_cache *s, gfp_t gfpflags,
 	 * list to avoid pounding the page allocator excessively.
 	 */
 	set_min_partial(s, ilog2(s->size));
+	set_cpu_partial(s);
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -3941,6 +4170,42 @@ static ssize_t min_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(min_partial);
 
+static ssize_t cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->cpu_partial);
+}
+
+static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long slabs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &slabs);
+	if (err)
+		return err;
+	if (slabs > INT_MAX)
+		return -EINVAL;
+
+	s->cpu_partial = slabs;
+	/* Drain the lists now if they were switched off */
+	if (!slabs)
+		flush_all(s);
+	return length;
+}
+SLAB_ATTR(cpu_partial);
+
+static ssize_t slabs_cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	unsigned long total = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		total += per_cpu_ptr(s->cpu_slab, cpu)->nr_partial;
+	return sprintf(buf, "%lu\n", total);
+}
+SLAB_ATTR_RO(slabs_cpu_partial);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (s->ctor) {
@@ -4282,6 +4547,9 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
+STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
+STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4290,6 +4558,8 @@ static struct attribute *slab_attrs[] = {
 	&objs_per_slab_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
+	&cpu_partial_attr.attr,
+	&slabs_cpu_partial_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&total_objects_attr.attr,
@@ -4336,6 +4606,9 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&cpu_partial_alloc_attr.attr,
+	&cpu_partial_free_attr.attr,
+	&cpu_partial_drain_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
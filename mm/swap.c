@@ -34,11 +34,120 @@
 
 #include "internal.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/lru.h>
+
 /* How many pages do we try to swap or page in/out together? */
 int page_cluster;
 
-static DEFINE_PER_CPU(struct pagevec[NR_LRU_LISTS], lru_add_pvecs);
-static DEFINE_PER_CPU(struct pagevec, lru_rotate_pvecs);
+/*
+ * Pages are handed to the LRU lists in per-cpu batches, so that
+ * zone->lru_lock is taken once per batch rather than once per page.
+ * The batches live in percpu memory rather than on the stack, so they
+ * can be larger than a pagevec: 31 pointers and a count make 256 bytes.
+ */
+#define LRU_BATCH_SIZE	31
+
+struct lru_batch {
+	unsigned long nr;
+	struct page *pages[LRU_BATCH_SIZE];
+};
+
+static DEFINE_PER_CPU(struct lru_batch[NR_LRU_LISTS], lru_add_batches);
+static DEFINE_PER_CPU(struct lru_batch, lru_rotate_batch);
+static DEFINE_PER_CPU(struct lru_batch, lru_activate_batch);
+static DEFINE_PER_CPU(struct lru_batch, lru_deactivate_batch);
+static DEFINE_PER_CPU(struct lru_batch, lru_lazyfree_batch);
+
+typedef void (*lru_move_fn)(struct page *page, struct zone *zone, void *arg);
+
+/*
+ * Add a page to a batch, returning the number of slots left.
+ */
+static inline unsigned lru_batch_add(struct lru_batch *batch,
+				     struct page *page)
+{
+	batch->pages[batch->nr++] = page;
+	return LRU_BATCH_SIZE - batch->nr;
+}
+
+/*
+ * The lru_lock holds are only timed while mm_lru_lock_hold is traced:
+ * lru_lock_hold_start() returns 0 as the start time otherwise, and
+ * lru_lock_hold_end() then neither reads the clock nor traces.  Call the
+ * former with the lock just taken, the latter with it just dropped.
+ */
+u64 lru_lock_hold_start(void)
+{
+#ifdef CONFIG_TRACEPOINTS
+	if (unlikely(__tracepoint_mm_lru_lock_hold.state))
+		return sched_clock();
+#endif
+	return 0;
+}
+
+void lru_lock_hold_end(struct zone *zone, int op, unsigned int nr, u64 start)
+{
+	if (likely(!start))
+		return;
+	trace_mm_lru_lock_hold(zone, op, nr, sched_clock() - start);
+}
+
+static inline u64 lru_lock(struct zone *zone, unsigned long *flags)
+{
+	spin_lock_irqsave(&zone->lru_lock, *flags);
+	return lru_lock_hold_start();
+}
+
+static void lru_unlock(struct zone *zone, unsigned long flags, int op,
+		       unsigned int nr, u64 start)
+{
+	spin_unlock_irqrestore(&zone->lru_lock, flags);
+	lru_lock_hold_end(zone, op, nr, start);
+}
+
+/*
+ * Apply @move_fn to each of @pages under its zone's lru_lock, taking the
+ * lock once for each run of pages from the same zone, then drop the
+ * references the batch held on the pages.
+ */
+static void lru_move_pages(struct page **pages, int nr, int cold, int op,
+			   lru_move_fn move_fn, void *arg)
+{
+	struct zone *zone = NULL;
+	unsigned long uninitialized_var(flags);
+	unsigned int held = 0;
+	u64 start = 0;
+	int i;
+
+	trace_mm_lru_batch(op, nr);
+
+	for (i = 0; i < nr; i++) {
+		struct page *page = pages[i];
+		struct zone *pagezone = page_zone(page);
+
+		if (pagezone != zone) {
+			if (zone)
+				lru_unlock(zone, flags, op, held, start);
+			zone = pagezone;
+			start = lru_lock(zone, &flags);
+			held = 0;
+		}
+		(*move_fn)(page, zone, arg);
+		held++;
+	}
+	if (zone)
+		lru_unlock(zone, flags, op, held, start);
+
+	release_pages(pages, nr, cold);
+}
+
+static void lru_batch_drain(struct lru_batch *batch, int op,
+			    lru_move_fn move_fn, void *arg)
+{
+	lru_move_pages(batch->pages, batch->nr, 0, op, move_fn, arg);
+	batch->nr = 0;
+}
 
 /*
  * This path almost never happens for VM activity - pages are normally
@@ -98,37 +207,28 @@ void put_pages_list(struct list_head *pages)
 }
 EXPORT_SYMBOL(put_pages_list);
 
+static void pagevec_move_tail_fn(struct page *page, struct zone *zone,
+				 void *arg)
+{
+	int *pgmoved = arg;
+
+	if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
+		int lru = page_lru_base_type(page);
+		list_move_tail(&page->lru, mem_cgroup_lru_list(zone, page, lru));
+		(*pgmoved)++;
+	}
+}
+
 /*
  * pagevec_move_tail() must be called with IRQ disabled.
  * Otherwise this may cause nasty races.
  */
-static void pagevec_move_tail(struct pagevec *pvec)
+static void pagevec_move_tail(struct lru_batch *batch)
 {
-	int i;
 	int pgmoved = 0;
-	struct zone *zone = NULL;
-
-	for (i = 0; i < pagevec_count(pvec); i++) {
-		struct page *page = pvec->pages[i];
-		struct zone *pagezone = page_zone(page);
 
-		if (pagezone != zone) {
-			if (zone)
-				spin_unlock(&zone->lru_lock);
-			zone = pagezone;
-			spin_lock(&zone->lru_lock);
-		}
-		if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
-			int lru = page_lru_base_type(page);
-			list_move_tail(&page->lru, &zone->lru[lru].list);
-			pgmoved++;
-		}
-	}
-	if (zone)
-		spin_unlock(&zone->lru_lock);
+	lru_batch_drain(batch, LRU_OP_ROTATE, pagevec_move_tail_fn, &pgmoved);
 	__count_vm_events(PGROTATED, pgmoved);
-	release_pages(pvec->pages, pvec->nr, pvec->cold);
-	pagevec_reinit(pvec);
 }
 
 /*
@@ -140,14 +240,14 @@ void  rotate_reclaimable_page(struct page *page)
 {
 	if (!PageLocked(page) && !PageDirty(page) && !PageActive(page) &&
 	    !PageUnevictable(page) && PageLRU(page)) {
-		struct pagevec *pvec;
+		struct lru_batch *batch;
 		unsigned long flags;
 
 		page_cache_get(page);
 		local_irq_save(flags);
-		pvec = &__get_cpu_var(lru_rotate_pvecs);
-		if (!pagevec_add(pvec, page))
-			pagevec_move_tail(pvec);
+		batch = &__get_cpu_var(lru_rotate_batch);
+		if (!lru_batch_add(batch, page))
+			pagevec_move_tail(batch);
 		local_irq_restore(flags);
 	}
 }
@@ -172,14 +272,8 @@ static void update_page_reclaim_stat(struct zone *zone, struct page *page,
 		memcg_reclaim_stat->recent_rotated[file]++;
 }
 
-/*
- * FIXME: speed this up?
- */
-void activate_page(struct page *page)
+static void __activate_page(struct page *page, struct zone *zone, void *arg)
 {
-	struct zone *zone = page_zone(page);
-
-	spin_lock_irq(&zone->lru_lock);
 	if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
 		int file = page_is_file_cache(page);
 		int lru = page_lru_base_type(page);
@@ -192,7 +286,135 @@ void activate_page(struct page *page)
 
 		update_page_reclaim_stat(zone, page, file, 1);
 	}
-	spin_unlock_irq(&zone->lru_lock);
+}
+
+/*
+ * The page is moved to the active list when this cpu's activation batch
+ * is drained, along with up to LRU_BATCH_SIZE - 1 others.
+ */
+void activate_page(struct page *page)
+{
+	if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
+		struct lru_batch *batch = &get_cpu_var(lru_activate_batch);
+
+		page_cache_get(page);
+		if (!lru_batch_add(batch, page))
+			lru_batch_drain(batch, LRU_OP_ACTIVATE,
+					__activate_page, NULL);
+		put_cpu_var(lru_activate_batch);
+	}
+}
+
+/*
+ * If the page can not be invalidated, it is moved to the inactive list
+ * to speed up its reclaim.  Clean pages go to the tail, to be reclaimed
+ * first; dirty and writeback pages go to the head, which gives the
+ * flusher threads time to write them out before reclaim gets there.
+ * Mapped pages are left alone, someone is still using them.
+ */
+static void lru_deactivate_fn(struct page *page, struct zone *zone,
+			      void *arg)
+{
+	int lru, file, active;
+
+	if (!PageLRU(page) || PageUnevictable(page))
+		return;
+
+	if (page_mapped(page))
+		return;
+
+	active = PageActive(page);
+	file = page_is_file_cache(page);
+	lru = page_lru_base_type(page);
+	del_page_from_lru_list(zone, page, active ? lru + LRU_ACTIVE : lru);
+	ClearPageActive(page);
+	ClearPageReferenced(page);
+	add_page_to_lru_list(zone, page, lru);
+
+	if (!PageWriteback(page) && !PageDirty(page)) {
+		list_move_tail(&page->lru, mem_cgroup_lru_list(zone, page, lru));
+		__count_vm_event(PGROTATED);
+	}
+
+	if (active)
+		__count_vm_event(PGDEACTIVATE);
+	update_page_reclaim_stat(zone, page, file, 0);
+}
+
+/**
+ * deactivate_page - forcefully deactivate a page
+ * @page: page to deactivate
+ *
+ * This function hints the VM that @page is a good reclaim candidate,
+ * for example if its invalidation fails due to the page being dirty
+ * or under writeback.
+ */
+void deactivate_page(struct page *page)
+{
+	/*
+	 * In a workload with many unevictable page such as mprotect,
+	 * unevictable page deactivation for accelerating reclaim is
+	 * pointless.
+	 */
+	if (PageUnevictable(page))
+		return;
+
+	if (likely(get_page_unless_zero(page))) {
+		struct lru_batch *batch = &get_cpu_var(lru_deactivate_batch);
+
+		if (!lru_batch_add(batch, page))
+			lru_batch_drain(batch, LRU_OP_DEACTIVATE,
+					lru_deactivate_fn, NULL);
+		put_cpu_var(lru_deactivate_batch);
+	}
+}
+
+/*
+ * A lazily freed page is clean and its contents are not wanted: reclaim
+ * can drop it without swapping, as it drops clean page cache.  It loses
+ * PG_swapbacked and moves to the inactive file list, until reclaim finds
+ * it redirtied and makes it swap backed again.
+ */
+static void lru_lazyfree_fn(struct page *page, struct zone *zone, void *arg)
+{
+	int active;
+
+	if (!PageLRU(page) || !PageAnon(page) || !PageSwapBacked(page) ||
+	    PageSwapCache(page) || PageUnevictable(page))
+		return;
+
+	active = PageActive(page);
+	del_page_from_lru_list(zone, page, LRU_INACTIVE_ANON + active);
+	ClearPageActive(page);
+	ClearPageReferenced(page);
+	ClearPageSwapBacked(page);
+	add_page_to_lru_list(zone, page, LRU_INACTIVE_FILE);
+
+	if (active)
+		__count_vm_event(PGDEACTIVATE);
+	__count_vm_event(PGLAZYFREE);
+	update_page_reclaim_stat(zone, page, 1, 0);
+}
+
+/**
+ * mark_page_lazyfree - make an anonymous page lazily freeable
+ * @page: page to mark, clean and mapped once
+ *
+ * Used by MADV_FREE: the page stays mapped, but reclaim may discard it
+ * instead of swapping it out if it has not been written to again.
+ */
+void mark_page_lazyfree(struct page *page)
+{
+	if (PageLRU(page) && PageAnon(page) && PageSwapBacked(page) &&
+	    !PageSwapCache(page) && !PageUnevictable(page)) {
+		struct lru_batch *batch = &get_cpu_var(lru_lazyfree_batch);
+
+		page_cache_get(page);
+		if (!lru_batch_add(batch, page))
+			lru_batch_drain(batch, LRU_OP_LAZYFREE,
+					lru_lazyfree_fn, NULL);
+		put_cpu_var(lru_lazyfree_batch);
+	}
 }
 
 /*
@@ -215,14 +437,32 @@ void mark_page_accessed(struct page *page)
 
 EXPORT_SYMBOL(mark_page_accessed);
 
+static void __pagevec_lru_add_fn(struct page *page, struct zone *zone,
+				 void *arg)
+{
+	enum lru_list lru = *(enum lru_list *)arg;
+	int file = is_file_lru(lru);
+	int active = is_active_lru(lru);
+
+	VM_BUG_ON(PageActive(page));
+	VM_BUG_ON(PageUnevictable(page));
+	VM_BUG_ON(PageLRU(page));
+
+	SetPageLRU(page);
+	if (active)
+		SetPageActive(page);
+	update_page_reclaim_stat(zone, page, file, active);
+	add_page_to_lru_list(zone, page, lru);
+}
+
 void __lru_cache_add(struct page *page, enum lru_list lru)
 {
-	struct pagevec *pvec = &get_cpu_var(lru_add_pvecs)[lru];
+	struct lru_batch *batch = &get_cpu_var(lru_add_batches)[lru];
 
 	page_cache_get(page);
-	if (!pagevec_add(pvec, page))
-		____pagevec_lru_add(pvec, lru);
-	put_cpu_var(lru_add_pvecs);
+	if (!lru_batch_add(batch, page))
+		lru_batch_drain(batch, LRU_OP_ADD, __pagevec_lru_add_fn, &lru);
+	put_cpu_var(lru_add_batches);
 }
 
 /**
@@ -266,36 +506,50 @@ void add_page_to_unevictable_list(struct page *page)
 }
 
 /*
- * Drain pages out of the cpu's pagevecs.
+ * Drain pages out of the cpu's LRU batches.
  * Either "cpu" is the current CPU, and preemption has already been
  * disabled; or "cpu" is being hot-unplugged, and is already dead.
  */
-static void drain_cpu_pagevecs(int cpu)
+void lru_add_drain_cpu(int cpu)
 {
-	struct pagevec *pvecs = per_cpu(lru_add_pvecs, cpu);
-	struct pagevec *pvec;
-	int lru;
+	struct lru_batch *batches = per_cpu(lru_add_batches, cpu);
+	struct lru_batch *batch;
+	enum lru_list lru;
 
 	for_each_lru(lru) {
-		pvec = &pvecs[lru - LRU_BASE];
-		if (pagevec_count(pvec))
-			____pagevec_lru_add(pvec, lru);
+		batch = &batches[lru - LRU_BASE];
+		if (batch->nr)
+			lru_batch_drain(batch, LRU_OP_ADD,
+					__pagevec_lru_add_fn, &lru);
 	}
 
-	pvec = &per_cpu(lru_rotate_pvecs, cpu);
-	if (pagevec_count(pvec)) {
+	batch = &per_cpu(lru_rotate_batch, cpu);
+	if (batch->nr) {
 		unsigned long flags;
 
 		/* No harm done if a racing interrupt already did this */
 		local_irq_save(flags);
-		pagevec_move_tail(pvec);
+		pagevec_move_tail(batch);
 		local_irq_restore(flags);
 	}
+
+	batch = &per_cpu(lru_activate_batch, cpu);
+	if (batch->nr)
+		lru_batch_drain(batch, LRU_OP_ACTIVATE, __activate_page, NULL);
+
+	batch = &per_cpu(lru_deactivate_batch, cpu);
+	if (batch->nr)
+		lru_batch_drain(batch, LRU_OP_DEACTIVATE,
+				lru_deactivate_fn, NULL);
+
+	batch = &per_cpu(lru_lazyfree_batch, cpu);
+	if (batch->nr)
+		lru_batch_drain(batch, LRU_OP_LAZYFREE, lru_lazyfree_fn, NULL);
 }
 
 void lru_add_drain(void)
 {
-	drain_cpu_pagevecs(get_cpu());
+	lru_add_drain_cpu(get_cpu());
 	put_cpu();
 }
 
@@ -403,37 +657,10 @@ EXPORT_SYMBOL(__pagevec_release);
  */
 void ____pagevec_lru_add(struct pagevec *pvec, enum lru_list lru)
 {
-	int i;
-	struct zone *zone = NULL;
-
 	VM_BUG_ON(is_unevictable_lru(lru));
 
-	for (i = 0; i < pagevec_count(pvec); i++) {
-		struct page *page = pvec->pages[i];
-		struct zone *pagezone = page_zone(page);
-		int file;
-		int active;
-
-		if (pagezone != zone) {
-			if (zone)
-				spin_unlock_irq(&zone->lru_lock);
-			zone = pagezone;
-			spin_lock_irq(&zone->lru_lock);
-		}
-		VM_BUG_ON(PageActive(page));
-		VM_BUG_ON(PageUnevictable(page));
-		VM_BUG_ON(PageLRU(page));
-		SetPageLRU(page);
-		active = is_active_lru(lru);
-		file = is_file_lru(lru);
-		if (active)
-			SetPageActive(page);
-		update_page_reclaim_stat(zone, page, file, active);
-		add_page_to_lru_list(zone, page, lru);
-	}
-	if (zone)
-		spin_unlock_irq(&zone->lru_lock);
-	release_pages(pvec->pages, pvec->nr, pvec->cold);
+	lru_move_pages(pvec->pages, pagevec_count(pvec), pvec->cold,
+		       LRU_OP_ADD, __pagevec_lru_add_fn, &lru);
 	pagevec_reinit(pvec);
 }
 
@@ -19,6 +19,7 @@
 #include <linux/pagevec.h>
 #include <linux/migrate.h>
 #include <linux/page_cgroup.h>
+#include <linux/log2.h>
 
 #include <asm/pgtable.h>
 
@@ -136,6 +137,11 @@ void __delete_from_swap_cache(struct page *page)
 	total_swapcache_pages--;
 	__dec_zone_page_state(page, NR_FILE_PAGES);
 	INC_CACHE_INFO(del_total);
+	/* Read ahead, but dropped before anybody faulted it in */
+	if (unlikely(PageReadahead(page))) {
+		ClearPageReadahead(page);
+		__count_vm_event(SWAP_RA_MISS);
+	}
 }
 
 /**
@@ -256,15 +262,29 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
  * unlocked and with its refcount incremented - we rely on the kernel
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
+ *
+ * If the page is found because it was read ahead, the hit is accounted,
+ * and credited to @vma (if any) to let its readahead window grow.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
+			       unsigned long addr)
 {
 	struct page *page;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		/*
+		 * PG_readahead is PG_reclaim: only trust it on a page that
+		 * is not being written out.
+		 */
+		if (!PageWriteback(page) && TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			if (vma)
+				swap_ra_hit(vma);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -276,12 +296,14 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *new_page_allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new_page_allocated = false;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -332,6 +354,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*new_page_allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -349,6 +372,15 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool page_was_allocated;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &page_was_allocated);
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -385,13 +417,187 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 */
 	nr_pages = valid_swaphandles(entry, &offset);
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
+		bool page_was_allocated;
+
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
+		page = __read_swap_cache_async(swp_entry(swp_type(entry), offset),
+					       gfp_mask, vma, addr,
+					       &page_was_allocated);
 		if (!page)
 			break;
+		if (page_was_allocated && offset != swp_offset(entry)) {
+			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+		}
 		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/*
+ * VMA based swap readahead.
+ *
+ * Once the swap area is fragmented, the slots next to the faulting one
+ * belong to whoever happened to be swapped out at the same time, and
+ * reading them in is mostly wasted I/O.  What a process faults in next is
+ * much more likely to be next to the faulting address in its own address
+ * space, so read the swap entries found in the neighbouring ptes instead.
+ *
+ * The window is sized from the readahead hits seen in the vma since its
+ * last swapin readahead: it starts at one page (or two if this fault is
+ * next to the previous one), grows with the hits up to 1 << page_cluster
+ * pages, and shrinks at most by half per fault.  The window, the number of
+ * hits and the last faulting address are packed in vma->swap_readahead_info.
+ */
+int sysctl_swap_vma_readahead __read_mostly = 1;
+
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN_MAX		(SWAP_RA_WIN_MASK >> SWAP_RA_WIN_SHIFT)
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)			\
+	(((addr) & PAGE_MASK) |				\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+/*
+ * Racy against concurrent faults in the same vma, but the worst that can
+ * happen is that a hit is lost or a window is sized off stale history.
+ */
+void swap_ra_hit(struct vm_area_struct *vma)
+{
+	unsigned long ra_val = atomic_long_read(&vma->swap_readahead_info);
+
+	if (SWAP_RA_HITS(ra_val) < SWAP_RA_HITS_MAX)
+		atomic_long_set(&vma->swap_readahead_info, ra_val + 1);
+}
+
+static unsigned int swap_ra_window(unsigned long faddr, unsigned long ra_val)
+{
+	unsigned long prev_faddr = SWAP_RA_ADDR(ra_val);
+	unsigned int hits = SWAP_RA_HITS(ra_val);
+	unsigned int prev_win = SWAP_RA_WIN(ra_val);
+	unsigned int max_win = min_t(unsigned int, 1 << page_cluster,
+				     SWAP_RA_WIN_MAX);
+	unsigned int win;
+
+	win = hits + 2;
+	if (win == 2) {
+		/* No hits: only read ahead if the faults look sequential */
+		if (faddr != prev_faddr + PAGE_SIZE &&
+		    faddr != prev_faddr - PAGE_SIZE)
+			win = 1;
+	} else {
+		win = roundup_pow_of_two(win);
+	}
+	if (win > max_win)
+		win = max_win;
+
+	/* Don't shrink the window too fast */
+	if (win < prev_win / 2)
+		win = prev_win / 2;
+
+	return win;
+}
+
+/*
+ * Read in the swap entries of the ptes around @faddr in @vma, and the one
+ * of @entry last.  The window stays within the vma and within the page
+ * table that maps @faddr.  The caller holds mmap_sem, so the page table
+ * cannot go away under us; the ptes are sampled without the pte lock, and
+ * read_swap_cache_async() copes with entries that are no longer valid.
+ */
+struct page *swap_vma_readahead(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long faddr)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long ra_val, prev_faddr, start, end, left, addr;
+	unsigned int win;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *orig_pte, *pte;
+
+	if (!sysctl_swap_vma_readahead || !page_cluster)
+		return swapin_readahead(entry, gfp_mask, vma, faddr);
+
+	faddr &= PAGE_MASK;
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	prev_faddr = SWAP_RA_ADDR(ra_val);
+	win = swap_ra_window(faddr, ra_val);
+	atomic_long_set(&vma->swap_readahead_info,
+			SWAP_RA_VAL(faddr, win, 0));
+	if (win == 1)
+		goto skip;
+
+	/* Read in the direction the faults are moving, or around faddr */
+	if (faddr == prev_faddr + PAGE_SIZE) {
+		start = faddr;
+	} else if (faddr == prev_faddr - PAGE_SIZE) {
+		start = faddr - (win - 1) * PAGE_SIZE;
+	} else {
+		left = (win - 1) / 2;
+		start = faddr - left * PAGE_SIZE;
+	}
+	end = start + win * PAGE_SIZE;
+	/* start may have wrapped below zero */
+	if (start > faddr)
+		start = 0;
+	start = max(start, max(vma->vm_start, faddr & PMD_MASK));
+	if (end < faddr)
+		end = ULONG_MAX;
+	end = min(end, min(vma->vm_end, (faddr & PMD_MASK) + PMD_SIZE));
+
+	pgd = pgd_offset(mm, faddr);
+	if (pgd_none_or_clear_bad(pgd))
+		goto skip;
+	pud = pud_offset(pgd, faddr);
+	if (pud_none_or_clear_bad(pud))
+		goto skip;
+	pmd = pmd_offset(pud, faddr);
+	if (pmd_none_or_clear_bad(pmd))
+		goto skip;
+
+	orig_pte = pte = pte_offset_map(pmd, start);
+	for (addr = start; addr < end; addr += PAGE_SIZE, pte++) {
+		pte_t ptent = *pte;
+		swp_entry_t ra_entry;
+		struct page *page;
+		bool page_was_allocated;
+
+		if (addr == faddr)
+			continue;
+		if (pte_none(ptent) || pte_present(ptent) || pte_file(ptent))
+			continue;
+		ra_entry = pte_to_swp_entry(ptent);
+		if (unlikely(non_swap_entry(ra_entry)))
+			continue;
+		/*
+		 * Reading in may sleep: the page table stays, as we hold
+		 * mmap_sem, but it may no longer be mapped on highmem.
+		 */
+		pte_unmap(orig_pte);
+		page = __read_swap_cache_async(ra_entry, gfp_mask, vma, addr,
+					       &page_was_allocated);
+		orig_pte = pte_offset_map(pmd, start);
+		pte = orig_pte + ((addr - start) >> PAGE_SHIFT);
+		if (!page)
+			continue;
+		if (page_was_allocated) {
+			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+		}
+		page_cache_release(page);
+	}
+	pte_unmap(orig_pte);
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
+	return read_swap_cache_async(entry, gfp_mask, vma, faddr);
+}
@@ -30,6 +30,7 @@
 #include <linux/capability.h>
 #include <linux/syscalls.h>
 #include <linux/memcontrol.h>
+#include <linux/zswap.h>
 
 #include <asm/pgtable.h>
 #include <asm/tlbflush.h>
@@ -198,23 +199,302 @@ static void discard_swap_cluster(struct swap_info_struct *si,
 	}
 }
 
-static int wait_for_discard(void *word)
+#define SWAPFILE_CLUSTER	256
+#define LATENCY_LIMIT		256
+
+static inline void cluster_set_flag(struct swap_cluster_info *info,
+				    unsigned int flag)
 {
-	schedule();
-	return 0;
+	info->flags = flag;
 }
 
-#define SWAPFILE_CLUSTER	256
-#define LATENCY_LIMIT		256
+static inline unsigned int cluster_count(struct swap_cluster_info *info)
+{
+	return info->data;
+}
+
+static inline void cluster_set_count(struct swap_cluster_info *info,
+				     unsigned int c)
+{
+	info->data = c;
+}
+
+static inline void cluster_set_count_flag(struct swap_cluster_info *info,
+					  unsigned int c, unsigned int f)
+{
+	info->flags = f;
+	info->data = c;
+}
+
+static inline unsigned int cluster_next(struct swap_cluster_info *info)
+{
+	return info->data;
+}
+
+static inline void cluster_set_next(struct swap_cluster_info *info,
+				    unsigned int n)
+{
+	info->data = n;
+}
+
+static inline void cluster_set_next_flag(struct swap_cluster_info *info,
+					 unsigned int n, unsigned int f)
+{
+	info->flags = f;
+	info->data = n;
+}
+
+static inline bool cluster_is_free(struct swap_cluster_info *info)
+{
+	return info->flags & CLUSTER_FLAG_FREE;
+}
+
+static inline bool cluster_is_null(struct swap_cluster_info *info)
+{
+	return info->flags & CLUSTER_FLAG_NEXT_NULL;
+}
+
+static inline void cluster_set_null(struct swap_cluster_info *info)
+{
+	info->flags = CLUSTER_FLAG_NEXT_NULL;
+	info->data = 0;
+}
+
+static inline void cluster_list_init(struct swap_cluster_list *list)
+{
+	cluster_set_null(&list->head);
+	cluster_set_null(&list->tail);
+}
+
+static inline bool cluster_list_empty(struct swap_cluster_list *list)
+{
+	return cluster_is_null(&list->head);
+}
+
+static inline unsigned int cluster_list_first(struct swap_cluster_list *list)
+{
+	return cluster_next(&list->head);
+}
+
+static void cluster_list_add_tail(struct swap_cluster_list *list,
+				  struct swap_cluster_info *ci,
+				  unsigned int idx)
+{
+	if (cluster_list_empty(list)) {
+		cluster_set_next_flag(&list->head, idx, 0);
+		cluster_set_next_flag(&list->tail, idx, 0);
+	} else {
+		unsigned int tail = cluster_next(&list->tail);
+
+		cluster_set_next(&ci[tail], idx);
+		cluster_set_next_flag(&list->tail, idx, 0);
+	}
+}
+
+static unsigned int cluster_list_del_first(struct swap_cluster_list *list,
+					   struct swap_cluster_info *ci)
+{
+	unsigned int idx = cluster_next(&list->head);
+
+	if (cluster_next(&list->tail) == idx) {
+		cluster_set_null(&list->head);
+		cluster_set_null(&list->tail);
+	} else
+		cluster_set_next_flag(&list->head, cluster_next(&ci[idx]), 0);
+
+	return idx;
+}
+
+/* Number of slots in cluster idx: the last cluster may be partial */
+static inline unsigned int cluster_nr_slots(struct swap_info_struct *si,
+					    unsigned int idx)
+{
+	return min_t(unsigned long, SWAPFILE_CLUSTER,
+		     si->max - idx * SWAPFILE_CLUSTER);
+}
+
+/*
+ * Discard the clusters queued on the discard list, then make them free:
+ * called with swap_lock held, which is dropped while discarding.
+ */
+static void swap_do_scheduled_discard(struct swap_info_struct *si)
+{
+	struct swap_cluster_info *info = si->cluster_info;
+	unsigned int idx;
+
+	while (!cluster_list_empty(&si->discard_clusters)) {
+		idx = cluster_list_del_first(&si->discard_clusters, info);
+		spin_unlock(&swap_lock);
+
+		discard_swap_cluster(si, idx * SWAPFILE_CLUSTER,
+				     cluster_nr_slots(si, idx));
+
+		spin_lock(&swap_lock);
+		cluster_set_flag(&info[idx], CLUSTER_FLAG_FREE);
+		cluster_list_add_tail(&si->free_clusters, info, idx);
+		memset(si->swap_map + idx * SWAPFILE_CLUSTER,
+		       0, cluster_nr_slots(si, idx));
+	}
+}
+
+static void swap_discard_work(struct work_struct *work)
+{
+	struct swap_info_struct *si;
+
+	si = container_of(work, struct swap_info_struct, discard_work);
+
+	spin_lock(&swap_lock);
+	swap_do_scheduled_discard(si);
+	spin_unlock(&swap_lock);
+}
+
+/*
+ * The last slot of cluster idx was freed: discard the whole cluster before
+ * it is reused, to let the device optimize its wear-levelling.
+ */
+static void swap_cluster_schedule_discard(struct swap_info_struct *si,
+					  unsigned int idx)
+{
+	/*
+	 * Mark the slots used until the discard is done, so that the slot
+	 * by slot search in scan_swap_map() cannot pick them up meanwhile.
+	 */
+	memset(si->swap_map + idx * SWAPFILE_CLUSTER,
+	       SWAP_MAP_BAD, cluster_nr_slots(si, idx));
+	cluster_set_count_flag(&si->cluster_info[idx], 0, 0);
+	cluster_list_add_tail(&si->discard_clusters, si->cluster_info, idx);
+
+	schedule_work(&si->discard_work);
+}
+
+/*
+ * A slot at offset is being allocated: account it to its cluster, taking
+ * the cluster off the free list if this is its first one.
+ */
+static void inc_cluster_info_page(struct swap_info_struct *si,
+				  unsigned long offset)
+{
+	struct swap_cluster_info *info = si->cluster_info;
+	unsigned long idx = offset / SWAPFILE_CLUSTER;
+
+	if (!info)
+		return;
+	if (cluster_is_free(&info[idx])) {
+		VM_BUG_ON(cluster_list_first(&si->free_clusters) != idx);
+		cluster_list_del_first(&si->free_clusters, info);
+		cluster_set_count_flag(&info[idx], 0, 0);
+	}
+
+	VM_BUG_ON(cluster_count(&info[idx]) >= SWAPFILE_CLUSTER);
+	cluster_set_count(&info[idx], cluster_count(&info[idx]) + 1);
+}
+
+/*
+ * The slot at offset is free again: once its cluster is entirely free,
+ * queue the cluster for discard or put it back on the free list.
+ */
+static void dec_cluster_info_page(struct swap_info_struct *si,
+				  unsigned long offset)
+{
+	struct swap_cluster_info *info = si->cluster_info;
+	unsigned long idx = offset / SWAPFILE_CLUSTER;
+
+	if (!info)
+		return;
+
+	VM_BUG_ON(cluster_count(&info[idx]) == 0);
+	cluster_set_count(&info[idx], cluster_count(&info[idx]) - 1);
+	if (cluster_count(&info[idx]))
+		return;
+
+	if ((si->flags & (SWP_WRITEOK | SWP_DISCARDABLE)) ==
+	    (SWP_WRITEOK | SWP_DISCARDABLE)) {
+		swap_cluster_schedule_discard(si, idx);
+		return;
+	}
+	cluster_set_flag(&info[idx], CLUSTER_FLAG_FREE);
+	cluster_list_add_tail(&si->free_clusters, info, idx);
+}
+
+/*
+ * Only the cluster at the head of the free list may be allocated from
+ * (inc_cluster_info_page() takes it off the list): if offset falls into
+ * another free cluster, this cpu has to move on to a new cluster.
+ */
+static bool scan_swap_map_ssd_cluster_conflict(struct swap_info_struct *si,
+					       unsigned long offset)
+{
+	struct percpu_cluster *percpu_cluster;
+	unsigned long idx = offset / SWAPFILE_CLUSTER;
+
+	if (cluster_list_empty(&si->free_clusters) ||
+	    idx == cluster_list_first(&si->free_clusters) ||
+	    !cluster_is_free(&si->cluster_info[idx]))
+		return false;
+
+	percpu_cluster = this_cpu_ptr(si->percpu_cluster);
+	cluster_set_null(&percpu_cluster->index);
+	return true;
+}
+
+/*
+ * Find the next free slot in this cpu's cluster, starting a new cluster
+ * from the free list when it is used up.  Returns false when there is no
+ * free cluster left: the caller falls back to searching slot by slot.
+ */
+static bool scan_swap_map_try_ssd_cluster(struct swap_info_struct *si,
+					  unsigned long *offset,
+					  unsigned long *scan_base)
+{
+	struct percpu_cluster *cluster;
+	unsigned long tmp, max;
+
+new_cluster:
+	cluster = this_cpu_ptr(si->percpu_cluster);
+	if (cluster_is_null(&cluster->index)) {
+		if (!cluster_list_empty(&si->free_clusters)) {
+			cluster->index = si->free_clusters.head;
+			cluster->next = cluster_next(&cluster->index) *
+					SWAPFILE_CLUSTER;
+		} else if (!cluster_list_empty(&si->discard_clusters)) {
+			/*
+			 * No free cluster, but some waiting for discard:
+			 * discard them now rather than fall back to the
+			 * slot by slot search.
+			 */
+			swap_do_scheduled_discard(si);
+			*scan_base = *offset = si->cluster_next;
+			goto new_cluster;
+		} else
+			return false;
+	}
+
+	/*
+	 * Other cpus may allocate from our cluster when they are out of
+	 * free clusters: check that it still has a free slot.
+	 */
+	tmp = cluster->next;
+	max = min_t(unsigned long, si->max,
+		    (cluster_next(&cluster->index) + 1) * SWAPFILE_CLUSTER);
+	while (tmp < max && si->swap_map[tmp])
+		tmp++;
+	if (tmp >= max) {
+		cluster_set_null(&cluster->index);
+		goto new_cluster;
+	}
+	cluster->next = tmp + 1;
+	*offset = tmp;
+	*scan_base = tmp;
+	return true;
+}
 
-static inline unsigned long scan_swap_map(struct swap_info_struct *si,
-					  unsigned char usage)
+static unsigned long scan_swap_map(struct swap_info_struct *si,
+				   unsigned char usage)
 {
 	unsigned long offset;
 	unsigned long scan_base;
 	unsigned long last_in_cluster = 0;
 	int latency_ration = LATENCY_LIMIT;
-	int found_free_cluster = 0;
 
 	/*
 	 * We try to cluster swap pages by allocating them sequentially
@@ -225,41 +505,34 @@ static inline unsigned long scan_swap_map(struct swap_info_struct *si,
 	 * overall disk seek times between swap pages.  -- sct
 	 * But we do now try to find an empty cluster.  -Andrea
 	 * And we let swap pages go all over an SSD partition.  Hugh
+	 *
+	 * On SSD and discardable devices, free clusters are tracked in the
+	 * cluster array instead, and each cpu allocates from a cluster of
+	 * its own, so that cpus neither interleave their writes nor have
+	 * to search for free clusters under swap_lock.
 	 */
 
 	si->flags += SWP_SCANNING;
 	scan_base = offset = si->cluster_next;
 
+	if (si->cluster_info) {
+		if (scan_swap_map_try_ssd_cluster(si, &offset, &scan_base))
+			goto checks;
+		goto scan;
+	}
+
 	if (unlikely(!si->cluster_nr--)) {
 		if (si->pages - si->inuse_pages < SWAPFILE_CLUSTER) {
 			si->cluster_nr = SWAPFILE_CLUSTER - 1;
 			goto checks;
 		}
-		if (si->flags & SWP_DISCARDABLE) {
-			/*
-			 * Start range check on racing allocations, in case
-			 * they overlap the cluster we eventually decide on
-			 * (we scan without swap_lock to allow preemption).
-			 * It's hardly conceivable that cluster_nr could be
-			 * wrapped during our scan, but don't depend on it.
-			 */
-			if (si->lowest_alloc)
-				goto checks;
-			si->lowest_alloc = si->max;
-			si->highest_alloc = 0;
-		}
 		spin_unlock(&swap_lock);
 
 		/*
-		 * If seek is expensive, start searching for new cluster from
+		 * Seek is expensive: start searching for new cluster from
 		 * start of partition, to minimize the span of allocated swap.
-		 * But if seek is cheap, search from our current position, so
-		 * that swap is allocated from all over the partition: if the
-		 * Flash Translation Layer only remaps within limited zones,
-		 * we don't want to wear out the first zone too quickly.
 		 */
-		if (!(si->flags & SWP_SOLIDSTATE))
-			scan_base = offset = si->lowest_bit;
+		scan_base = offset = si->lowest_bit;
 		last_in_cluster = offset + SWAPFILE_CLUSTER - 1;
 
 		/* Locate the first empty (unaligned) cluster */
@@ -271,28 +544,6 @@ static inline unsigned long scan_swap_map(struct swap_info_struct *si,
 				offset -= SWAPFILE_CLUSTER - 1;
 				si->cluster_next = offset;
 				si->cluster_nr = SWAPFILE_CLUSTER - 1;
-				found_free_cluster = 1;
-				goto checks;
-			}
-			if (unlikely(--latency_ration < 0)) {
-				cond_resched();
-				latency_ration = LATENCY_LIMIT;
-			}
-		}
-
-		offset = si->lowest_bit;
-		last_in_cluster = offset + SWAPFILE_CLUSTER - 1;
-
-		/* Locate the first empty (unaligned) cluster */
-		for (; last_in_cluster < scan_base; offset++) {
-			if (si->swap_map[offset])
-				last_in_cluster = offset + SWAPFILE_CLUSTER;
-			else if (offset == last_in_cluster) {
-				spin_lock(&swap_lock);
-				offset -= SWAPFILE_CLUSTER - 1;
-				si->cluster_next = offset;
-				si->cluster_nr = SWAPFILE_CLUSTER - 1;
-				found_free_cluster = 1;
 				goto checks;
 			}
 			if (unlikely(--latency_ration < 0)) {
@@ -304,7 +555,6 @@ static inline unsigned long scan_swap_map(struct swap_info_struct *si,
 		offset = scan_base;
 		spin_lock(&swap_lock);
 		si->cluster_nr = SWAPFILE_CLUSTER - 1;
-		si->lowest_alloc = 0;
 	}
 
 checks:
@@ -315,6 +565,14 @@ checks:
 	if (offset > si->highest_bit)
 		scan_base = offset = si->lowest_bit;
 
+	if (si->cluster_info) {
+		while (scan_swap_map_ssd_cluster_conflict(si, offset)) {
+			if (!scan_swap_map_try_ssd_cluster(si, &offset,
+							   &scan_base))
+				goto scan;
+		}
+	}
+
 	/* reuse swap entry of cache-only swap if not busy. */
 	if (vm_swap_full() && si->swap_map[offset] == SWAP_HAS_CACHE) {
 		int swap_was_freed;
@@ -340,62 +598,10 @@ checks:
 		si->highest_bit = 0;
 	}
 	si->swap_map[offset] = usage;
+	inc_cluster_info_page(si, offset);
 	si->cluster_next = offset + 1;
 	si->flags -= SWP_SCANNING;
 
-	if (si->lowest_alloc) {
-		/*
-		 * Only set when SWP_DISCARDABLE, and there's a scan
-		 * for a free cluster in progress or just completed.
-		 */
-		if (found_free_cluster) {
-			/*
-			 * To optimize wear-levelling, discard the
-			 * old data of the cluster, taking care not to
-			 * discard any of its pages that have already
-			 * been allocated by racing tasks (offset has
-			 * already stepped over any at the beginning).
-			 */
-			if (offset < si->highest_alloc &&
-			    si->lowest_alloc <= last_in_cluster)
-				last_in_cluster = si->lowest_alloc - 1;
-			si->flags |= SWP_DISCARDING;
-			spin_unlock(&swap_lock);
-
-			if (offset < last_in_cluster)
-				discard_swap_cluster(si, offset,
-					last_in_cluster - offset + 1);
-
-			spin_lock(&swap_lock);
-			si->lowest_alloc = 0;
-			si->flags &= ~SWP_DISCARDING;
-
-			smp_mb();	/* wake_up_bit advises this */
-			wake_up_bit(&si->flags, ilog2(SWP_DISCARDING));
-
-		} else if (si->flags & SWP_DISCARDING) {
-			/*
-			 * Delay using pages allocated by racing tasks
-			 * until the whole discard has been issued. We
-			 * could defer that delay until swap_writepage,
-			 * but it's easier to keep this self-contained.
-			 */
-			spin_unlock(&swap_lock);
-			wait_on_bit(&si->flags, ilog2(SWP_DISCARDING),
-				wait_for_discard, TASK_UNINTERRUPTIBLE);
-			spin_lock(&swap_lock);
-		} else {
-			/*
-			 * Note pages allocated by racing tasks while
-			 * scan for a free cluster is in progress, so
-			 * that its final discard can exclude them.
-			 */
-			if (offset < si->lowest_alloc)
-				si->lowest_alloc = offset;
-			if (offset > si->highest_alloc)
-				si->highest_alloc = offset;
-		}
-	}
 	return offset;
 
 scan:
@@ -436,17 +642,24 @@ no_page:
 	return 0;
 }
 
-swp_entry_t get_swap_page(void)
+/*
+ * Allocate up to n swap slots for the swap cache, all from the same swap
+ * area, taking swap_lock only once.  Returns the number allocated.
+ */
+static int get_swap_pages(int n, swp_entry_t swp_entries[])
 {
 	struct swap_info_struct *si;
 	pgoff_t offset;
 	int type, next;
 	int wrapped = 0;
+	int n_ret = 0;
 
 	spin_lock(&swap_lock);
 	if (nr_swap_pages <= 0)
 		goto noswap;
-	nr_swap_pages--;
+	if (n > nr_swap_pages)
+		n = nr_swap_pages;
+	nr_swap_pages -= n;
 
 	for (type = swap_list.next; type >= 0 && wrapped < 2; type = next) {
 		si = swap_info[type];
@@ -464,18 +677,129 @@ swp_entry_t get_swap_page(void)
 
 		swap_list.next = next;
 		/* This is called for allocating swap entry for cache */
-		offset = scan_swap_map(si, SWAP_HAS_CACHE);
-		if (offset) {
-			spin_unlock(&swap_lock);
-			return swp_entry(type, offset);
+		while (n_ret < n) {
+			offset = scan_swap_map(si, SWAP_HAS_CACHE);
+			if (!offset)
+				break;
+			swp_entries[n_ret++] = swp_entry(type, offset);
 		}
+		if (n_ret)
+			break;
 		next = swap_list.next;
 	}
 
-	nr_swap_pages++;
+	nr_swap_pages += n - n_ret;
 noswap:
 	spin_unlock(&swap_lock);
-	return (swp_entry_t) {0};
+	return n_ret;
+}
+
+/*
+ * Per-cpu caches of swap slots, so that swapping out from several cpus at
+ * once does not serialize every allocation on swap_lock: each cpu refills
+ * its cache with a batch of slots allocated under one lock hold, and hands
+ * them out one by one.  Cached slots are reserved (SWAP_HAS_CACHE with no
+ * page) and counted as used; so as not to hide a significant part of the
+ * swap space from the other cpus, the caches are only used while plenty
+ * of swap is free, and drained when it runs low or at swapoff.
+ */
+#define SWAP_SLOTS_CACHE_SIZE	64
+#define SWAP_SLOTS_ACTIVATE	5	/* free swap, in full caches */
+#define SWAP_SLOTS_DEACTIVATE	2
+
+struct swap_slots_cache {
+	struct mutex	alloc_lock;	/* the cpu may be left while refilling */
+	int		nr;		/* slots left in the cache */
+	int		cur;		/* next slot to hand out */
+	swp_entry_t	slots[SWAP_SLOTS_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct swap_slots_cache, swp_slots);
+static bool swap_slots_cache_active;
+static DEFINE_MUTEX(swap_slots_cache_mutex);
+
+static void drain_swap_slots_cpu(unsigned int cpu)
+{
+	struct swap_slots_cache *cache = &per_cpu(swp_slots, cpu);
+
+	mutex_lock(&cache->alloc_lock);
+	while (cache->nr) {
+		swapcache_free(cache->slots[cache->cur++], NULL);
+		cache->nr--;
+	}
+	cache->cur = 0;
+	mutex_unlock(&cache->alloc_lock);
+}
+
+static void drain_swap_slots(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		drain_swap_slots_cpu(cpu);
+}
+
+static bool check_swap_slots_cache(void)
+{
+	long full = num_online_cpus() * SWAP_SLOTS_CACHE_SIZE;
+
+	if (!swap_slots_cache_active) {
+		if (nr_swap_pages > full * SWAP_SLOTS_ACTIVATE)
+			swap_slots_cache_active = true;
+	} else if (nr_swap_pages < full * SWAP_SLOTS_DEACTIVATE) {
+		mutex_lock(&swap_slots_cache_mutex);
+		if (swap_slots_cache_active) {
+			swap_slots_cache_active = false;
+			drain_swap_slots();
+		}
+		mutex_unlock(&swap_slots_cache_mutex);
+	}
+	return swap_slots_cache_active;
+}
+
+static int __cpuinit swap_slots_cpu_callback(struct notifier_block *nfb,
+					     unsigned long action, void *hcpu)
+{
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN)
+		drain_swap_slots_cpu((unsigned long)hcpu);
+	return NOTIFY_OK;
+}
+
+static int __init swap_slots_init(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		mutex_init(&per_cpu(swp_slots, cpu).alloc_lock);
+	hotcpu_notifier(swap_slots_cpu_callback, 0);
+	return 0;
+}
+__initcall(swap_slots_init);
+
+swp_entry_t get_swap_page(void)
+{
+	struct swap_slots_cache *cache;
+	swp_entry_t entry = { 0 };
+
+	if (check_swap_slots_cache()) {
+		cache = &per_cpu(swp_slots, raw_smp_processor_id());
+		mutex_lock(&cache->alloc_lock);
+		if (!cache->nr && swap_slots_cache_active) {
+			cache->cur = 0;
+			cache->nr = get_swap_pages(SWAP_SLOTS_CACHE_SIZE,
+						   cache->slots);
+		}
+		if (cache->nr) {
+			entry = cache->slots[cache->cur++];
+			cache->nr--;
+		}
+		mutex_unlock(&cache->alloc_lock);
+		if (entry.val)
+			return entry;
+	}
+
+	get_swap_pages(1, &entry);
+	return entry;
 }
 
 /* The only caller of this function is now susupend routine */
@@ -583,6 +907,8 @@ static unsigned char swap_entry_free(struct swap_info_struct *p,
 			swap_list.next = p->type;
 		nr_swap_pages++;
 		p->inuse_pages--;
+		dec_cluster_info_page(p, offset);
+		zswap_invalidate_page(p->type, offset);
 	}
 
 	return usage;
@@ -1525,6 +1851,8 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 {
 	struct swap_info_struct *p = NULL;
 	unsigned char *swap_map;
+	struct swap_cluster_info *cluster_info;
+	struct percpu_cluster __percpu *percpu_cluster;
 	struct file *swap_file, *victim;
 	struct address_space *mapping;
 	struct inode *inode;
@@ -1587,6 +1915,13 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	p->flags &= ~SWP_WRITEOK;
 	spin_unlock(&swap_lock);
 
+	/*
+	 * Clusters waiting for discard hold their slots as bad, and cached
+	 * slots hold theirs as swap cache: release both before try_to_unuse.
+	 */
+	flush_work(&p->discard_work);
+	drain_swap_slots();
+
 	current->flags |= PF_OOM_ORIGIN;
 	err = try_to_unuse(type);
 	current->flags &= ~PF_OOM_ORIGIN;
@@ -1639,12 +1974,19 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	p->max = 0;
 	swap_map = p->swap_map;
 	p->swap_map = NULL;
+	cluster_info = p->cluster_info;
+	p->cluster_info = NULL;
+	percpu_cluster = p->percpu_cluster;
+	p->percpu_cluster = NULL;
 	p->flags = 0;
 	spin_unlock(&swap_lock);
 	mutex_unlock(&swapon_mutex);
 	vfree(swap_map);
+	vfree(cluster_info);
+	free_percpu(percpu_cluster);
 	/* Destroy swap account informatin */
 	swap_cgroup_swapoff(type);
+	zswap_invalidate_area(type);
 
 	inode = mapping->host;
 	if (S_ISBLK(inode->i_mode)) {
@@ -1798,6 +2140,8 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	unsigned long maxpages;
 	unsigned long swapfilepages;
 	unsigned char *swap_map = NULL;
+	struct swap_cluster_info *cluster_info = NULL;
+	struct percpu_cluster __percpu *percpu_cluster = NULL;
 	struct page *page = NULL;
 	struct inode *inode = NULL;
 	int did_down = 0;
@@ -2028,6 +2372,42 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 			p->flags |= SWP_DISCARDABLE;
 	}
 
+	cluster_list_init(&p->free_clusters);
+	cluster_list_init(&p->discard_clusters);
+	INIT_WORK(&p->discard_work, swap_discard_work);
+	if (p->flags & (SWP_SOLIDSTATE | SWP_DISCARDABLE)) {
+		unsigned long nr_clusters, idx, j;
+		unsigned int cpu;
+
+		nr_clusters = DIV_ROUND_UP(maxpages, SWAPFILE_CLUSTER);
+		cluster_info = vmalloc(nr_clusters * sizeof(*cluster_info));
+		percpu_cluster = alloc_percpu(struct percpu_cluster);
+		if (!cluster_info || !percpu_cluster) {
+			error = -ENOMEM;
+			goto bad_swap;
+		}
+		memset(cluster_info, 0, nr_clusters * sizeof(*cluster_info));
+		for_each_possible_cpu(cpu)
+			cluster_set_null(&per_cpu_ptr(percpu_cluster,
+						       cpu)->index);
+
+		/* The header page and bad pages are never freed */
+		for (j = 0; j < maxpages; j++) {
+			if (swap_map[j]) {
+				idx = j / SWAPFILE_CLUSTER;
+				cluster_set_count(&cluster_info[idx],
+					cluster_count(&cluster_info[idx]) + 1);
+			}
+		}
+		for (idx = 0; idx < nr_clusters; idx++) {
+			if (cluster_count(&cluster_info[idx]))
+				continue;
+			cluster_set_flag(&cluster_info[idx], CLUSTER_FLAG_FREE);
+			cluster_list_add_tail(&p->free_clusters, cluster_info,
+					      idx);
+		}
+	}
+
 	mutex_lock(&swapon_mutex);
 	spin_lock(&swap_lock);
 	if (swap_flags & SWAP_FLAG_PREFER)
@@ -2036,6 +2416,8 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	else
 		p->prio = --least_priority;
 	p->swap_map = swap_map;
+	p->cluster_info = cluster_info;
+	p->percpu_cluster = percpu_cluster;
 	p->flags |= SWP_WRITEOK;
 	nr_swap_pages += nr_good_pages;
 	total_swap_pages += nr_good_pages;
@@ -2076,6 +2458,8 @@ bad_swap_2:
 	p->flags = 0;
 	spin_unlock(&swap_lock);
 	vfree(swap_map);
+	vfree(cluster_info);
+	free_percpu(percpu_cluster);
 	if (swap_file)
 		filp_close(swap_file, NULL);
 out:
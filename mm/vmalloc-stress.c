@@ -0,0 +1,273 @@
+/*
+ * mm/vmalloc-stress.c
+ *
+ * Stress test for the vmap area allocator.  On load, one thread per
+ * online CPU runs each of the tests below concurrently; every test
+ * writes to and verifies the memory it maps, and the cost per
+ * iteration and any failures are logged.
+ *
+ *  random    - vmalloc()/vfree() of random sizes up to max_pages
+ *  fragment  - fill the space with small areas, free every other one,
+ *              then allocate areas too big for the holes left behind
+ *  align     - vmalloc_user() (SHMLBA aligned) mixed with vmalloc()
+ *  map_ram   - vm_map_ram()/vm_unmap_ram() of small page counts, served
+ *              by the per-cpu vmap blocks
+ *
+ * A non-zero "corrupt" count in the log means a test read back other
+ * data than it wrote, most likely through two overlapping mappings.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/cpu.h>
+#include <linux/bench.h>
+#include <linux/random.h>
+#include <linux/timex.h>
+#include <linux/math64.h>
+
+#include <asm/shmparam.h>
+
+#define FRAGMENT_AREAS	256
+#define MAP_RAM_PAGES	16
+
+static int nr_iterations = 10000;
+module_param(nr_iterations, int, 0444);
+MODULE_PARM_DESC(nr_iterations, "Iterations of each test per CPU");
+
+static int max_pages = 64;
+module_param(max_pages, int, 0444);
+MODULE_PARM_DESC(max_pages, "Largest random vmalloc size, in pages");
+
+struct stress_cpu {
+	int (*test)(struct stress_cpu *sc);
+	cycles_t cycles;
+	unsigned long failed;
+	unsigned long corrupt;
+	unsigned long seed;
+};
+
+static unsigned long stress_random(struct stress_cpu *sc, unsigned long max)
+{
+	sc->seed = sc->seed * 1103515245 + 12345;
+	return (sc->seed >> 8) % max;
+}
+
+/* Touch the first and last byte of every page, and check them back */
+static void stress_fill_check(struct stress_cpu *sc, void *addr,
+			      unsigned long size, int check)
+{
+	unsigned char pattern = (unsigned long)addr >> PAGE_SHIFT;
+	unsigned long off;
+
+	for (off = 0; off < size; off += PAGE_SIZE) {
+		unsigned char *p = addr + off;
+
+		if (!check) {
+			p[0] = pattern;
+			p[PAGE_SIZE - 1] = ~pattern;
+		} else if (p[0] != pattern || p[PAGE_SIZE - 1] !=
+			   (unsigned char)~pattern) {
+			sc->corrupt++;
+			return;
+		}
+	}
+}
+
+static int stress_random_test(struct stress_cpu *sc)
+{
+	unsigned long size;
+	void *p;
+
+	size = (stress_random(sc, max_pages) + 1) << PAGE_SHIFT;
+	p = vmalloc(size);
+	if (!p)
+		return -ENOMEM;
+	stress_fill_check(sc, p, size, 0);
+	stress_fill_check(sc, p, size, 1);
+	vfree(p);
+	return 0;
+}
+
+static int stress_fragment_test(struct stress_cpu *sc)
+{
+	void **areas;
+	int i, err = 0;
+
+	areas = kcalloc(FRAGMENT_AREAS, sizeof(void *), GFP_KERNEL);
+	if (!areas)
+		return -ENOMEM;
+
+	for (i = 0; i < FRAGMENT_AREAS; i++)
+		areas[i] = vmalloc(PAGE_SIZE);
+	for (i = 0; i < FRAGMENT_AREAS; i += 2) {
+		vfree(areas[i]);
+		areas[i] = NULL;
+	}
+	/* Two pages plus guard cannot fit any one-page hole */
+	for (i = 0; i < FRAGMENT_AREAS; i += 2) {
+		areas[i] = vmalloc(2 * PAGE_SIZE);
+		if (!areas[i]) {
+			err = -ENOMEM;
+			continue;
+		}
+		stress_fill_check(sc, areas[i], 2 * PAGE_SIZE, 0);
+	}
+	for (i = 0; i < FRAGMENT_AREAS; i++) {
+		if (!areas[i]) {
+			err = -ENOMEM;
+			continue;
+		}
+		if (!(i & 1))
+			stress_fill_check(sc, areas[i], 2 * PAGE_SIZE, 1);
+		vfree(areas[i]);
+	}
+
+	kfree(areas);
+	return err;
+}
+
+static int stress_align_test(struct stress_cpu *sc)
+{
+	unsigned long size;
+	void *p, *q;
+	int err = 0;
+
+	size = (stress_random(sc, max_pages) + 1) << PAGE_SHIFT;
+	p = vmalloc_user(size);
+	q = vmalloc(PAGE_SIZE);
+	if (!p || !q)
+		err = -ENOMEM;
+	if (p) {
+		if ((unsigned long)p & (SHMLBA - 1))
+			sc->corrupt++;
+		stress_fill_check(sc, p, size, 0);
+		stress_fill_check(sc, p, size, 1);
+		vfree(p);
+	}
+	vfree(q);
+	return err;
+}
+
+static int stress_map_ram_test(struct stress_cpu *sc)
+{
+	struct page *pages[MAP_RAM_PAGES];
+	unsigned int count, i;
+	void *p;
+	int err = 0;
+
+	count = stress_random(sc, MAP_RAM_PAGES) + 1;
+	for (i = 0; i < count; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			err = -ENOMEM;
+			goto out;
+		}
+	}
+
+	p = vm_map_ram(pages, count, -1, PAGE_KERNEL);
+	if (!p) {
+		err = -ENOMEM;
+		goto out;
+	}
+	stress_fill_check(sc, p, count << PAGE_SHIFT, 0);
+	stress_fill_check(sc, p, count << PAGE_SHIFT, 1);
+	vm_unmap_ram(p, count);
+out:
+	while (i--)
+		__free_page(pages[i]);
+	return err;
+}
+
+static void vmalloc_stress_cpu(int cpu, void *data)
+{
+	struct stress_cpu *sc = (struct stress_cpu *)data + cpu;
+	cycles_t start;
+	int i;
+
+	start = get_cycles();
+	for (i = 0; i < nr_iterations; i++) {
+		if (sc->test(sc))
+			sc->failed++;
+		cond_resched();
+	}
+	sc->cycles = get_cycles() - start;
+}
+
+static int vmalloc_stress_run(struct stress_cpu *scs, const char *name,
+			      int (*test)(struct stress_cpu *sc))
+{
+	unsigned long long total = 0;
+	unsigned long failed = 0, corrupt = 0;
+	cpumask_var_t ran;
+	int cpu, nr_cpus;
+
+	if (!alloc_cpumask_var(&ran, GFP_KERNEL))
+		return -ENOMEM;
+
+	for_each_online_cpu(cpu) {
+		struct stress_cpu *sc = &scs[cpu];
+
+		sc->test = test;
+		sc->cycles = 0;
+		sc->failed = 0;
+		sc->corrupt = 0;
+		sc->seed = random32();
+	}
+
+	nr_cpus = bench_on_each_cpu("vmalloc_stress", vmalloc_stress_cpu,
+				    scs, ran);
+	for_each_cpu(cpu, ran) {
+		total += scs[cpu].cycles;
+		failed += scs[cpu].failed;
+		corrupt += scs[cpu].corrupt;
+	}
+	free_cpumask_var(ran);
+
+	if (nr_cpus <= 0)
+		return nr_cpus ? nr_cpus : -ENOMEM;
+	total = div_u64(total, nr_cpus);
+	printk(KERN_INFO "vmalloc-stress: %-8s %llu cycles per iteration "
+	       "on %d cpus, %lu failed, %lu corrupt\n", name,
+	       div_u64(total, max(nr_iterations, 1)), nr_cpus,
+	       failed, corrupt);
+	return 0;
+}
+
+static int __init vmalloc_stress_init(void)
+{
+	struct stress_cpu *scs;
+	int ret;
+
+	if (max_pages < 1)
+		max_pages = 1;
+
+	scs = kcalloc(nr_cpu_ids, sizeof(*scs), GFP_KERNEL);
+	if (!scs)
+		return -ENOMEM;
+
+	get_online_cpus();
+	ret = vmalloc_stress_run(scs, "random", stress_random_test);
+	if (!ret)
+		ret = vmalloc_stress_run(scs, "fragment", stress_fragment_test);
+	if (!ret)
+		ret = vmalloc_stress_run(scs, "align", stress_align_test);
+	if (!ret)
+		ret = vmalloc_stress_run(scs, "map_ram", stress_map_ram_test);
+	put_online_cpus();
+
+	kfree(scs);
+
+	/* Fail the load even when all went well: insmod again to rerun */
+	return ret ? ret : -EAGAIN;
+}
+module_init(vmalloc_stress_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("vmalloc allocator stress test");
@@ -259,6 +259,7 @@ struct vmap_area {
 	struct list_head purge_list;	/* "lazy purge" list */
 	void *private;
 	struct rcu_head rcu_head;
+	unsigned long subtree_max_gap;	/* largest free gap in subtree */
 };
 
 static DEFINE_SPINLOCK(vmap_area_lock);
@@ -285,6 +286,58 @@ static struct vmap_area *__find_vmap_area(unsigned long addr)
 	return NULL;
 }
 
+/*
+ * Each area owns the free gap between the end of the area before it in
+ * address order (or address 0) and its own start, less the guard page
+ * left unmapped after every area to catch overruns.  The rbtree is
+ * augmented with the largest such gap in every subtree, so that
+ * alloc_vmap_area() can skip whole subtrees which cannot fit a request.
+ * Both are maintained under vmap_area_lock.
+ */
+static unsigned long va_gap(struct vmap_area *va)
+{
+	struct vmap_area *prev;
+
+	if (va->list.prev == &vmap_area_list)
+		return va->va_start;
+	prev = list_entry(va->list.prev, struct vmap_area, list);
+	if (va->va_start - prev->va_end < PAGE_SIZE)
+		return 0;
+	return va->va_start - prev->va_end - PAGE_SIZE;
+}
+
+static void vmap_area_augment_cb(struct rb_node *node, void *unused)
+{
+	struct vmap_area *va = rb_entry(node, struct vmap_area, rb_node);
+	unsigned long max_gap = va_gap(va);
+	struct vmap_area *child;
+
+	if (node->rb_left) {
+		child = rb_entry(node->rb_left, struct vmap_area, rb_node);
+		max_gap = max(max_gap, child->subtree_max_gap);
+	}
+	if (node->rb_right) {
+		child = rb_entry(node->rb_right, struct vmap_area, rb_node);
+		max_gap = max(max_gap, child->subtree_max_gap);
+	}
+	va->subtree_max_gap = max_gap;
+}
+
+/*
+ * The gap of the area following an inserted or erased one changes
+ * without any rebalancing: just propagate it up to the root.
+ */
+static void vmap_area_augment_next(struct list_head *next)
+{
+	struct rb_node *node;
+
+	if (next == &vmap_area_list)
+		return;
+	node = &list_entry(next, struct vmap_area, list)->rb_node;
+	for (; node; node = rb_parent(node))
+		vmap_area_augment_cb(node, NULL);
+}
+
 static void __insert_vmap_area(struct vmap_area *va)
 {
 	struct rb_node **p = &vmap_area_root.rb_node;
@@ -315,6 +368,90 @@ static void __insert_vmap_area(struct vmap_area *va)
 		list_add_rcu(&va->list, &prev->list);
 	} else
 		list_add_rcu(&va->list, &vmap_area_list);
+
+	rb_augment_insert(&va->rb_node, vmap_area_augment_cb, NULL);
+	vmap_area_augment_next(va->list.next);
+}
+
+/*
+ * Find the lowest address in [vstart, vend) at which @size bytes aligned
+ * to @align are free.  A subtree whose largest gap is smaller than @size
+ * cannot hold the area and is skipped, as is everything below vstart, so
+ * the search is O(log n) however fragmented the space is.
+ *
+ * Returns vend if there is no room.
+ */
+static unsigned long __find_vmap_hole(unsigned long size, unsigned long align,
+				unsigned long vstart, unsigned long vend)
+{
+	struct rb_node *node = vmap_area_root.rb_node;
+	struct vmap_area *va;
+	unsigned long gap_start, addr;
+
+	if (!node)
+		goto check_highest;
+	va = rb_entry(node, struct vmap_area, rb_node);
+	if (va->subtree_max_gap < size)
+		goto check_highest;
+
+	while (true) {
+		/* Visit left subtree if it looks promising */
+		if (va->va_start > vstart && node->rb_left) {
+			struct vmap_area *left = rb_entry(node->rb_left,
+						struct vmap_area, rb_node);
+			if (left->subtree_max_gap >= size) {
+				node = node->rb_left;
+				va = left;
+				continue;
+			}
+		}
+
+check_current:
+		/* Check the gap just below this area */
+		gap_start = va->va_start - va_gap(va);
+		if (gap_start >= vend)
+			return vend;
+		addr = ALIGN(max(gap_start, vstart), align);
+		if (addr >= vstart && addr + size > addr &&
+		    addr + size <= va->va_start && addr + size <= vend)
+			return addr;
+
+		/* Visit right subtree if it looks promising */
+		if (node->rb_right) {
+			struct vmap_area *right = rb_entry(node->rb_right,
+						struct vmap_area, rb_node);
+			if (right->subtree_max_gap >= size) {
+				node = node->rb_right;
+				va = right;
+				continue;
+			}
+		}
+
+		/* Go back up the tree to the next area in address order */
+		while (true) {
+			struct rb_node *prev = node;
+
+			node = rb_parent(node);
+			if (!node)
+				goto check_highest;
+			if (prev == node->rb_left) {
+				va = rb_entry(node, struct vmap_area, rb_node);
+				goto check_current;
+			}
+		}
+	}
+
+check_highest:
+	/* The gap above the last area is not owned by any node */
+	gap_start = 0;
+	if (!list_empty(&vmap_area_list)) {
+		va = list_entry(vmap_area_list.prev, struct vmap_area, list);
+		gap_start = va->va_end + PAGE_SIZE;
+	}
+	addr = ALIGN(max(gap_start, vstart), align);
+	if (addr >= vstart && addr + size > addr && addr + size <= vend)
+		return addr;
+	return vend;
 }
 
 static void purge_vmap_area_lazy(void);
@@ -329,7 +466,6 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 				int node, gfp_t gfp_mask)
 {
 	struct vmap_area *va;
-	struct rb_node *n;
 	unsigned long addr;
 	int purged = 0;
 
@@ -342,56 +478,9 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 		return ERR_PTR(-ENOMEM);
 
 retry:
-	addr = ALIGN(vstart, align);
-
 	spin_lock(&vmap_area_lock);
-	if (addr + size - 1 < addr)
-		goto overflow;
-
-	/* XXX: could have a last_hole cache */
-	n = vmap_area_root.rb_node;
-	if (n) {
-		struct vmap_area *first = NULL;
-
-		do {
-			struct vmap_area *tmp;
-			tmp = rb_entry(n, struct vmap_area, rb_node);
-			if (tmp->va_end >= addr) {
-				if (!first && tmp->va_start < addr + size)
-					first = tmp;
-				n = n->rb_left;
-			} else {
-				first = tmp;
-				n = n->rb_right;
-			}
-		} while (n);
-
-		if (!first)
-			goto found;
-
-		if (first->va_end < addr) {
-			n = rb_next(&first->rb_node);
-			if (n)
-				first = rb_entry(n, struct vmap_area, rb_node);
-			else
-				goto found;
-		}
-
-		while (addr + size > first->va_start && addr + size <= vend) {
-			addr = ALIGN(first->va_end + PAGE_SIZE, align);
-			if (addr + size - 1 < addr)
-				goto overflow;
-
-			n = rb_next(&first->rb_node);
-			if (n)
-				first = rb_entry(n, struct vmap_area, rb_node);
-			else
-				goto found;
-		}
-	}
-found:
-	if (addr + size > vend) {
-overflow:
+	addr = __find_vmap_hole(size, align, vstart, vend);
+	if (addr == vend) {
 		spin_unlock(&vmap_area_lock);
 		if (!purged) {
 			purge_vmap_area_lazy();
@@ -426,10 +515,17 @@ static void rcu_free_va(struct rcu_head *head)
 
 static void __free_vmap_area(struct vmap_area *va)
 {
+	struct list_head *next = va->list.next;
+	struct rb_node *deepest;
+
 	BUG_ON(RB_EMPTY_NODE(&va->rb_node));
+	deepest = rb_augment_erase_begin(&va->rb_node);
 	rb_erase(&va->rb_node, &vmap_area_root);
 	RB_CLEAR_NODE(&va->rb_node);
 	list_del_rcu(&va->list);
+	rb_augment_erase_end(deepest, vmap_area_augment_cb, NULL);
+	/* The following area's gap now extends down over ours */
+	vmap_area_augment_next(next);
 
 	/*
 	 * Track the highest possible candidate for pcpu area
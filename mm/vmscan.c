@@ -29,6 +29,7 @@
 #include <linux/pagevec.h>
 #include <linux/backing-dev.h>
 #include <linux/rmap.h>
+#include <linux/ksm.h>
 #include <linux/topology.h>
 #include <linux/cpu.h>
 #include <linux/cpuset.h>
@@ -46,6 +47,8 @@
 
 #include <linux/swapops.h>
 
+#include <trace/events/lru.h>
+
 #include "internal.h"
 
 struct scan_control {
@@ -637,6 +640,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		struct address_space *mapping;
 		struct page *page;
 		int may_enter_fs;
+		int lazyfree;
 
 		cond_resched();
 
@@ -691,9 +695,16 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 
 		/*
 		 * Anonymous process memory has backing store?
-		 * Try to allocate it some swap space here.
+		 * Try to allocate it some swap space here.  Not for
+		 * MADV_FREE pages: their contents are not wanted.
 		 */
-		if (PageAnon(page) && !PageSwapCache(page)) {
+		lazyfree = PageAnon(page) && !PageSwapBacked(page);
+		if (lazyfree && PageKsm(page)) {
+			/* Merged by KSM since: other mms want its contents */
+			SetPageSwapBacked(page);
+			lazyfree = 0;
+		}
+		if (PageAnon(page) && !PageSwapCache(page) && !lazyfree) {
 			if (!(sc->gfp_mask & __GFP_IO))
 				goto keep_locked;
 			if (!add_to_swap(page))
@@ -707,7 +718,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		 * The page is mapped into the page tables of one or more
 		 * processes. Try to unmap it here.
 		 */
-		if (page_mapped(page) && mapping) {
+		if (page_mapped(page) && (mapping || lazyfree)) {
 			switch (try_to_unmap(page, TTU_UNMAP)) {
 			case SWAP_FAIL:
 				goto activate_locked;
@@ -720,6 +731,24 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
+		/*
+		 * An unmapped MADV_FREE page that nobody dirtied can be freed
+		 * right away, see __remove_mapping() for the references.
+		 */
+		if (lazyfree) {
+			if (PageDirty(page))
+				goto activate_locked;
+			if (!page_freeze_refs(page, 1))
+				goto keep_locked;
+			if (PageDirty(page)) {
+				page_unfreeze_refs(page, 1);
+				goto keep_locked;
+			}
+			count_vm_event(PGLAZYFREED);
+			__clear_page_locked(page);
+			goto free_it;
+		}
+
 		if (PageDirty(page)) {
 			if (references == PAGEREF_RECLAIM_CLEAN)
 				goto keep_locked;
@@ -823,6 +852,9 @@ activate_locked:
 		/* Not a candidate for swapping, so reclaim swap space. */
 		if (PageSwapCache(page) && vm_swap_full())
 			try_to_free_swap(page);
+		/* A redirtied MADV_FREE page needs its swap backing back */
+		if (PageAnon(page) && !PageSwapBacked(page) && PageDirty(page))
+			SetPageSwapBacked(page);
 		VM_BUG_ON(PageActive(page));
 		SetPageActive(page);
 		pgactivate++;
@@ -945,7 +977,6 @@ static unsigned long isolate_lru_pages(unsigned long nr_to_scan,
 		case -EBUSY:
 			/* else it is being freed elsewhere */
 			list_move(&page->lru, src);
-			mem_cgroup_rotate_lru_list(page, page_lru(page));
 			continue;
 
 		default:
@@ -1007,6 +1038,15 @@ static unsigned long isolate_lru_pages(unsigned long nr_to_scan,
 	return nr_taken;
 }
 
+/* The part of @nr to take from a list of @size pages out of @total */
+static unsigned long lru_share(unsigned long nr, unsigned long size,
+			       unsigned long total)
+{
+	if (!total)
+		return nr;
+	return div64_u64((u64)nr * size + total - 1, total);
+}
+
 static unsigned long isolate_pages_global(unsigned long nr,
 					struct list_head *dst,
 					unsigned long *scanned, int order,
@@ -1014,13 +1054,45 @@ static unsigned long isolate_pages_global(unsigned long nr,
 					struct mem_cgroup *mem_cont,
 					int active, int file)
 {
+	struct mem_cgroup *iter = NULL;
+	unsigned long nr_taken = 0, nr_asked = 0;
+	unsigned long total, left, size, share, this_scanned;
+	struct list_head *src;
 	int lru = LRU_BASE;
+
 	if (active)
 		lru += LRU_ACTIVE;
 	if (file)
 		lru += LRU_FILE;
-	return isolate_lru_pages(nr, &z->lru[lru].list, dst, scanned, order,
-								mode, file);
+
+	/*
+	 * Pages charged to a memcg are on that memcg's own list for the
+	 * zone, the zone's list holds the rest.  Take from each in
+	 * proportion to its size, to age them all as one LRU would.
+	 * The shares are rounded up: no more than @nr in all, and no
+	 * point in walking the memcgs further once that is reached.
+	 */
+	*scanned = 0;
+	total = left = zone_page_state(z, NR_LRU_BASE + lru);
+	while ((src = mem_cgroup_zone_lru_next(z, lru, &iter, &size))) {
+		if (!size)
+			continue;
+		left -= min(left, size);
+		share = min(lru_share(nr, size, total), nr - nr_asked);
+		nr_asked += share;
+		nr_taken += isolate_lru_pages(share, src, dst, &this_scanned,
+					      order, mode, file);
+		*scanned += this_scanned;
+		if (nr_asked == nr) {
+			mem_cgroup_zone_lru_break(iter);
+			return nr_taken;
+		}
+	}
+	share = min(lru_share(nr, left, total), nr - nr_asked);
+	nr_taken += isolate_lru_pages(share, &z->lru[lru].list, dst,
+				      &this_scanned, order, mode, file);
+	*scanned += this_scanned;
+	return nr_taken;
 }
 
 /*
@@ -1166,6 +1238,7 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		int mode = lumpy_reclaim ? ISOLATE_BOTH : ISOLATE_INACTIVE;
 		unsigned long nr_anon;
 		unsigned long nr_file;
+		u64 isolate_start = lru_lock_hold_start();
 
 		nr_taken = sc->isolate_pages(SWAP_CLUSTER_MAX,
 			     &page_list, &nr_scan, sc->order, mode,
@@ -1205,6 +1278,8 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		reclaim_stat->recent_scanned[1] += nr_file;
 
 		spin_unlock_irq(&zone->lru_lock);
+		lru_lock_hold_end(zone, LRU_OP_ISOLATE, nr_taken,
+				  isolate_start);
 
 		nr_scanned += nr_scan;
 		nr_freed = shrink_page_list(&page_list, sc, PAGEOUT_IO_ASYNC);
@@ -1324,8 +1399,7 @@ static void move_active_pages_to_lru(struct zone *zone,
 		VM_BUG_ON(PageLRU(page));
 		SetPageLRU(page);
 
-		list_move(&page->lru, &zone->lru[lru].list);
-		mem_cgroup_add_lru_list(page, lru);
+		list_move(&page->lru, mem_cgroup_add_lru_list(zone, page, lru));
 		pgmoved++;
 
 		if (!pagevec_add(&pvec, page) || list_empty(list)) {
@@ -2728,8 +2802,8 @@ retry:
 		enum lru_list l = page_lru_base_type(page);
 
 		__dec_zone_state(zone, NR_UNEVICTABLE);
-		list_move(&page->lru, &zone->lru[l].list);
-		mem_cgroup_move_lists(page, LRU_UNEVICTABLE, l);
+		list_move(&page->lru,
+			  mem_cgroup_move_lists(zone, page, LRU_UNEVICTABLE, l));
 		__inc_zone_state(zone, NR_INACTIVE_ANON + l);
 		__count_vm_event(UNEVICTABLE_PGRESCUED);
 	} else {
@@ -2737,8 +2811,8 @@ retry:
 		 * rotate unevictable list
 		 */
 		SetPageUnevictable(page);
-		list_move(&page->lru, &zone->lru[LRU_UNEVICTABLE].list);
-		mem_cgroup_rotate_lru_list(page, LRU_UNEVICTABLE);
+		list_move(&page->lru,
+			  mem_cgroup_lru_list(zone, page, LRU_UNEVICTABLE));
 		if (page_evictable(page, NULL))
 			goto retry;
 	}
@@ -2799,22 +2873,12 @@ void scan_mapping_unevictable_pages(struct address_space *mapping)
 
 }
 
-/**
- * scan_zone_unevictable_pages - check unevictable list for evictable pages
- * @zone - zone of which to scan the unevictable list
- *
- * Scan @zone's unevictable LRU lists to check for pages that have become
- * evictable.  Move those that have to @zone's inactive list where they
- * become candidates for reclaim, unless shrink_inactive_zone() decides
- * to reactivate them.  Pages that are still unevictable are rotated
- * back onto @zone's unevictable list.
- */
 #define SCAN_UNEVICTABLE_BATCH_SIZE 16UL /* arbitrary lock hold batch size */
-static void scan_zone_unevictable_pages(struct zone *zone)
+static void scan_lru_unevictable_pages(struct zone *zone,
+				       struct list_head *l_unevictable,
+				       unsigned long nr_to_scan)
 {
-	struct list_head *l_unevictable = &zone->lru[LRU_UNEVICTABLE].list;
 	unsigned long scan;
-	unsigned long nr_to_scan = zone_page_state(zone, NR_UNEVICTABLE);
 
 	while (nr_to_scan > 0) {
 		unsigned long batch_size = min(nr_to_scan,
@@ -2822,7 +2886,11 @@ static void scan_zone_unevictable_pages(struct zone *zone)
 
 		spin_lock_irq(&zone->lru_lock);
 		for (scan = 0;  scan < batch_size; scan++) {
-			struct page *page = lru_to_page(l_unevictable);
+			struct page *page;
+
+			if (list_empty(l_unevictable))
+				break;
+			page = lru_to_page(l_unevictable);
 
 			if (!trylock_page(page))
 				continue;
@@ -2836,10 +2904,40 @@ static void scan_zone_unevictable_pages(struct zone *zone)
 		}
 		spin_unlock_irq(&zone->lru_lock);
 
+		if (scan < batch_size)
+			break;
 		nr_to_scan -= batch_size;
 	}
 }
 
+/**
+ * scan_zone_unevictable_pages - check unevictable list for evictable pages
+ * @zone - zone of which to scan the unevictable list
+ *
+ * Scan @zone's unevictable LRU lists to check for pages that have become
+ * evictable.  Move those that have to @zone's inactive list where they
+ * become candidates for reclaim, unless shrink_inactive_zone() decides
+ * to reactivate them.  Pages that are still unevictable are rotated
+ * back onto @zone's unevictable list.  The unevictable pages charged to
+ * a memcg are on that memcg's own list and are scanned there.
+ */
+static void scan_zone_unevictable_pages(struct zone *zone)
+{
+	unsigned long nr_to_scan = zone_page_state(zone, NR_UNEVICTABLE);
+	struct mem_cgroup *iter = NULL;
+	struct list_head *list;
+	unsigned long size;
+
+	while ((list = mem_cgroup_zone_lru_next(zone, LRU_UNEVICTABLE,
+						&iter, &size))) {
+		size = min(size, nr_to_scan);
+		scan_lru_unevictable_pages(zone, list, size);
+		nr_to_scan -= size;
+	}
+	scan_lru_unevictable_pages(zone, &zone->lru[LRU_UNEVICTABLE].list,
+				   nr_to_scan);
+}
+
 
 /**
  * scan_all_zones_unevictable_pages - scan all unevictable lists for evictable pages
@@ -0,0 +1,631 @@
+/*
+ * zswap: compressed swap cache front-end
+ *
+ * zswap sits in front of whatever swap device is configured and tries
+ * to keep swapped-out pages compressed in RAM instead of writing them
+ * out.  swap_writepage() offers each page to zswap_store() first; when
+ * the page compresses well and the pool has room, the write is complete
+ * without any block I/O.  swap_readpage() asks zswap_load() first, so a
+ * swap-in served from the pool never waits for the device.
+ *
+ * The pool is limited to max_pool_percent of RAM.  When a store finds
+ * it full, the least recently stored entries are decompressed into
+ * freshly allocated swap cache pages and written back to the real swap
+ * device, just as reclaim would have done had zswap not been there.
+ *
+ * Entries live in a per swap type rbtree, keyed by swap offset, and on
+ * a global LRU list in order of storage.  An entry is released when its
+ * swap slot is freed (swap_entry_free), not when it is loaded: a clean
+ * swap cache page may be dropped later without being written again.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/mm.h>
+#include <linux/init.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/rbtree.h>
+#include <linux/percpu.h>
+#include <linux/pagemap.h>
+#include <linux/swap.h>
+#include <linux/swapops.h>
+#include <linux/writeback.h>
+#include <linux/kobject.h>
+#include <linux/lzo.h>
+#include <linux/zswap.h>
+
+/*
+ * Pages compressing to more than this are not worth keeping in RAM:
+ * they go straight to the swap device.
+ */
+#define ZSWAP_MAX_COMPRESSED	(PAGE_SIZE * 3 / 4)
+
+/* Number of LRU entries written back per full-pool store attempt */
+#define ZSWAP_WRITEBACK_BATCH	4
+
+struct zswap_entry {
+	struct rb_node rbnode;
+	struct list_head lru;
+	pgoff_t offset;
+	unsigned type;
+	atomic_t refcount;
+	unsigned int length;	/* compressed length */
+	unsigned char *data;
+};
+
+struct zswap_tree {
+	struct rb_root rbroot;
+	spinlock_t lock;
+};
+
+static struct zswap_tree zswap_trees[MAX_SWAPFILES];
+
+/* Global LRU of stored entries, oldest at the head; nests in tree->lock */
+static LIST_HEAD(zswap_lru);
+static DEFINE_SPINLOCK(zswap_lru_lock);
+
+static struct kmem_cache *zswap_entry_cache;
+
+static DEFINE_PER_CPU(unsigned char *, zswap_dstmem);
+static DEFINE_PER_CPU(void *, zswap_wrkmem);
+
+static int zswap_initialized __read_mostly;
+
+/* Tunables: /sys/kernel/mm/zswap/ */
+static unsigned int zswap_enabled __read_mostly = 1;
+static unsigned int zswap_max_pool_percent __read_mostly = 20;
+
+/* Statistics */
+static atomic_long_t zswap_pool_bytes = ATOMIC_LONG_INIT(0);
+static atomic_long_t zswap_stored_pages = ATOMIC_LONG_INIT(0);
+static unsigned long zswap_loaded_pages;
+static unsigned long zswap_written_back_pages;
+static unsigned long zswap_reject_pool_full;
+static unsigned long zswap_reject_compress_poor;
+static unsigned long zswap_reject_alloc_fail;
+static unsigned long zswap_duplicate_entry;
+
+static bool zswap_pool_full(void)
+{
+	unsigned long limit;
+
+	limit = totalram_pages / 100 * zswap_max_pool_percent;
+	return atomic_long_read(&zswap_pool_bytes) >> PAGE_SHIFT >= limit;
+}
+
+/*
+ * Entry management
+ */
+static struct zswap_entry *zswap_entry_alloc(gfp_t gfp)
+{
+	struct zswap_entry *entry;
+
+	entry = kmem_cache_alloc(zswap_entry_cache, gfp);
+	if (!entry)
+		return NULL;
+	RB_CLEAR_NODE(&entry->rbnode);
+	INIT_LIST_HEAD(&entry->lru);
+	atomic_set(&entry->refcount, 1);
+	return entry;
+}
+
+static void zswap_entry_put(struct zswap_entry *entry)
+{
+	if (!atomic_dec_and_test(&entry->refcount))
+		return;
+	atomic_long_sub(ksize(entry->data), &zswap_pool_bytes);
+	atomic_long_dec(&zswap_stored_pages);
+	kfree(entry->data);
+	kmem_cache_free(zswap_entry_cache, entry);
+}
+
+static struct zswap_entry *zswap_rb_search(struct rb_root *root,
+					   pgoff_t offset)
+{
+	struct rb_node *node = root->rb_node;
+	struct zswap_entry *entry;
+
+	while (node) {
+		entry = rb_entry(node, struct zswap_entry, rbnode);
+		if (offset < entry->offset)
+			node = node->rb_left;
+		else if (offset > entry->offset)
+			node = node->rb_right;
+		else
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * Insert @entry, returning any entry already present for the same
+ * offset in @dupentry instead of inserting.
+ */
+static int zswap_rb_insert(struct rb_root *root, struct zswap_entry *entry,
+			   struct zswap_entry **dupentry)
+{
+	struct rb_node **link = &root->rb_node, *parent = NULL;
+	struct zswap_entry *myentry;
+
+	while (*link) {
+		parent = *link;
+		myentry = rb_entry(parent, struct zswap_entry, rbnode);
+		if (entry->offset < myentry->offset)
+			link = &parent->rb_left;
+		else if (entry->offset > myentry->offset)
+			link = &parent->rb_right;
+		else {
+			*dupentry = myentry;
+			return -EEXIST;
+		}
+	}
+	rb_link_node(&entry->rbnode, parent, link);
+	rb_insert_color(&entry->rbnode, root);
+	return 0;
+}
+
+/*
+ * Unlink @entry from its tree and the LRU, and drop the tree's
+ * reference.  Called with tree->lock held.
+ */
+static void zswap_erase(struct zswap_tree *tree, struct zswap_entry *entry)
+{
+	rb_erase(&entry->rbnode, &tree->rbroot);
+	RB_CLEAR_NODE(&entry->rbnode);
+	spin_lock(&zswap_lru_lock);
+	list_del_init(&entry->lru);
+	spin_unlock(&zswap_lru_lock);
+	zswap_entry_put(entry);
+}
+
+/*
+ * Compression
+ */
+static int zswap_decompress(struct zswap_entry *entry, struct page *page)
+{
+	size_t dlen = PAGE_SIZE;
+	unsigned char *dst;
+	int ret;
+
+	dst = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_decompress_safe(entry->data, entry->length, dst, &dlen);
+	kunmap_atomic(dst, KM_USER0);
+
+	if (unlikely(ret != LZO_E_OK || dlen != PAGE_SIZE)) {
+		printk(KERN_ERR "zswap: decompression failed for %u:%lu\n",
+		       entry->type, entry->offset);
+		return -EIO;
+	}
+	return 0;
+}
+
+/*
+ * Writeback
+ *
+ * To write an entry back we bring it into the swap cache, exactly as
+ * read_swap_cache_async() would, except the data comes from the pool
+ * rather than the device.  Holding SWAP_HAS_CACHE on the slot means it
+ * cannot be freed and reused under us; once the page is in the swap
+ * cache the entry is redundant and can be dropped from the pool.
+ */
+static int zswap_writeback_entry(struct zswap_entry *entry)
+{
+	struct zswap_tree *tree = &zswap_trees[entry->type];
+	swp_entry_t swpentry = swp_entry(entry->type, entry->offset);
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+	};
+	struct page *page;
+	int err;
+
+	page = find_get_page(&swapper_space, swpentry.val);
+	if (page) {
+		/* Already in memory: nothing to gain by writing it */
+		page_cache_release(page);
+		return -EEXIST;
+	}
+
+	page = alloc_page(GFP_NOIO | __GFP_NORETRY | __GFP_NOWARN);
+	if (!page)
+		return -ENOMEM;
+
+	err = swapcache_prepare(swpentry);
+	if (err) {
+		/* -EEXIST: raced with swapin; -ENOENT: slot being freed */
+		page_cache_release(page);
+		return err;
+	}
+
+	__set_page_locked(page);
+	SetPageSwapBacked(page);
+	err = add_to_swap_cache(page, swpentry, GFP_NOIO);
+	if (err) {
+		ClearPageSwapBacked(page);
+		__clear_page_locked(page);
+		swapcache_free(swpentry, NULL);
+		page_cache_release(page);
+		return err;
+	}
+
+	/* The slot may have been freed and reused before we pinned it */
+	spin_lock(&tree->lock);
+	if (zswap_rb_search(&tree->rbroot, entry->offset) != entry) {
+		spin_unlock(&tree->lock);
+		err = -ENOENT;
+		goto fail;
+	}
+	spin_unlock(&tree->lock);
+
+	err = zswap_decompress(entry, page);
+	if (err)
+		goto fail;
+	SetPageUptodate(page);
+
+	spin_lock(&tree->lock);
+	if (zswap_rb_search(&tree->rbroot, entry->offset) == entry)
+		zswap_erase(tree, entry);
+	spin_unlock(&tree->lock);
+
+	lru_cache_add_anon(page);
+	/* Move it to the tail of the inactive list once written */
+	SetPageReclaim(page);
+	__swap_writepage(page, &wbc);
+	page_cache_release(page);
+	zswap_written_back_pages++;
+	return 0;
+
+fail:
+	delete_from_swap_cache(page);
+	unlock_page(page);
+	page_cache_release(page);
+	return err;
+}
+
+/*
+ * Write back up to @nr of the oldest entries.  Returns the number of
+ * entries that left the pool.
+ */
+static int zswap_shrink(int nr)
+{
+	struct zswap_tree *tree;
+	struct zswap_entry *entry;
+	int done = 0;
+
+	while (nr--) {
+		spin_lock(&zswap_lru_lock);
+		if (list_empty(&zswap_lru)) {
+			spin_unlock(&zswap_lru_lock);
+			break;
+		}
+		entry = list_first_entry(&zswap_lru, struct zswap_entry, lru);
+		/* The tree's reference is stable while it is on the LRU */
+		list_del_init(&entry->lru);
+		atomic_inc(&entry->refcount);
+		spin_unlock(&zswap_lru_lock);
+
+		if (zswap_writeback_entry(entry) == 0) {
+			done++;
+		} else {
+			/* Still stored: give it another round */
+			tree = &zswap_trees[entry->type];
+			spin_lock(&tree->lock);
+			if (!RB_EMPTY_NODE(&entry->rbnode)) {
+				spin_lock(&zswap_lru_lock);
+				list_add_tail(&entry->lru, &zswap_lru);
+				spin_unlock(&zswap_lru_lock);
+			}
+			spin_unlock(&tree->lock);
+		}
+		zswap_entry_put(entry);
+	}
+	return done;
+}
+
+/*
+ * Front-end interface
+ */
+int zswap_store(struct page *page)
+{
+	swp_entry_t swpentry = { .val = page_private(page) };
+	unsigned type = swp_type(swpentry);
+	struct zswap_tree *tree = &zswap_trees[type];
+	struct zswap_entry *entry, *dupentry;
+	unsigned char *src, *dst, *data;
+	size_t dlen;
+	int ret;
+
+	if (!zswap_initialized)
+		return -ENODEV;
+	if (!zswap_enabled) {
+		ret = -ENODEV;
+		goto reject;
+	}
+
+	if (zswap_pool_full()) {
+		zswap_shrink(ZSWAP_WRITEBACK_BATCH);
+		if (zswap_pool_full()) {
+			zswap_reject_pool_full++;
+			ret = -ENOMEM;
+			goto reject;
+		}
+	}
+
+	entry = zswap_entry_alloc(GFP_NOIO | __GFP_NOWARN);
+	if (!entry) {
+		zswap_reject_alloc_fail++;
+		ret = -ENOMEM;
+		goto reject;
+	}
+
+	dst = get_cpu_var(zswap_dstmem);
+	src = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, dst, &dlen,
+			       __get_cpu_var(zswap_wrkmem));
+	kunmap_atomic(src, KM_USER0);
+
+	if (unlikely(ret != LZO_E_OK)) {
+		put_cpu_var(zswap_dstmem);
+		zswap_reject_alloc_fail++;
+		goto freeentry;
+	}
+	if (dlen > ZSWAP_MAX_COMPRESSED) {
+		put_cpu_var(zswap_dstmem);
+		zswap_reject_compress_poor++;
+		ret = -E2BIG;
+		goto freeentry;
+	}
+
+	data = kmalloc(dlen, GFP_NOWAIT | __GFP_NORETRY | __GFP_NOWARN |
+			     __GFP_NOMEMALLOC);
+	if (!data) {
+		put_cpu_var(zswap_dstmem);
+		zswap_reject_alloc_fail++;
+		ret = -ENOMEM;
+		goto freeentry;
+	}
+	memcpy(data, dst, dlen);
+	put_cpu_var(zswap_dstmem);
+
+	entry->type = type;
+	entry->offset = swp_offset(swpentry);
+	entry->length = dlen;
+	entry->data = data;
+	atomic_long_add(ksize(data), &zswap_pool_bytes);
+	atomic_long_inc(&zswap_stored_pages);
+
+	spin_lock(&tree->lock);
+	while (zswap_rb_insert(&tree->rbroot, entry, &dupentry) == -EEXIST) {
+		/* The page was redirtied and written again: replace it */
+		zswap_duplicate_entry++;
+		zswap_erase(tree, dupentry);
+	}
+	spin_lock(&zswap_lru_lock);
+	list_add_tail(&entry->lru, &zswap_lru);
+	spin_unlock(&zswap_lru_lock);
+	spin_unlock(&tree->lock);
+
+	return 0;
+
+freeentry:
+	kmem_cache_free(zswap_entry_cache, entry);
+reject:
+	/*
+	 * The page goes to the swap device: an older copy stored here
+	 * would be found by zswap_load() instead of it.
+	 */
+	zswap_invalidate_page(type, swp_offset(swpentry));
+	return ret;
+}
+
+int zswap_load(struct page *page)
+{
+	swp_entry_t swpentry = { .val = page_private(page) };
+	struct zswap_tree *tree = &zswap_trees[swp_type(swpentry)];
+	struct zswap_entry *entry;
+	int ret;
+
+	if (!zswap_initialized)
+		return -ENODEV;
+
+	spin_lock(&tree->lock);
+	entry = zswap_rb_search(&tree->rbroot, swp_offset(swpentry));
+	if (!entry) {
+		spin_unlock(&tree->lock);
+		return -ENOENT;
+	}
+	atomic_inc(&entry->refcount);
+	spin_unlock(&tree->lock);
+
+	ret = zswap_decompress(entry, page);
+	zswap_entry_put(entry);
+	if (!ret)
+		zswap_loaded_pages++;
+	return ret;
+}
+
+/*
+ * Called from swap_entry_free() under swap_lock when the last reference
+ * to a swap slot goes away.
+ */
+void zswap_invalidate_page(unsigned type, pgoff_t offset)
+{
+	struct zswap_tree *tree = &zswap_trees[type];
+	struct zswap_entry *entry;
+
+	if (!zswap_initialized)
+		return;
+
+	spin_lock(&tree->lock);
+	entry = zswap_rb_search(&tree->rbroot, offset);
+	if (entry)
+		zswap_erase(tree, entry);
+	spin_unlock(&tree->lock);
+}
+
+/* Called at swapoff, once try_to_unuse() has brought everything back */
+void zswap_invalidate_area(unsigned type)
+{
+	struct zswap_tree *tree = &zswap_trees[type];
+	struct rb_node *node;
+
+	if (!zswap_initialized)
+		return;
+
+	spin_lock(&tree->lock);
+	while ((node = rb_first(&tree->rbroot)) != NULL)
+		zswap_erase(tree, rb_entry(node, struct zswap_entry, rbnode));
+	spin_unlock(&tree->lock);
+}
+
+#ifdef CONFIG_SYSFS
+/*
+ * This all compiles without CONFIG_SYSFS, but is a waste of space.
+ */
+
+#define ZSWAP_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define ZSWAP_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", zswap_enabled);
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || val > 1)
+		return -EINVAL;
+
+	zswap_enabled = val;
+
+	return count;
+}
+ZSWAP_ATTR(enabled);
+
+static ssize_t max_pool_percent_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", zswap_max_pool_percent);
+}
+
+static ssize_t max_pool_percent_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	unsigned long percent;
+	int err;
+
+	err = strict_strtoul(buf, 10, &percent);
+	if (err || percent > 100)
+		return -EINVAL;
+
+	zswap_max_pool_percent = percent;
+
+	return count;
+}
+ZSWAP_ATTR(max_pool_percent);
+
+static ssize_t pool_pages_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n",
+		       atomic_long_read(&zswap_pool_bytes) >> PAGE_SHIFT);
+}
+ZSWAP_ATTR_RO(pool_pages);
+
+static ssize_t stored_pages_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%ld\n", atomic_long_read(&zswap_stored_pages));
+}
+ZSWAP_ATTR_RO(stored_pages);
+
+#define ZSWAP_STAT_ATTR(_name, _var)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%lu\n", _var);				\
+}									\
+ZSWAP_ATTR_RO(_name)
+
+ZSWAP_STAT_ATTR(loaded_pages, zswap_loaded_pages);
+ZSWAP_STAT_ATTR(written_back_pages, zswap_written_back_pages);
+ZSWAP_STAT_ATTR(reject_pool_full, zswap_reject_pool_full);
+ZSWAP_STAT_ATTR(reject_compress_poor, zswap_reject_compress_poor);
+ZSWAP_STAT_ATTR(reject_alloc_fail, zswap_reject_alloc_fail);
+ZSWAP_STAT_ATTR(duplicate_entry, zswap_duplicate_entry);
+
+static struct attribute *zswap_attrs[] = {
+	&enabled_attr.attr,
+	&max_pool_percent_attr.attr,
+	&pool_pages_attr.attr,
+	&stored_pages_attr.attr,
+	&loaded_pages_attr.attr,
+	&written_back_pages_attr.attr,
+	&reject_pool_full_attr.attr,
+	&reject_compress_poor_attr.attr,
+	&reject_alloc_fail_attr.attr,
+	&duplicate_entry_attr.attr,
+	NULL,
+};
+
+static struct attribute_group zswap_attr_group = {
+	.attrs = zswap_attrs,
+	.name = "zswap",
+};
+#endif /* CONFIG_SYSFS */
+
+static int __init zswap_init(void)
+{
+	int cpu, i;
+
+	zswap_entry_cache = KMEM_CACHE(zswap_entry, 0);
+	if (!zswap_entry_cache)
+		goto fail;
+
+	for_each_possible_cpu(cpu) {
+		unsigned char *dst;
+		void *wrkmem;
+
+		dst = kmalloc(lzo1x_worst_compress(PAGE_SIZE), GFP_KERNEL);
+		wrkmem = kmalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+		per_cpu(zswap_dstmem, cpu) = dst;
+		per_cpu(zswap_wrkmem, cpu) = wrkmem;
+		if (!dst || !wrkmem)
+			goto free_percpu;
+	}
+
+	for (i = 0; i < MAX_SWAPFILES; i++) {
+		zswap_trees[i].rbroot = RB_ROOT;
+		spin_lock_init(&zswap_trees[i].lock);
+	}
+
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &zswap_attr_group))
+		printk(KERN_ERR "zswap: register sysfs failed\n");
+#endif
+	zswap_initialized = 1;
+	return 0;
+
+free_percpu:
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(zswap_dstmem, cpu));
+		kfree(per_cpu(zswap_wrkmem, cpu));
+	}
+	kmem_cache_destroy(zswap_entry_cache);
+fail:
+	printk(KERN_ERR "zswap: initialization failed, disabled\n");
+	return -ENOMEM;
+}
+module_init(zswap_init)
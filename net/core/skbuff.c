@@ -55,6 +55,8 @@
 #include <linux/cache.h>
 #include <linux/rtnetlink.h>
 #include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/percpu.h>
 #include <linux/scatterlist.h>
 #include <linux/errqueue.h>
 
@@ -73,6 +75,54 @@
 static struct kmem_cache *skbuff_head_cache __read_mostly;
 static struct kmem_cache *skbuff_fclone_cache __read_mostly;
 
+/*
+ * Per-cpu cache of skb heads for softirq context, where NAPI polling
+ * allocates and frees them in bursts.  It is refilled and trimmed with
+ * the bulk slab calls, so the slab per-cpu work is paid once per batch
+ * instead of once per packet.  Only code running in softirq context or
+ * with bottom halves disabled touches it, and never from hard irq.
+ */
+#define SKB_HEAD_CACHE_SIZE	64
+#define SKB_HEAD_CACHE_BULK	16
+
+struct skb_head_cache {
+	unsigned int count;
+	void *heads[SKB_HEAD_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct skb_head_cache, skb_head_cache);
+
+static inline bool skb_head_cache_usable(void)
+{
+	return in_softirq() && !in_irq();
+}
+
+static struct sk_buff *skb_head_cache_get(gfp_t gfp_mask)
+{
+	struct skb_head_cache *hc = &__get_cpu_var(skb_head_cache);
+
+	if (unlikely(!hc->count)) {
+		hc->count = kmem_cache_alloc_bulk(skbuff_head_cache, gfp_mask,
+						  SKB_HEAD_CACHE_BULK,
+						  hc->heads);
+		if (unlikely(!hc->count))
+			return NULL;
+	}
+	return hc->heads[--hc->count];
+}
+
+static void skb_head_cache_put(struct sk_buff *skb)
+{
+	struct skb_head_cache *hc = &__get_cpu_var(skb_head_cache);
+
+	if (unlikely(hc->count == SKB_HEAD_CACHE_SIZE)) {
+		hc->count = SKB_HEAD_CACHE_SIZE / 2;
+		kmem_cache_free_bulk(skbuff_head_cache, SKB_HEAD_CACHE_SIZE / 2,
+				     hc->heads + hc->count);
+	}
+	hc->heads[hc->count++] = skb;
+}
+
 static void sock_pipe_buf_release(struct pipe_inode_info *pipe,
 				  struct pipe_buffer *buf)
 {
@@ -180,7 +230,11 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 	cache = fclone ? skbuff_fclone_cache : skbuff_head_cache;
 
 	/* Get the HEAD */
-	skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
+	if (!fclone && skb_head_cache_usable() &&
+	    (node < 0 || node == numa_node_id()))
+		skb = skb_head_cache_get(gfp_mask & ~__GFP_DMA);
+	else
+		skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
 	if (!skb)
 		goto out;
 
@@ -364,7 +418,10 @@ static void kfree_skbmem(struct sk_buff *skb)
 
 	switch (skb->fclone) {
 	case SKB_FCLONE_UNAVAILABLE:
-		kmem_cache_free(skbuff_head_cache, skb);
+		if (skb_head_cache_usable())
+			skb_head_cache_put(skb);
+		else
+			kmem_cache_free(skbuff_head_cache, skb);
 		break;
 
 	case SKB_FCLONE_ORIG:
@@ -2766,6 +2823,20 @@ done:
 }
 EXPORT_SYMBOL_GPL(skb_gro_receive);
 
+static int skb_head_cache_cpu_callback(struct notifier_block *nfb,
+				       unsigned long action, void *hcpu)
+{
+	struct skb_head_cache *hc;
+
+	if (action != CPU_DEAD && action != CPU_DEAD_FROZEN)
+		return NOTIFY_OK;
+
+	hc = &per_cpu(skb_head_cache, (unsigned long)hcpu);
+	kmem_cache_free_bulk(skbuff_head_cache, hc->count, hc->heads);
+	hc->count = 0;
+	return NOTIFY_OK;
+}
+
 void __init skb_init(void)
 {
 	skbuff_head_cache = kmem_cache_create("skbuff_head_cache",
@@ -2779,6 +2850,7 @@ void __init skb_init(void)
 						0,
 						SLAB_HWCACHE_ALIGN|SLAB_PANIC,
 						NULL);
+	hotcpu_notifier(skb_head_cache_cpu_callback, 0);
 }
 
 /**
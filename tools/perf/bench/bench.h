@@ -3,7 +3,14 @@
 
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
+extern int bench_sched_latency(int argc, const char **argv, const char *prefix __used);
+extern int bench_sched_jitter(int argc, const char **argv, const char *prefix __used);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_fault(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_pressure(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_free(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_mmap(int argc, const char **argv, const char *prefix __used);
+extern int bench_futex_hash(int argc, const char **argv, const char *prefix __used);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
@@ -0,0 +1,199 @@
+/*
+ * futex-hash.c
+ *
+ * hash: Futex hash bucket contention
+ *
+ * Every thread of every process repeatedly wakes its own set of futexes,
+ * none of which has waiters, for the given run time: each FUTEX_WAKE is
+ * a lookup in, and a lock of, the hash bucket the futex falls into, so
+ * the rate only depends on how much the threads collide on buckets.  The
+ * run is made with private futexes (FUTEX_PRIVATE_FLAG), which hash into
+ * a table of their process, then with shared ones, which all processes
+ * hash into the global table.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static int		nr_processes	= 1;
+static int		nr_threads	= 0;
+static int		nr_futexes	= 1024;
+static int		runtime		= 5;
+
+static const struct option options[] = {
+	OPT_INTEGER('p', "processes", &nr_processes,
+		    "Specify number of processes"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads per process "
+		    "(default: online cpus)"),
+	OPT_INTEGER('f', "futexes", &nr_futexes,
+		    "Specify number of futexes per thread"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime of each run in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_futex_hash_usage[] = {
+	"perf bench futex hash <options>",
+	NULL
+};
+
+/*
+ * Lives in a shared mapping: the futexes, so that the shared run hashes
+ * them on the shmem inode, and the per-thread operation counts.
+ */
+struct futex_area {
+	volatile int		done;
+	unsigned long long	ops[0];
+};
+
+static struct futex_area *area;
+static unsigned int	*futexes;
+static int		futex_flag;
+static pthread_barrier_t start_barrier;
+
+static void *hash_worker(void *arg)
+{
+	long id = (long)arg;
+	unsigned int *f = &futexes[id * nr_futexes];
+	unsigned long long ops = 0;
+	int i;
+
+	pthread_barrier_wait(&start_barrier);
+
+	while (!area->done) {
+		for (i = 0; i < nr_futexes; i++) {
+			if (syscall(SYS_futex, &f[i], FUTEX_WAKE | futex_flag,
+				    1, NULL, NULL, 0) < 0)
+				die("futex failed: %s\n", strerror(errno));
+		}
+		ops += nr_futexes;
+	}
+
+	area->ops[id] = ops;
+	return NULL;
+}
+
+static void run_process(int process)
+{
+	pthread_t *threads;
+	long i, first = (long)process * nr_threads;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		die("memory allocation failed\n");
+
+	if (pthread_barrier_init(&start_barrier, NULL, nr_threads))
+		die("pthread_barrier_init failed\n");
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, hash_worker,
+				   (void *)(first + i)))
+			die("pthread_create failed\n");
+	}
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_barrier_destroy(&start_barrier);
+	free(threads);
+}
+
+static void run_one(const char *name, int flag)
+{
+	unsigned long long ops = 0;
+	pid_t *pids;
+	int i, nr = nr_processes * nr_threads;
+
+	futex_flag = flag;
+	area->done = 0;
+	memset(area->ops, 0, nr * sizeof(area->ops[0]));
+
+	pids = calloc(nr_processes, sizeof(*pids));
+	if (!pids)
+		die("memory allocation failed\n");
+
+	for (i = 0; i < nr_processes; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			die("fork failed: %s\n", strerror(errno));
+		if (!pids[i]) {
+			run_process(i);
+			exit(0);
+		}
+	}
+
+	sleep(runtime);
+	area->done = 1;
+	for (i = 0; i < nr_processes; i++)
+		waitpid(pids[i], NULL, 0);
+	free(pids);
+
+	for (i = 0; i < nr; i++)
+		ops += area->ops[i];
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %s:\n", name);
+		printf(" %14llu ops/sec\n", ops / runtime);
+		printf(" %14llu ops/sec per thread\n\n", ops / runtime / nr);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %llu\n", name, ops / runtime);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+}
+
+int bench_futex_hash(int argc, const char **argv, const char *prefix __used)
+{
+	size_t size;
+	int nr;
+
+	argc = parse_options(argc, argv, options, bench_futex_hash_usage, 0);
+
+	if (nr_processes <= 0)
+		nr_processes = 1;
+	if (nr_threads <= 0)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_futexes <= 0)
+		nr_futexes = 1;
+	if (runtime <= 0)
+		runtime = 1;
+
+	nr = nr_processes * nr_threads;
+	size = sizeof(*area) + nr * sizeof(area->ops[0]) +
+		(size_t)nr * nr_futexes * sizeof(*futexes);
+	area = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED)
+		die("mmap failed: %s\n", strerror(errno));
+	futexes = (unsigned int *)&area->ops[nr];
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d processes of %d threads, %d futexes per thread, "
+		       "%d sec runs\n\n", nr_processes, nr_threads,
+		       nr_futexes, runtime);
+
+	run_one("private", FUTEX_PRIVATE_FLAG);
+	run_one("shared", 0);
+
+	munmap(area, size);
+	return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * mem-fault.c
+ *
+ * fault: Scalability of anonymous page faults
+ *
+ * Every thread repeatedly maps an anonymous area, writes to each of its
+ * pages and unmaps it again, so that the run is dominated by page faults,
+ * page allocation and (inside a memory cgroup) memcg charging.  With
+ * --cgroup, the run is repeated after moving into the given cgroup, to
+ * compare the fault rate inside and outside of it.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../util/string.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static const char	*size_str	= "16MB";
+static const char	*cgroup		= NULL;
+static int		nr_threads	= 0;
+static int		loops		= 10;
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &size_str, "16MB",
+		    "Specify size of the area each thread faults in. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of loops"),
+	OPT_STRING('c', "cgroup", &cgroup, "dir",
+		    "Repeat the run inside this memory cgroup directory"),
+	OPT_END()
+};
+
+static const char * const bench_mem_fault_usage[] = {
+	"perf bench mem fault <options>",
+	NULL
+};
+
+static size_t		length;
+static long		page_size;
+static pthread_barrier_t start_barrier;
+
+static void *fault_worker(void *arg __used)
+{
+	int i;
+
+	pthread_barrier_wait(&start_barrier);
+
+	for (i = 0; i < loops; i++) {
+		char *p;
+		size_t off;
+
+		p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			die("mmap failed: %s\n", strerror(errno));
+		for (off = 0; off < length; off += page_size)
+			p[off] = 1;
+		munmap(p, length);
+	}
+	return NULL;
+}
+
+/* Returns the rate in faults per second */
+static double run_faults(const char *where)
+{
+	pthread_t *threads;
+	struct timeval start, stop, diff;
+	unsigned long long nr_faults, usecs;
+	int i;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		die("memory allocation failed\n");
+
+	if (pthread_barrier_init(&start_barrier, NULL, nr_threads + 1))
+		die("pthread_barrier_init failed\n");
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, fault_worker, NULL))
+			die("pthread_create failed\n");
+	}
+
+	gettimeofday(&start, NULL);
+	pthread_barrier_wait(&start_barrier);
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	pthread_barrier_destroy(&start_barrier);
+	free(threads);
+
+	nr_faults = (unsigned long long)nr_threads * loops *
+		(length / page_size);
+	usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	if (!usecs)
+		usecs = 1;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %s\n", where);
+		printf(" %14s: %lu.%03lu sec\n", "Total time",
+		       (unsigned long)diff.tv_sec,
+		       (unsigned long)(diff.tv_usec / 1000));
+		printf(" %14lf usecs/fault per thread\n",
+		       (double)usecs * nr_threads / nr_faults);
+		printf(" %14llu faults/sec\n\n", nr_faults * 1000000 / usecs);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu\n", nr_faults * 1000000 / usecs);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return (double)nr_faults * 1000000 / usecs;
+}
+
+static void enter_cgroup(const char *dir)
+{
+	char path[PATH_MAX], pid[32];
+	int fd, len;
+
+	snprintf(path, sizeof(path), "%s/tasks", dir);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		die("cannot open %s: %s\n", path, strerror(errno));
+	/* Threads created from now on inherit the cgroup */
+	len = snprintf(pid, sizeof(pid), "%d\n", getpid());
+	if (write(fd, pid, len) != len)
+		die("cannot move into %s: %s\n", dir, strerror(errno));
+	close(fd);
+}
+
+int bench_mem_fault(int argc, const char **argv,
+		    const char *prefix __used)
+{
+	double outside, inside;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_fault_usage, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	length = (size_t)perf_atoll((char *)size_str);
+	if ((s64)length < page_size) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+	if (nr_threads <= 0)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (loops <= 0)
+		loops = 1;
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		printf("# %d threads faulting in %s, %d times each\n\n",
+		       nr_threads, size_str, loops);
+	}
+
+	outside = run_faults("in the current cgroup");
+	if (!cgroup)
+		return 0;
+
+	enter_cgroup(cgroup);
+	inside = run_faults(cgroup);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		printf(" %14.1lf%% of the fault rate outside the cgroup\n",
+		       inside * 100 / outside);
+	}
+
+	return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * mem-free.c
+ *
+ * free: Cost of handing freed memory back to the kernel
+ *
+ * Every thread runs the loop of a malloc implementation that returns
+ * freed chunks to the kernel: it writes to each page of a chunk of its
+ * heap, as the allocation would be used, then releases the chunk with
+ * madvise().  With MADV_DONTNEED each round trip costs a zap of the page
+ * tables and a zero-filling fault per page; with MADV_FREE the pages stay
+ * mapped unless memory runs short.  Both advices are run and compared.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../util/string.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#ifndef MADV_FREE
+#define MADV_FREE	8
+#endif
+
+static const char	*size_str	= "1MB";
+static int		nr_threads	= 0;
+static int		loops		= 1000;
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &size_str, "1MB",
+		    "Specify size of the chunk each thread allocates and frees. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of malloc/free loops"),
+	OPT_END()
+};
+
+static const char * const bench_mem_free_usage[] = {
+	"perf bench mem free <options>",
+	NULL
+};
+
+static size_t		length;
+static long		page_size;
+static int		advice;
+static pthread_barrier_t start_barrier;
+
+static void *free_worker(void *arg __used)
+{
+	char *p;
+	size_t off;
+	int i;
+
+	p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		die("mmap failed: %s\n", strerror(errno));
+
+	pthread_barrier_wait(&start_barrier);
+
+	for (i = 0; i < loops; i++) {
+		for (off = 0; off < length; off += page_size)
+			p[off] = i;
+		if (madvise(p, length, advice))
+			die("madvise failed: %s\n", strerror(errno));
+	}
+
+	munmap(p, length);
+	return NULL;
+}
+
+static void run_one(const char *name, int adv)
+{
+	struct timeval start, stop, diff;
+	struct rusage ru_start, ru_stop;
+	unsigned long long usecs, nr_loops, faults;
+	pthread_t *threads;
+	int i;
+
+	advice = adv;
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		die("memory allocation failed\n");
+
+	if (pthread_barrier_init(&start_barrier, NULL, nr_threads + 1))
+		die("pthread_barrier_init failed\n");
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, free_worker, NULL))
+			die("pthread_create failed\n");
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	getrusage(RUSAGE_SELF, &ru_start);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	gettimeofday(&stop, NULL);
+	getrusage(RUSAGE_SELF, &ru_stop);
+	timersub(&stop, &start, &diff);
+
+	pthread_barrier_destroy(&start_barrier);
+	free(threads);
+
+	nr_loops = (unsigned long long)nr_threads * loops;
+	usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	if (!usecs)
+		usecs = 1;
+	faults = ru_stop.ru_minflt - ru_start.ru_minflt;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %s:\n", name);
+		printf(" %14s: %lu.%03lu sec\n", "Total time",
+		       (unsigned long)diff.tv_sec,
+		       (unsigned long)(diff.tv_usec / 1000));
+		printf(" %14llu usecs/loop\n", usecs * nr_threads / nr_loops);
+		printf(" %14llu faults/loop\n\n", faults / nr_loops);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %llu %llu\n", name, usecs * nr_threads / nr_loops,
+		       faults / nr_loops);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+}
+
+int bench_mem_free(int argc, const char **argv, const char *prefix __used)
+{
+	argc = parse_options(argc, argv, options, bench_mem_free_usage, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (nr_threads <= 0)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (loops <= 0)
+		loops = 1;
+
+	length = (size_t)perf_atoll((char *)size_str);
+	if ((s64)length <= 0) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+	length = (length + page_size - 1) / page_size * page_size;
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d threads, %zu KB chunks, %d loops\n\n",
+		       nr_threads, length >> 10, loops);
+
+	run_one("MADV_DONTNEED", MADV_DONTNEED);
+	run_one("MADV_FREE", MADV_FREE);
+
+	return 0;
+}
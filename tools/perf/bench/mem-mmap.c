@@ -0,0 +1,220 @@
+/*
+ * mem-mmap.c
+ *
+ * mmap: mmap_sem contention between page faults and mmap/munmap
+ *
+ * Fault threads keep faulting in their own part of a shared anonymous
+ * area and dropping it again with MADV_DONTNEED, taking mmap_sem for
+ * reading, while mapper threads of the same process keep mapping,
+ * touching and unmapping a small area, taking it for writing.  With
+ * --compare, the run is repeated with the OWNER_SPIN scheduler feature
+ * turned off (writers of a rw_semaphore, like mutexes, then sleep as
+ * soon as the lock is taken instead of spinning while its owner runs),
+ * which needs a kernel with CONFIG_SCHED_DEBUG and debugfs mounted.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../util/string.h"
+#include "../util/debugfs.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+static const char	*size_str	= "64MB";
+static int		nr_faulters	= 0;
+static int		nr_mappers	= 0;
+static int		runtime		= 5;
+static bool		compare		= false;
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &size_str, "64MB",
+		    "Specify size of the area the fault threads share. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('t', "threads", &nr_faulters,
+		    "Specify number of fault threads (default: online cpus)"),
+	OPT_INTEGER('m', "mappers", &nr_mappers,
+		    "Specify number of mmap/munmap threads "
+		    "(default: half the online cpus)"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime of each run in seconds"),
+	OPT_BOOLEAN('c', "compare", &compare,
+		    "Repeat the run without owner spinning (NO_OWNER_SPIN)"),
+	OPT_END()
+};
+
+static const char * const bench_mem_mmap_usage[] = {
+	"perf bench mem mmap <options>",
+	NULL
+};
+
+static char		*area;
+static size_t		length;
+static long		page_size;
+static volatile int	done;
+static pthread_barrier_t start_barrier;
+
+struct worker {
+	pthread_t		thread;
+	long			id;
+	unsigned long long	ops;
+};
+
+static void *fault_worker(void *arg)
+{
+	struct worker *w = arg;
+	size_t slice = length / nr_faulters / page_size * page_size;
+	char *p = area + w->id * slice;
+	size_t off;
+
+	pthread_barrier_wait(&start_barrier);
+
+	while (!done) {
+		for (off = 0; off < slice; off += page_size)
+			p[off] = 1;
+		if (madvise(p, slice, MADV_DONTNEED))
+			die("madvise failed: %s\n", strerror(errno));
+		w->ops += slice / page_size;
+	}
+	return NULL;
+}
+
+static void *mmap_worker(void *arg)
+{
+	struct worker *w = arg;
+	size_t len = 4 * page_size;
+	char *p;
+
+	pthread_barrier_wait(&start_barrier);
+
+	while (!done) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			die("mmap failed: %s\n", strerror(errno));
+		p[0] = 1;
+		munmap(p, len);
+		w->ops++;
+	}
+	return NULL;
+}
+
+static void run_one(const char *name)
+{
+	int i, nr = nr_faulters + nr_mappers;
+	unsigned long long faults = 0, maps = 0;
+	struct worker *workers;
+
+	workers = calloc(nr, sizeof(*workers));
+	if (!workers)
+		die("memory allocation failed\n");
+
+	done = 0;
+	if (pthread_barrier_init(&start_barrier, NULL, nr + 1))
+		die("pthread_barrier_init failed\n");
+	for (i = 0; i < nr; i++) {
+		workers[i].id = i;
+		if (pthread_create(&workers[i].thread, NULL,
+				   i < nr_faulters ? fault_worker : mmap_worker,
+				   &workers[i]))
+			die("pthread_create failed\n");
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	sleep(runtime);
+	done = 1;
+	for (i = 0; i < nr; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (i < nr_faulters)
+			faults += workers[i].ops;
+		else
+			maps += workers[i].ops;
+	}
+
+	pthread_barrier_destroy(&start_barrier);
+	free(workers);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %s:\n", name);
+		printf(" %14llu faults/sec\n", faults / runtime);
+		printf(" %14llu mmap+munmap/sec\n\n", maps / runtime);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %llu %llu\n", name, faults / runtime,
+		       maps / runtime);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+}
+
+static void set_sched_feature(const char *feat)
+{
+	char path[PATH_MAX];
+	const char *debugfs = debugfs_find_mountpoint();
+	int fd;
+
+	if (!debugfs)
+		die("debugfs is not mounted\n");
+	snprintf(path, sizeof(path), "%s/sched_features", debugfs);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		die("cannot open %s: %s\n", path, strerror(errno));
+	if (write(fd, feat, strlen(feat)) < 0)
+		die("cannot set %s: %s\n", feat, strerror(errno));
+	close(fd);
+}
+
+int bench_mem_mmap(int argc, const char **argv,
+		   const char *prefix __used)
+{
+	long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_mmap_usage, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (nr_faulters <= 0)
+		nr_faulters = nr_cpus;
+	if (nr_mappers <= 0)
+		nr_mappers = nr_cpus > 1 ? nr_cpus / 2 : 1;
+	if (runtime <= 0)
+		runtime = 1;
+	length = (size_t)perf_atoll((char *)size_str);
+	if ((s64)length < (s64)page_size * nr_faulters) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+
+	area = mmap(NULL, length, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED)
+		die("mmap failed: %s\n", strerror(errno));
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d fault threads in %s, %d mmap/munmap threads, "
+		       "%d sec runs\n\n", nr_faulters, size_str, nr_mappers,
+		       runtime);
+
+	run_one("default");
+	if (compare) {
+		set_sched_feature("NO_OWNER_SPIN");
+		run_one("NO_OWNER_SPIN");
+		set_sched_feature("OWNER_SPIN");
+	}
+
+	munmap(area, length);
+	return 0;
+}
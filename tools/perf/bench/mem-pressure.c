@@ -0,0 +1,184 @@
+/*
+ * mem-pressure.c
+ *
+ * pressure: Swap throughput under memory pressure
+ *
+ * Every thread dirties its share of an anonymous area larger than the
+ * memory available to it, in repeated passes, so that each pass has to
+ * swap out what the previous one touched and swap it back in.  The rate
+ * of pages touched and the swap traffic from /proc/vmstat are reported:
+ * run it with several threads against a fast swap device to stress swap
+ * slot allocation and freeing.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../util/string.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static const char	*size_str	= NULL;
+static int		nr_threads	= 0;
+static int		loops		= 3;
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &size_str, "1GB",
+		    "Specify total size of the area touched by all threads "
+		    "(default: 1.5 times the physical memory). "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of passes over the area"),
+	OPT_END()
+};
+
+static const char * const bench_mem_pressure_usage[] = {
+	"perf bench mem pressure <options>",
+	NULL
+};
+
+static size_t		length;		/* per thread */
+static long		page_size;
+static pthread_barrier_t start_barrier;
+
+static void *pressure_worker(void *arg __used)
+{
+	char *p;
+	size_t off;
+	int i;
+
+	p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED)
+		die("mmap failed: %s\n", strerror(errno));
+
+	pthread_barrier_wait(&start_barrier);
+
+	for (i = 0; i < loops; i++) {
+		for (off = 0; off < length; off += page_size)
+			p[off]++;
+	}
+
+	munmap(p, length);
+	return NULL;
+}
+
+static void read_swap_stats(unsigned long long *pswpin,
+			    unsigned long long *pswpout)
+{
+	char name[64];
+	unsigned long long val;
+	FILE *f;
+
+	*pswpin = *pswpout = 0;
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return;
+	while (fscanf(f, "%63s %llu", name, &val) == 2) {
+		if (!strcmp(name, "pswpin"))
+			*pswpin = val;
+		else if (!strcmp(name, "pswpout"))
+			*pswpout = val;
+	}
+	fclose(f);
+}
+
+int bench_mem_pressure(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	unsigned long long in_start, out_start, in_stop, out_stop;
+	unsigned long long nr_pages, usecs;
+	struct timeval start, stop, diff;
+	pthread_t *threads;
+	size_t total;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_pressure_usage, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (nr_threads <= 0)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (loops <= 0)
+		loops = 1;
+
+	if (size_str) {
+		total = (size_t)perf_atoll((char *)size_str);
+	} else {
+		total = (size_t)sysconf(_SC_PHYS_PAGES) * page_size;
+		total += total / 2;
+	}
+	length = total / nr_threads / page_size * page_size;
+	if ((s64)total <= 0 || !length) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		die("memory allocation failed\n");
+
+	if (pthread_barrier_init(&start_barrier, NULL, nr_threads + 1))
+		die("pthread_barrier_init failed\n");
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, pressure_worker, NULL))
+			die("pthread_create failed\n");
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	read_swap_stats(&in_start, &out_start);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	gettimeofday(&stop, NULL);
+	read_swap_stats(&in_stop, &out_stop);
+	timersub(&stop, &start, &diff);
+
+	pthread_barrier_destroy(&start_barrier);
+	free(threads);
+
+	nr_pages = (unsigned long long)nr_threads * loops *
+		(length / page_size);
+	usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	if (!usecs)
+		usecs = 1;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads touching %llu MB in total, %d passes\n\n",
+		       nr_threads, (unsigned long long)length * nr_threads >> 20,
+		       loops);
+		printf(" %14s: %lu.%03lu sec\n", "Total time",
+		       (unsigned long)diff.tv_sec,
+		       (unsigned long)(diff.tv_usec / 1000));
+		printf(" %14llu pages/sec\n", nr_pages * 1000000 / usecs);
+		printf(" %14llu pages swapped in (%llu/sec)\n",
+		       in_stop - in_start,
+		       (in_stop - in_start) * 1000000 / usecs);
+		printf(" %14llu pages swapped out (%llu/sec)\n",
+		       out_stop - out_start,
+		       (out_stop - out_start) * 1000000 / usecs);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu %llu %llu\n", nr_pages * 1000000 / usecs,
+		       in_stop - in_start, out_stop - out_start);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * sched-jitter.c
+ *
+ * jitter: Interruptions seen by a task spinning alone on a cpu
+ *
+ * The benchmark binds itself to one cpu, typically one of the nohz_full=
+ * cpus, and spins reading the clock for the given run time: every gap
+ * between two reads longer than the threshold is time the cpu was taken
+ * away from it, by an interrupt or another task.  The interrupts the cpu
+ * took over the run, all of them and the local timer ones, are counted
+ * from /proc/interrupts.  With full dynticks, a cpu left to a single task
+ * should be down to a handful of interrupts per second.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+static int		cpu		= -1;
+static int		runtime		= 5;
+static int		threshold	= 5;
+
+static const struct option options[] = {
+	OPT_INTEGER('C', "cpu", &cpu,
+		    "Specify the cpu to run on (default: the last online one)"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime in seconds"),
+	OPT_INTEGER('t', "threshold", &threshold,
+		    "Specify the shortest gap counted, in usecs"),
+	OPT_END()
+};
+
+static const char * const bench_sched_jitter_usage[] = {
+	"perf bench sched jitter <options>",
+	NULL
+};
+
+struct irq_counts {
+	unsigned long long	total;
+	unsigned long long	timer;
+};
+
+/* The interrupts taken by the cpu so far, from its /proc/interrupts column */
+static void read_irq_counts(struct irq_counts *counts)
+{
+	char line[8192], *p, *end, *tok;
+	unsigned long long val = 0;
+	int col = -1, nr_cols = 0, i;
+	FILE *file;
+
+	file = fopen("/proc/interrupts", "r");
+	if (!file)
+		die("can't open /proc/interrupts: %s\n", strerror(errno));
+
+	if (!fgets(line, sizeof(line), file))
+		die("can't read /proc/interrupts\n");
+	for (tok = strtok(line, " \t\n"); tok; tok = strtok(NULL, " \t\n")) {
+		if (!strncmp(tok, "CPU", 3) && atoi(tok + 3) == cpu)
+			col = nr_cols;
+		nr_cols++;
+	}
+	if (col < 0)
+		die("cpu %d not found in /proc/interrupts\n", cpu);
+
+	counts->total = counts->timer = 0;
+	while (fgets(line, sizeof(line), file)) {
+		p = strchr(line, ':');
+		if (!p)
+			continue;
+		*p++ = '\0';
+
+		/* Rows like ERR: have a single count, not one per cpu */
+		for (i = 0; i <= col; i++) {
+			val = strtoull(p, &end, 10);
+			if (end == p)
+				break;
+			p = end;
+		}
+		if (i <= col)
+			continue;
+
+		counts->total += val;
+		if (!strcmp(line + strspn(line, " "), "LOC"))
+			counts->timer = val;
+	}
+
+	fclose(file);
+}
+
+static unsigned long long now_nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int bench_sched_jitter(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	unsigned long long start, prev, now, gap, end;
+	unsigned long long nr_gaps = 0, lost = 0, max = 0;
+	struct irq_counts before, after;
+	cpu_set_t mask;
+	double secs;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_jitter_usage, 0);
+
+	if (cpu < 0)
+		cpu = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	if (runtime <= 0)
+		runtime = 1;
+	if (threshold <= 0)
+		threshold = 1;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask))
+		die("can't bind to cpu %d: %s\n", cpu, strerror(errno));
+
+	read_irq_counts(&before);
+
+	start = prev = now_nsecs();
+	end = start + runtime * 1000000000ULL;
+	do {
+		now = now_nsecs();
+		gap = now - prev;
+		if (gap >= threshold * 1000ULL) {
+			nr_gaps++;
+			lost += gap;
+			if (gap > max)
+				max = gap;
+		}
+		prev = now;
+	} while (now < end);
+
+	read_irq_counts(&after);
+
+	secs = (double)(now - start) / 1e9;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Spinning on cpu %d for %d secs, "
+		       "counting gaps of %d usecs or more\n\n",
+		       cpu, runtime, threshold);
+		printf(" %14.1f interrupts/sec\n",
+		       (after.total - before.total) / secs);
+		printf(" %14.1f local timer interrupts/sec\n",
+		       (after.timer - before.timer) / secs);
+		printf(" %14.1f gaps/sec\n", nr_gaps / secs);
+		printf(" %14llu usecs longest gap\n", max / 1000);
+		printf(" %14.4f %% of the time lost\n",
+		       100.0 * lost / (now - start));
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.1f %.1f %.1f %llu\n",
+		       (after.total - before.total) / secs,
+		       (after.timer - before.timer) / secs,
+		       nr_gaps / secs, max / 1000);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * sched-latency.c
+ *
+ * latency: Wakeup latency of an interactive task next to a parallel build
+ *
+ * A number of cpu burning jobs, as a "make -j" would run, are started and
+ * the benchmark itself acts as the interactive task: it sleeps for a short
+ * interval in a loop and measures how late it gets to run again.  The run
+ * is made once with the jobs in the session of the benchmark and once with
+ * the jobs in a session of their own, as a build started from another
+ * terminal would be: with automatic task groups (CONFIG_SCHED_AUTOGROUP)
+ * the latter only competes with the benchmark as a single group.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static int		nr_jobs		= 0;
+static int		runtime		= 5;
+static int		interval	= 10;
+
+static const struct option options[] = {
+	OPT_INTEGER('j', "jobs", &nr_jobs,
+		    "Specify number of cpu burning jobs "
+		    "(default: twice the online cpus)"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime of each run in seconds"),
+	OPT_INTEGER('i', "interval", &interval,
+		    "Specify sleep interval of the interactive task in msecs"),
+	OPT_END()
+};
+
+static const char * const bench_sched_latency_usage[] = {
+	"perf bench sched latency <options>",
+	NULL
+};
+
+static unsigned long long ts_to_usecs(struct timespec *ts)
+{
+	return ts->tv_sec * 1000000ULL + ts->tv_nsec / 1000;
+}
+
+static void burn(void)
+{
+	volatile unsigned long x = 0;
+
+	for (;;)
+		x++;
+}
+
+static void start_jobs(void)
+{
+	int i;
+
+	for (i = 0; i < nr_jobs; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			die("fork failed: %s\n", strerror(errno));
+		if (!pid)
+			burn();
+	}
+}
+
+static void run_one(const char *name, int new_session)
+{
+	unsigned long long start, before, after, late, total = 0, max = 0;
+	struct timespec ts, sleep_ts;
+	unsigned long nr = 0;
+	pid_t leader;
+
+	/*
+	 * The jobs are started by a leader process, in its own process
+	 * group so that they can all be killed at once, and in a session
+	 * of its own if asked to.
+	 */
+	leader = fork();
+	if (leader < 0)
+		die("fork failed: %s\n", strerror(errno));
+	if (!leader) {
+		if (new_session ? setsid() < 0 : setpgid(0, 0) < 0)
+			die("setsid failed: %s\n", strerror(errno));
+		start_jobs();
+		for (;;)
+			pause();
+	}
+
+	sleep_ts.tv_sec = interval / 1000;
+	sleep_ts.tv_nsec = (interval % 1000) * 1000000L;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	start = ts_to_usecs(&ts);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		before = ts_to_usecs(&ts);
+		nanosleep(&sleep_ts, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		after = ts_to_usecs(&ts);
+
+		late = after - before - interval * 1000ULL;
+		if ((long long)late < 0)
+			late = 0;
+		total += late;
+		if (late > max)
+			max = late;
+		nr++;
+	} while (after - start < runtime * 1000000ULL);
+
+	kill(-leader, SIGKILL);
+	waitpid(leader, NULL, 0);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %s:\n", name);
+		printf(" %14llu usecs average wakeup latency\n", total / nr);
+		printf(" %14llu usecs maximum wakeup latency\n\n", max);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %llu %llu\n", name, total / nr, max);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+}
+
+int bench_sched_latency(int argc, const char **argv,
+			const char *prefix __used)
+{
+	argc = parse_options(argc, argv, options,
+			     bench_sched_latency_usage, 0);
+
+	if (nr_jobs <= 0)
+		nr_jobs = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	if (runtime <= 0)
+		runtime = 1;
+	if (interval <= 0)
+		interval = 1;
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d cpu burning jobs, %d msecs sleeps, %d sec runs\n\n",
+		       nr_jobs, interval, runtime);
+
+	run_one("same session", 0);
+	run_one("own session", 1);
+
+	return 0;
+}
@@ -28,6 +28,7 @@
 #include <sys/time.h>
 #include <sys/poll.h>
 #include <limits.h>
+#include <sched.h>
 
 #define DATASIZE 100
 
@@ -35,6 +36,8 @@ static int use_pipes = 0;
 static unsigned int loops = 100;
 static unsigned int thread_mode = 0;
 static unsigned int num_groups = 10;
+static int cross_socket = 0;
+static cpu_set_t sender_cpus, receiver_cpus;
 
 struct sender_context {
 	unsigned int num_fds;
@@ -140,7 +143,61 @@ again:
 	return NULL;
 }
 
-static pthread_t create_worker(void *ctx, void *(*func)(void *))
+/* Physical package of a cpu, or -1 if it is offline */
+static int cpu_package(int cpu)
+{
+	char path[PATH_MAX];
+	FILE *file;
+	int pkg;
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+		 cpu);
+	file = fopen(path, "r");
+	if (!file)
+		return -1;
+	if (fscanf(file, "%d", &pkg) != 1)
+		pkg = -1;
+	fclose(file);
+
+	return pkg;
+}
+
+/*
+ * Senders go to the package of the first online cpu, receivers to all
+ * the others, so that every message crosses a socket.
+ */
+static int split_sockets(void)
+{
+	int cpu, pkg, first = -1;
+	int nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+	CPU_ZERO(&sender_cpus);
+	CPU_ZERO(&receiver_cpus);
+
+	for (cpu = 0; cpu < nr_cpus && cpu < CPU_SETSIZE; cpu++) {
+		pkg = cpu_package(cpu);
+		if (pkg < 0)
+			continue;
+		if (first < 0)
+			first = pkg;
+		if (pkg == first)
+			CPU_SET(cpu, &sender_cpus);
+		else
+			CPU_SET(cpu, &receiver_cpus);
+	}
+
+	if (!CPU_COUNT(&receiver_cpus)) {
+		fprintf(stderr, "Only one cpu package online, "
+			"can't run a cross socket test\n");
+		exit(1);
+	}
+
+	return first;
+}
+
+static pthread_t create_worker(void *ctx, void *(*func)(void *),
+			       cpu_set_t *cpus)
 {
 	pthread_attr_t attr;
 	pthread_t childid;
@@ -154,6 +211,8 @@ static pthread_t create_worker(void *ctx, void *(*func)(void *))
 			barf("fork()");
 			break;
 		case 0:
+			if (cpus && sched_setaffinity(0, sizeof(*cpus), cpus))
+				barf("sched_setaffinity()");
 			(*func) (ctx);
 			exit(0);
 			break;
@@ -172,6 +231,9 @@ static pthread_t create_worker(void *ctx, void *(*func)(void *))
 		barf("pthread_attr_setstacksize");
 #endif
 
+	if (cpus && pthread_attr_setaffinity_np(&attr, sizeof(*cpus), cpus))
+		barf("pthread_attr_setaffinity_np");
+
 	err = pthread_create(&childid, &attr, func, ctx);
 	if (err != 0) {
 		fprintf(stderr, "pthread_create failed: %s (%d)\n",
@@ -226,7 +288,8 @@ static unsigned int group(pthread_t *pth,
 		ctx->ready_out = ready_out;
 		ctx->wakefd = wakefd;
 
-		pth[i] = create_worker(ctx, (void *)receiver);
+		pth[i] = create_worker(ctx, (void *)receiver,
+				       cross_socket ? &receiver_cpus : NULL);
 
 		snd_ctx->out_fds[i] = fds[1];
 		if (!thread_mode)
@@ -239,7 +302,8 @@ static unsigned int group(pthread_t *pth,
 		snd_ctx->wakefd = wakefd;
 		snd_ctx->num_fds = num_fds;
 
-		pth[num_fds+i] = create_worker(snd_ctx, (void *)sender);
+		pth[num_fds+i] = create_worker(snd_ctx, (void *)sender,
+				       cross_socket ? &sender_cpus : NULL);
 	}
 
 	/* Close the fds we have left */
@@ -260,6 +324,8 @@ static const struct option options[] = {
 		    "Specify number of groups"),
 	OPT_INTEGER('l', "loop", &loops,
 		    "Specify number of loops"),
+	OPT_BOOLEAN('x', "cross-socket", &cross_socket,
+		    "Keep senders and receivers on different cpu packages"),
 	OPT_END()
 };
 
@@ -277,10 +343,14 @@ int bench_sched_messaging(int argc, const char **argv,
 	int readyfds[2], wakefds[2];
 	char dummy;
 	pthread_t *pth_tab;
+	int sender_pkg = -1;
 
 	argc = parse_options(argc, argv, options,
 			     bench_sched_message_usage, 0);
 
+	if (cross_socket)
+		sender_pkg = split_sockets();
+
 	pth_tab = malloc(num_fds * 2 * num_groups * sizeof(pthread_t));
 	if (!pth_tab)
 		barf("main:malloc()");
@@ -316,6 +386,9 @@ int bench_sched_messaging(int argc, const char **argv,
 	case BENCH_FORMAT_DEFAULT:
 		printf("# %d sender and receiver %s per group\n",
 		       num_fds, thread_mode ? "threads" : "processes");
+		if (cross_socket)
+			printf("# senders on cpu package %d, receivers on "
+			       "the others\n", sender_pkg);
 		printf("# %d groups == %d %s run\n\n",
 		       num_groups, num_groups * 2 * num_fds,
 		       thread_mode ? "threads" : "processes");
@@ -27,13 +27,17 @@
 #include <assert.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sched.h>
 
 #define LOOPS_DEFAULT 1000000
 static int loops = LOOPS_DEFAULT;
+static const char *cpu_list;
 
 static const struct option options[] = {
 	OPT_INTEGER('l', "loop", &loops,
 		    "Specify number of loops"),
+	OPT_STRING('C', "cpus", &cpu_list, "cpu,cpu",
+		   "Pin the two tasks to these cpus, e.g. on two sockets"),
 	OPT_END()
 };
 
@@ -42,9 +46,23 @@ static const char * const bench_sched_pipe_usage[] = {
 	NULL
 };
 
+static void bind_to_cpu(int cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask)) {
+		fprintf(stderr, "Can't bind to cpu %d: %s\n",
+			cpu, strerror(errno));
+		exit(1);
+	}
+}
+
 int bench_sched_pipe(int argc, const char **argv,
 		     const char *prefix __used)
 {
+	int cpus[2] = { -1, -1 };
 	int pipe_1[2], pipe_2[2];
 	int m = 0, i;
 	struct timeval start, stop, diff;
@@ -61,12 +79,19 @@ int bench_sched_pipe(int argc, const char **argv,
 	argc = parse_options(argc, argv, options,
 			     bench_sched_pipe_usage, 0);
 
+	if (cpu_list && (sscanf(cpu_list, "%d,%d", &cpus[0], &cpus[1]) != 2 ||
+			 cpus[0] < 0 || cpus[1] < 0))
+		usage_with_options(bench_sched_pipe_usage, options);
+
 	assert(!pipe(pipe_1));
 	assert(!pipe(pipe_2));
 
 	pid = fork();
 	assert(pid >= 0);
 
+	if (cpu_list)
+		bind_to_cpu(pid ? cpus[0] : cpus[1]);
+
 	gettimeofday(&start, NULL);
 
 	if (!pid) {
@@ -93,8 +118,12 @@ int bench_sched_pipe(int argc, const char **argv,
 
 	switch (bench_format) {
 	case BENCH_FORMAT_DEFAULT:
-		printf("# Extecuted %d pipe operations between two tasks\n\n",
+		printf("# Extecuted %d pipe operations between two tasks\n",
 			loops);
+		if (cpu_list)
+			printf("# Tasks bound to cpus %d and %d\n",
+			       cpus[0], cpus[1]);
+		printf("\n");
 
 		result_usec = diff.tv_sec * 1000000;
 		result_usec += diff.tv_usec;
@@ -13,6 +13,7 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  futex ... futex hashing and locking
  *
  */
 
@@ -42,6 +43,12 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "latency",
+	  "Wakeup latency of an interactive task next to a parallel build",
+	  bench_sched_latency   },
+	{ "jitter",
+	  "Interruptions seen by a task spinning alone on a cpu",
+	  bench_sched_jitter    },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -52,6 +59,28 @@ static struct bench_suite mem_suites[] = {
 	{ "memcpy",
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
+	{ "fault",
+	  "Anonymous page fault scalability, in and out of a memory cgroup",
+	  bench_mem_fault },
+	{ "pressure",
+	  "Swap throughput of threads touching more memory than available",
+	  bench_mem_pressure },
+	{ "free",
+	  "Allocation loop returning memory with MADV_DONTNEED and MADV_FREE",
+	  bench_mem_free },
+	{ "mmap",
+	  "mmap_sem contention between page faults and mmap/munmap",
+	  bench_mem_mmap },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite futex_suites[] = {
+	{ "hash",
+	  "Futex hash bucket contention, private and shared futexes",
+	  bench_futex_hash },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -71,6 +100,9 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "futex",
+	  "futex hashing and locking",
+	  futex_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },